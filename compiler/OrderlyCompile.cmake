@@ -0,0 +1,43 @@
+# Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+#  1. Redistributions of source code must retain the above copyright
+#     notice, this list of conditions and the following disclaimer.
+# 
+#  2. Redistributions in binary form must reproduce the above copyright
+#     notice, this list of conditions and the following disclaimer in
+#     the documentation and/or other materials provided with the
+#     distribution.
+# 
+#  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+#     contributors may be used to endorse or promote products derived
+#     from this software without specific prior written permission.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+# IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+# INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+# STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+# IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# ORDERLY_COMPILE_SCHEMA(<schema> <prefix> <base>)
+#
+# generate, at build time, a validator for the orderly or JSONSchema in
+# <schema>: <base>.c, defining the <prefix>_* functions declared in
+# <base>.h.  Add <base>.c to a target's sources and link it against
+# yajl, and pcre if the schema has regular expressions.
+FUNCTION(ORDERLY_COMPILE_SCHEMA schema prefix base)
+  ADD_CUSTOM_COMMAND(
+    OUTPUT ${base}.c ${base}.h
+    COMMAND orderly_compile -p ${prefix} -o ${base} ${schema}
+    DEPENDS orderly_compile ${schema}
+    COMMENT "Compiling ${schema}")
+ENDFUNCTION()
@@ -0,0 +1,1811 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+/* orderly_compile: generate a C validator for a schema.  the generated
+ * code checks a document the way ajv_parse_and_validate does, reaching
+ * the same verdict, but with the schema written into it: types are
+ * dispatched, keys are found and enums are matched by switch
+ * statements, and ranges and required properties are constants.  An
+ * object or array checked against an enum narrows the enum's values it
+ * may equal as it streams by.  It
+ * stops at the first error and doesn't say what it was, and needs only
+ * yajl, and pcre when the schema has regular expressions */
+
+#include "orderly/reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* XXX: 1 meg max schema size... */
+#define MAX_INPUT_TEXT (1 << 20)
+
+/* the json types, as yajl reports them, in the order of orderly_json_type */
+#define NTYPES 7
+#define TYPE_INDEX(t) ((t) - orderly_json_null)
+#define TYPE_BIT(t) (1u << TYPE_INDEX(t))
+
+/* the generated code keeps its bitmaps in words of this many bits */
+#define WORD_BITS 32
+#define BITS_WORDS(n) (((n) + WORD_BITS - 1) / WORD_BITS)
+
+/* the orderly nodes behind the nodes which check the properties and
+ * elements a schema doesn't name, as ajv_type_nodes in ajv_schema.c */
+static const orderly_node type_nodes[] = {
+    { orderly_node_empty },
+    { orderly_node_null },
+    { orderly_node_string },
+    { orderly_node_boolean },
+    { orderly_node_any },
+    { orderly_node_integer },
+    { orderly_node_number },
+    { orderly_node_object, NULL, NULL, NULL, NULL, NULL, 0, orderly_node_any },
+    { orderly_node_array, NULL, NULL, NULL, NULL, NULL, 0, orderly_node_any },
+    { orderly_node_union }
+};
+
+/* a schema node, linked as the validator links its ajv_nodes, and
+ * numbered as the generated code knows it */
+typedef struct gen_node_t {
+    const orderly_node * on;
+    struct gen_node_t * parent, * child, * sibling, * additional;
+    unsigned int id;
+    /* for a property, its index among the object's; for an object,
+     * how many it has */
+    unsigned int index, nprops;
+    unsigned int disallow;
+    const struct gen_node_t * dispatch[NTYPES];
+    /* the regular expression and format checked by a string node,
+     * numbered among those of the schema, or -1 */
+    int regex, format;
+    /* the objects and arrays of its enum, own to own + nown among the
+     * schema's enum values */
+    unsigned int own, nown;
+} gen_node;
+
+/* a value of an enum which is an object or array, or a member of one:
+ * the container it's in, or -1, and where its own members start */
+typedef struct {
+    const orderly_json * v;
+    int parent;
+    unsigned int first;
+} gen_value;
+
+typedef struct {
+    gen_node ** nodes;
+    unsigned int nnodes;
+    const gen_node * root;
+    /* distinct patterns and format names */
+    const char ** regexes;
+    unsigned int nregexes;
+    const char ** formats;
+    unsigned int nformats;
+    /* whether node n is ever the target of type t's dispatch */
+    unsigned char * reached;
+    /* whether any container is skipped rather than validated */
+    int skips;
+    /* the containers of the enums of nodes reached by one, and all
+     * they hold, the members of each together; and how deep the
+     * deepest goes */
+    gen_value * values;
+    unsigned int nvalues, values_depth;
+    const char * prefix;
+    FILE * out;
+} gen_schema;
+
+#define REACHED(g, n, t) ((g)->reached[(n)->id * NTYPES + TYPE_INDEX(t)])
+
+static void
+usage(const char * progname)
+{
+    fprintf(stderr, "%s: generate a C validator for an orderly or jsonschema\n"
+            "usage: %s [-i orderly|jsonschema] [-p prefix] [-o base] [schema]\n"
+            "    -p the prefix of the generated functions, 'validator' by\n"
+            "       default\n"
+            "    -o write base.c and base.h, rather than the C alone to\n"
+            "       stdout\n"
+            "the schema is read from stdin when no file is given\n",
+            progname, progname);
+    exit(1);
+}
+
+static void *
+gen_malloc(size_t sz)
+{
+    void * p = calloc(1, sz);
+    if (!p) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    return p;
+}
+
+/* the json types a node of type t accepts */
+static unsigned int
+type_bits(orderly_node_type t)
+{
+    switch (t) {
+        case orderly_node_null:    return TYPE_BIT(orderly_json_null);
+        case orderly_node_string:  return TYPE_BIT(orderly_json_string);
+        case orderly_node_boolean: return TYPE_BIT(orderly_json_boolean);
+        case orderly_node_integer: return TYPE_BIT(orderly_json_integer);
+        case orderly_node_number:
+            return TYPE_BIT(orderly_json_number)
+                | TYPE_BIT(orderly_json_integer);
+        case orderly_node_object:  return TYPE_BIT(orderly_json_object);
+        case orderly_node_array:   return TYPE_BIT(orderly_json_array);
+        case orderly_node_any:     return (1u << NTYPES) - 1;
+        case orderly_node_empty:
+        case orderly_node_union:   break;
+    }
+    return 0;
+}
+
+/* the passthrough property named k, as ajv_node_format and
+ * ajv_node_disallow find it */
+static const orderly_json *
+passthrough(const orderly_node * on, const char * k)
+{
+    const orderly_json * cur;
+    if (!on->passthrough_properties
+        || on->passthrough_properties->t != orderly_json_object)
+    {
+        return NULL;
+    }
+    for (cur = on->passthrough_properties->v.children.first; cur;
+         cur = cur->next)
+    {
+        if (!strcmp(cur->k, k)) return cur;
+    }
+    return NULL;
+}
+
+static unsigned int
+node_disallow(const orderly_node * on)
+{
+    unsigned int mask = 0;
+    const orderly_json * cur, * t;
+
+    if (!on->passthrough_properties
+        || on->passthrough_properties->t != orderly_json_object)
+    {
+        return 0;
+    }
+    /* every "disallow" counts, not just the first */
+    for (cur = on->passthrough_properties->v.children.first; cur;
+         cur = cur->next)
+    {
+        if (strcmp(cur->k, "disallow")) continue;
+        if (cur->t == orderly_json_string) {
+            mask |= type_bits(orderly_string_to_node_type(cur->v.s,
+                                                          strlen(cur->v.s)));
+        } else if (cur->t == orderly_json_array) {
+            for (t = cur->v.children.first; t; t = t->next) {
+                if (t->t != orderly_json_string) continue;
+                mask |= type_bits(orderly_string_to_node_type(t->v.s,
+                                                              strlen(t->v.s)));
+            }
+        }
+    }
+    return mask;
+}
+
+static void
+build_dispatch(gen_node * n)
+{
+    unsigned int i, accepts = type_bits(n->on->t);
+    const gen_node * cur;
+
+    for (i = 0; i < NTYPES; i++) {
+        n->dispatch[i] = NULL;
+        if (n->disallow & (1u << i)) continue;
+        if (n->on->t == orderly_node_union) {
+            for (cur = n->child; cur && !n->dispatch[i]; cur = cur->sibling) {
+                n->dispatch[i] = cur->dispatch[i];
+            }
+        } else if (accepts & (1u << i)) {
+            n->dispatch[i] = n;
+        }
+    }
+}
+
+static int
+intern(const char *** names, unsigned int * n, const char * name)
+{
+    unsigned int i;
+    for (i = 0; i < *n; i++) {
+        if (!strcmp((*names)[i], name)) return (int) i;
+    }
+    *names = realloc((void *) *names, sizeof(const char *) * (*n + 1));
+    (*names)[*n] = name;
+    return (int) (*n)++;
+}
+
+static gen_node *
+new_node(gen_schema * g, const orderly_node * on, gen_node * parent)
+{
+    gen_node * n = gen_malloc(sizeof(gen_node));
+    n->on = on;
+    n->parent = parent;
+    n->regex = n->format = -1;
+    n->id = g->nnodes;
+    g->nodes = realloc((void *) g->nodes, sizeof(gen_node *) * (g->nnodes + 1));
+    g->nodes[g->nnodes++] = n;
+    return n;
+}
+
+static gen_node *
+build_typed(gen_schema * g, orderly_node_type t, gen_node * parent)
+{
+    gen_node * n = new_node(g, &(type_nodes[t]), parent);
+    if (t == orderly_node_object || t == orderly_node_array) {
+        n->additional = build_typed(g, n->on->additional_properties, n);
+    }
+    build_dispatch(n);
+    return n;
+}
+
+static gen_node *
+build_tree(gen_schema * g, const orderly_node * on, gen_node * parent)
+{
+    gen_node * n = new_node(g, on, parent);
+    const orderly_json * fmt;
+    gen_node ** link = &(n->child);
+    const orderly_node * c;
+
+    n->disallow = node_disallow(on);
+    for (c = on->child; c; c = c->sibling) {
+        *link = build_tree(g, c, n);
+        (*link)->index = n->nprops++;
+        link = &((*link)->sibling);
+    }
+    if (on->t != orderly_node_object) n->nprops = 0;
+    if (on->t == orderly_node_object || on->t == orderly_node_array) {
+        n->additional = build_typed(g, on->additional_properties, n);
+    }
+    build_dispatch(n);
+
+    if (on->regex) n->regex = intern(&(g->regexes), &(g->nregexes), on->regex);
+    if ((fmt = passthrough(on, "format")) && fmt->t == orderly_json_string) {
+        n->format = intern(&(g->formats), &(g->nformats), fmt->v.s);
+    }
+    return n;
+}
+
+/* the property of map named name, the first when several are */
+static const gen_node *
+find_key(const gen_node * map, const char * name)
+{
+    const gen_node * cur;
+    for (cur = map->child; cur; cur = cur->sibling) {
+        if (!strcmp(cur->on->name, name)) return cur;
+    }
+    return NULL;
+}
+
+/* the node whose place in its container a value checked by n takes:
+ * a branch of a union stands for the union */
+static const gen_node *
+prop_of(const gen_node * n)
+{
+    if (n->parent && n->parent->on->t == orderly_node_union) return n->parent;
+    return n;
+}
+
+/* the frames the deepest document the schema validates needs, less
+ * the root's */
+static unsigned int
+tree_depth(const gen_node * n)
+{
+    const gen_node * cur;
+    unsigned int max = 0, d;
+    for (cur = n->child; cur; cur = cur->sibling) {
+        if ((d = tree_depth(cur)) > max) max = d;
+    }
+    if (n->additional && (d = tree_depth(n->additional)) > max) max = d;
+    if (n->on->t == orderly_node_object || n->on->t == orderly_node_array) {
+        max++;
+    }
+    return max;
+}
+
+/* whether a value may be checked against n before its type is known.
+ * the branches of a union are only reached by dispatch */
+static int
+is_entry(const gen_node * n)
+{
+    return !n->parent || n->parent->on->t != orderly_node_union;
+}
+
+/* whether the generated code pushes a frame for n */
+static int
+is_pushed(const gen_schema * g, const gen_node * n)
+{
+    return (n->on->t == orderly_node_object
+            && REACHED(g, n, orderly_json_object))
+        || (n->on->t == orderly_node_array
+            && REACHED(g, n, orderly_json_array));
+}
+
+/* a C string literal, escaped so that neither quotes, backslashes nor
+ * trigraphs in the text can end it early */
+static void
+emit_string(FILE * out, const char * s, size_t len)
+{
+    size_t i;
+    fputc('"', out);
+    for (i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) s[i];
+        if (c == '"' || c == '\\' || c == '?') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf(out, "\\%03o", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/* a double constant which reads back as d */
+static void
+emit_double(FILE * out, double d)
+{
+    char buf[64];
+    if (d > 0 && d * 0.5 == d) {
+        fputs("HUGE_VAL", out);
+        return;
+    } else if (d < 0 && d * 0.5 == d) {
+        fputs("(-HUGE_VAL)", out);
+        return;
+    }
+    snprintf(buf, sizeof(buf), "%.17g", d);
+    if (!strpbrk(buf, ".eE")) strcat(buf, ".0");
+    fputs(buf, out);
+}
+
+static void
+emit_long(FILE * out, long l)
+{
+    if (l == LONG_MIN) fprintf(out, "(%ldL - 1)", l + 1);
+    else fprintf(out, "%ldL", l);
+}
+
+/* reject v outside r, as ajv_check_range compares a long against a
+ * range: both sides as doubles */
+static void
+emit_range(FILE * out, const orderly_range * range, const char * v)
+{
+    orderly_range r = *range;
+    if (ORDERLY_RANGE_HAS_LHS(r)) {
+        fputs("        if (", out);
+        emit_double(out, (ORDERLY_RANGE_LHS_DOUBLE & r.info)
+                    ? r.lhs.d : (double) r.lhs.i);
+        fprintf(out, " > (double) %s) return 0;\n", v);
+    }
+    if (ORDERLY_RANGE_HAS_RHS(r)) {
+        fputs("        if (", out);
+        emit_double(out, (ORDERLY_RANGE_RHS_DOUBLE & r.info)
+                    ? r.rhs.d : (double) r.rhs.i);
+        fprintf(out, " < (double) %s) return 0;\n", v);
+    }
+}
+
+/* the same for a double, as ajv_double does it, which takes the form
+ * of the lower bound from the upper's flags */
+static void
+emit_double_range(FILE * out, const orderly_range * range)
+{
+    orderly_range r = *range;
+    if (ORDERLY_RANGE_HAS_LHS(r)) {
+        fputs("        if (", out);
+        emit_double(out, (ORDERLY_RANGE_RHS_DOUBLE & r.info)
+                    ? r.lhs.d : (double) r.lhs.i);
+        fputs(" > v) return 0;\n", out);
+    }
+    if (ORDERLY_RANGE_HAS_RHS(r)) {
+        fputs("        if (", out);
+        emit_double(out, (ORDERLY_RANGE_RHS_DOUBLE & r.info)
+                    ? r.rhs.d : (double) r.rhs.i);
+        fputs(" < v) return 0;\n", out);
+    }
+}
+
+static int
+cmp_long(const void * a, const void * b)
+{
+    long x = *(const long *) a, y = *(const long *) b;
+    return x < y ? -1 : x > y;
+}
+
+static int
+cmp_string_length(const void * a, const void * b)
+{
+    const orderly_json * x = *(const orderly_json * const *) a;
+    const orderly_json * y = *(const orderly_json * const *) b;
+    size_t lx = strlen(x->v.s), ly = strlen(y->v.s);
+    return lx < ly ? -1 : lx > ly;
+}
+
+static const orderly_json *
+enum_values(const gen_node * n)
+{
+    const orderly_json * values = n->on->values;
+    return (values && values->t == orderly_json_array) ? values : NULL;
+}
+
+static int
+is_container(const orderly_json * v)
+{
+    return v->t == orderly_json_object || v->t == orderly_json_array;
+}
+
+/* whether objects or arrays are among the values of n's enum */
+static int
+enum_has_containers(const gen_node * n)
+{
+    const orderly_json * cur;
+    for (cur = enum_values(n)->v.children.first; cur; cur = cur->next) {
+        if (is_container(cur)) return 1;
+    }
+    return 0;
+}
+
+/* the containers nested in v, v among them */
+static unsigned int
+value_depth(const orderly_json * v)
+{
+    const orderly_json * cur;
+    unsigned int max = 0, d;
+    if (!is_container(v)) return 0;
+    for (cur = v->v.children.first; cur; cur = cur->next) {
+        if ((d = value_depth(cur)) > max) max = d;
+    }
+    return max + 1;
+}
+
+static void
+add_value(gen_schema * g, const orderly_json * v, int parent)
+{
+    g->values = realloc((void *) g->values,
+                        sizeof(gen_value) * (g->nvalues + 1));
+    g->values[g->nvalues].v = v;
+    g->values[g->nvalues].parent = parent;
+    g->values[g->nvalues].first = 0;
+    g->nvalues++;
+}
+
+/* number the objects and arrays of n's enum and what they hold, breadth
+ * first, so that the members of each container are numbered together */
+static void
+collect_values(gen_schema * g, gen_node * n)
+{
+    const orderly_json * cur;
+    unsigned int i, d;
+
+    n->own = g->nvalues;
+    for (cur = enum_values(n)->v.children.first; cur; cur = cur->next) {
+        if (!is_container(cur)) continue;
+        add_value(g, cur, -1);
+        if ((d = value_depth(cur)) > g->values_depth) g->values_depth = d;
+    }
+    n->nown = g->nvalues - n->own;
+    for (i = n->own; i < g->nvalues; i++) {
+        if (!is_container(g->values[i].v)) continue;
+        g->values[i].first = g->nvalues;
+        for (cur = g->values[i].v->v.children.first; cur; cur = cur->next) {
+            add_value(g, cur, (int) i);
+        }
+    }
+}
+
+static void
+emit_values(gen_schema * g)
+{
+    FILE * out = g->out;
+    unsigned int i;
+
+    fputs("static const enum_value enumerated[ENUM_VALUES] = {\n", out);
+    for (i = 0; i < g->nvalues; i++) {
+        const gen_value * gv = g->values + i;
+        const orderly_json * v = gv->v, * cur;
+        unsigned int len = 0;
+
+        fputs("    { ", out);
+        switch (v->t) {
+            case orderly_json_null: fputs("EV_NULL", out); break;
+            case orderly_json_boolean:
+                fputs(v->v.b ? "EV_TRUE" : "EV_FALSE", out);
+                break;
+            case orderly_json_integer: fputs("EV_INTEGER", out); break;
+            case orderly_json_number: fputs("EV_DOUBLE", out); break;
+            case orderly_json_string: fputs("EV_STRING", out); break;
+            case orderly_json_object: fputs("EV_MAP", out); break;
+            default: fputs("EV_ARRAY", out); break;
+        }
+        fprintf(out, ", %d, ", gv->parent);
+        if (gv->parent >= 0
+            && g->values[gv->parent].v->t == orderly_json_object)
+        {
+            emit_string(out, v->k, strlen(v->k));
+            fprintf(out, ", %u, ", (unsigned int) strlen(v->k));
+        } else {
+            fputs("NULL, 0, ", out);
+        }
+        /* the integers of a schema's enum are kept as unsigned ints */
+        if (v->t == orderly_json_integer) emit_long(out, (long) v->v.i);
+        else fputs("0L", out);
+        fputs(", ", out);
+        emit_double(out, v->t == orderly_json_number ? v->v.n : 0.0);
+        fputs(", ", out);
+        if (v->t == orderly_json_string) {
+            len = (unsigned int) strlen(v->v.s);
+            emit_string(out, v->v.s, len);
+        } else {
+            fputs("NULL", out);
+            if (is_container(v)) {
+                for (cur = v->v.children.first; cur; cur = cur->next) len++;
+            }
+        }
+        fprintf(out, ", %u, %u }%s\n", len, gv->first,
+                i + 1 < g->nvalues ? "," : "");
+    }
+    fputs("};\n\n", out);
+}
+
+/* "|| v == d" for the numbers in an enum, and for its integers as
+ * numbers when ints is set */
+static unsigned int
+emit_enum_numbers(FILE * out, const orderly_json * values, const char * v,
+                  int ints, unsigned int n)
+{
+    const orderly_json * cur;
+    for (cur = values->v.children.first; cur; cur = cur->next) {
+        double d;
+        if (cur->t == orderly_json_number) d = cur->v.n;
+        else if (ints && cur->t == orderly_json_integer) {
+            d = (double) (long) cur->v.i;
+        } else continue;
+        fprintf(out, "%s%s == ", n++ ? "\n        || " : "", v);
+        emit_double(out, d);
+    }
+    return n;
+}
+
+/* a function for each type of value an enum may be matched against,
+ * following ajv_enum's notion of equality */
+static void
+emit_enum(gen_schema * g, const gen_node * n)
+{
+    FILE * out = g->out;
+    const orderly_json * values = enum_values(n), * cur;
+    unsigned int count = 0, i;
+
+    for (cur = values->v.children.first; cur; cur = cur->next) count++;
+
+    if (REACHED(g, n, orderly_json_string)) {
+        const orderly_json ** strs = gen_malloc(sizeof(orderly_json *)
+                                                * (count + 1));
+        unsigned int nstrs = 0;
+        for (cur = values->v.children.first; cur; cur = cur->next) {
+            if (cur->t == orderly_json_string) strs[nstrs++] = cur;
+        }
+        qsort((void *) strs, nstrs, sizeof(orderly_json *), cmp_string_length);
+        fprintf(out, "static int\nenum_%u_string(const unsigned char * v, "
+                "unsigned int len)\n{\n    switch (len) {\n", n->id);
+        for (i = 0; i < nstrs; i++) {
+            size_t len = strlen(strs[i]->v.s);
+            if (i == 0 || len != strlen(strs[i - 1]->v.s)) {
+                fprintf(out, "%s    case %u:\n        return ",
+                        i ? ";\n" : "", (unsigned int) len);
+            } else {
+                fputs("\n            || ", out);
+            }
+            fputs("!memcmp(v, ", out);
+            emit_string(out, strs[i]->v.s, len);
+            fprintf(out, ", %u)", (unsigned int) len);
+        }
+        fprintf(out, "%s    default:\n        return 0;\n    }\n}\n\n",
+                nstrs ? ";\n" : "");
+        free((void *) strs);
+    }
+
+    if (REACHED(g, n, orderly_json_integer)) {
+        /* the integers of a schema's enum are kept as unsigned ints */
+        long * ints = gen_malloc(sizeof(long) * (count + 1));
+        unsigned int nints = 0;
+        for (cur = values->v.children.first; cur; cur = cur->next) {
+            if (cur->t == orderly_json_integer) ints[nints++] = (long) cur->v.i;
+        }
+        qsort((void *) ints, nints, sizeof(long), cmp_long);
+        fprintf(out, "static int\nenum_%u_integer(long v)\n{\n", n->id);
+        if (nints) {
+            fputs("    switch (v) {\n", out);
+            for (i = 0; i < nints; i++) {
+                if (i && ints[i] == ints[i - 1]) continue;
+                fputs("    case ", out);
+                emit_long(out, ints[i]);
+                fputs(":\n", out);
+            }
+            fputs("        return 1;\n    default:\n        break;\n    }\n",
+                  out);
+        }
+        fputs("    return ", out);
+        if (!emit_enum_numbers(out, values, "(double) v", 0, 0)) {
+            fputs("0", out);
+        }
+        fputs(";\n}\n\n", out);
+        free((void *) ints);
+    }
+
+    if (REACHED(g, n, orderly_json_number)) {
+        fprintf(out, "static int\nenum_%u_double(double v)\n{\n"
+                "    return ", n->id);
+        if (!emit_enum_numbers(out, values, "v", 1, 0)) {
+            fputs("0", out);
+        }
+        fputs(";\n}\n\n", out);
+    }
+}
+
+/* the checks on a value of type t, once it's dispatched to n */
+static void
+emit_checks(gen_schema * g, const gen_node * n, orderly_json_type t)
+{
+    FILE * out = g->out;
+    const orderly_node * on = n->on;
+    const orderly_json * values = enum_values(n), * cur;
+    unsigned int bools = 0;
+    int ranged = on->t != orderly_node_any
+        && ORDERLY_RANGE_SPECIFIED(on->range);
+
+    switch (t) {
+        case orderly_json_boolean:
+            if (!values) break;
+            for (cur = values->v.children.first; cur; cur = cur->next) {
+                if (cur->t == orderly_json_boolean) bools |= cur->v.b ? 2 : 1;
+            }
+            if (bools == 0) fputs("        return 0;\n", out);
+            else if (bools == 1) fputs("        if (v) return 0;\n", out);
+            else if (bools == 2) fputs("        if (!v) return 0;\n", out);
+            break;
+        case orderly_json_integer:
+            if (ranged) {
+                emit_range(out, &(on->range), "v");
+            }
+            if (values) {
+                fprintf(out, "        if (!enum_%u_integer(v)) return 0;\n",
+                        n->id);
+            }
+            break;
+        case orderly_json_number:
+            if (ranged) {
+                emit_double_range(out, &(on->range));
+            }
+            if (values) {
+                fprintf(out, "        if (!enum_%u_double(v)) return 0;\n",
+                        n->id);
+            }
+            break;
+        case orderly_json_string:
+            if (on->t != orderly_node_any) {
+                if (ranged) {
+                    emit_range(out, &(on->range), "len");
+                }
+                if (n->regex >= 0) {
+                    fprintf(out, "        if (s->re[%d]\n"
+                            "            && pcre_exec(s->re[%d], NULL, "
+                            "(const char *) v, (int) len, 0, 0,\n"
+                            "                         NULL, 0) == "
+                            "PCRE_ERROR_NOMATCH) {\n"
+                            "            return 0;\n        }\n",
+                            n->regex, n->regex);
+                }
+                if (n->format >= 0) {
+                    fprintf(out, "        if (formats[%d] && "
+                            "!formats[%d]((const char *) v, len)) {\n"
+                            "            return 0;\n        }\n",
+                            n->format, n->format);
+                }
+            }
+            if (values) {
+                fprintf(out, "        if (!enum_%u_string(v, len)) return 0;\n",
+                        n->id);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* the cases of a callback's switch on the node a value of type t is
+ * checked against: each node it may be dispatched to, with the nodes
+ * that dispatch to it, its checks and, for a container, the skip of
+ * one which isn't validated.  returns the cases emitted */
+static unsigned int
+emit_dispatch(gen_schema * g, orderly_json_type t)
+{
+    FILE * out = g->out;
+    unsigned int i, j, ncases = 0;
+
+    for (i = 0; i < g->nnodes; i++) {
+        const gen_node * d = g->nodes[i];
+        int moved = 0;
+        if (!REACHED(g, d, t)) continue;
+        for (j = 0; j < g->nnodes; j++) {
+            const gen_node * n = g->nodes[j];
+            if (!is_entry(n) || n->dispatch[TYPE_INDEX(t)] != d) continue;
+            fprintf(out, "    case %u:\n", n->id);
+            if (n != d) moved = 1;
+            ncases++;
+        }
+        if (moved) fprintf(out, "        s->node = %u;\n", d->id);
+        if (t == orderly_json_object || t == orderly_json_array) {
+            /* an enum of scalars alone rules any container out */
+            if (enum_values(d) && !d->nown) {
+                fputs("        return 0;\n", out);
+                continue;
+            }
+            if (d->nown) {
+                fprintf(out, "        if (!enum_open(s, %s, %u, %u)) "
+                        "return 0;\n", t == orderly_json_object
+                        ? "EV_MAP" : "EV_ARRAY", d->own, d->nown);
+            }
+            if (d->on->t == orderly_node_any) {
+                fputs("        return skip(s);\n", out);
+                continue;
+            }
+        } else {
+            emit_checks(g, d, t);
+        }
+        fputs("        break;\n", out);
+    }
+    fputs("    default:\n        return 0;\n    }\n", out);
+    return ncases;
+}
+
+static void
+emit_scalar(gen_schema * g, orderly_json_type t, const char * name,
+            const char * params)
+{
+    fprintf(g->out, "static int\nv_%s(void * ctx%s)\n{\n"
+            "    %s_validator s = (%s_validator) ctx;\n"
+            "    if (s->frames[0].count) return 0;\n"
+            "    switch (s->node) {\n", name, params, g->prefix, g->prefix);
+    emit_dispatch(g, t);
+    fputs("    seen(s);\n    return 1;\n}\n\n", g->out);
+}
+
+static void
+emit_open(gen_schema * g, orderly_json_type t, const char * name)
+{
+    fprintf(g->out, "static int\nv_%s(void * ctx)\n{\n"
+            "    %s_validator s = (%s_validator) ctx;\n"
+            "    if (s->frames[0].count) return 0;\n"
+            "    switch (s->node) {\n", name, g->prefix, g->prefix);
+    emit_dispatch(g, t);
+    fputs("    push(s);\n    return 1;\n}\n\n", g->out);
+}
+
+/* what seen() does for a value checked against n, as
+ * ajv_state_mark_seen, in buf.  empty when counting it is all */
+static void
+seen_action(const gen_node * n, char * buf, size_t len)
+{
+    const gen_node * prop = prop_of(n), * parent = prop->parent;
+    buf[0] = 0;
+    if (!parent || prop == parent->additional) return;
+    if (parent->on->t == orderly_node_object) {
+        snprintf(buf, len, "        f->seen[%u] |= 0x%xU;\n",
+                 prop->index / WORD_BITS, 1u << (prop->index % WORD_BITS));
+    } else if (parent->on->t == orderly_node_array) {
+        if (!parent->on->tuple_typed) {
+            /* forget which branch of a union the element matched */
+            if (prop != n) snprintf(buf, len, "        s->node = %u;\n",
+                                    prop->id);
+        } else {
+            snprintf(buf, len, "        s->node = %u;\n", prop->sibling
+                     ? prop->sibling->id : parent->additional->id);
+        }
+    }
+}
+
+static void
+emit_seen(gen_schema * g)
+{
+    FILE * out = g->out;
+    unsigned int i, j, t;
+    char action[128], other[128];
+    unsigned char * done = gen_malloc(g->nnodes);
+
+    fprintf(out, "/* a value is complete: count it and, in an object, note "
+            "the property, or in\n * a tuple, move on to the next member */\n"
+            "static void\nseen(%s_validator s)\n{\n"
+            "    frame * f = s->frames + s->nframes - 1;\n"
+            "    f->count++;\n    switch (s->node) {\n", g->prefix);
+    for (i = 0; i < g->nnodes; i++) {
+        unsigned int reached = 0;
+        for (t = 0; t < NTYPES; t++) {
+            reached |= g->reached[g->nodes[i]->id * NTYPES + t];
+        }
+        if (!reached) done[i] = 1;
+    }
+    /* nodes which do the same share a case */
+    for (i = 0; i < g->nnodes; i++) {
+        if (done[i]) continue;
+        seen_action(g->nodes[i], action, sizeof(action));
+        if (!action[0]) continue;
+        for (j = i; j < g->nnodes; j++) {
+            if (done[j]) continue;
+            seen_action(g->nodes[j], other, sizeof(other));
+            if (strcmp(action, other)) continue;
+            fprintf(out, "    case %u:\n", g->nodes[j]->id);
+            done[j] = 1;
+        }
+        fprintf(out, "%s        break;\n", action);
+    }
+    fputs("    default:\n        break;\n    }\n}\n\n", out);
+    free((void *) done);
+}
+
+static void
+emit_push(gen_schema * g)
+{
+    FILE * out = g->out;
+    unsigned int i;
+
+    fprintf(out, "/* a container to validate has opened */\n"
+            "static void\npush(%s_validator s)\n{\n"
+            "    frame * f = s->frames + s->nframes++;\n"
+            "    f->node = s->node;\n"
+            "    f->count = 0;\n"
+            "    memset((void *) f->seen, 0, sizeof(f->seen));\n"
+            "    memset((void *) f->req, 0, sizeof(f->req));\n"
+            "    switch (s->node) {\n", g->prefix);
+    for (i = 0; i < g->nnodes; i++) {
+        const gen_node * n = g->nodes[i];
+        if (!is_pushed(g, n)) continue;
+        /* a container without a schema for its contents lets anything
+         * in */
+        fprintf(out, "    case %u:\n        s->node = %u;\n        break;\n",
+                n->id, n->child ? n->child->id : n->additional->id);
+    }
+    fputs("    default:\n        break;\n    }\n}\n\n", out);
+}
+
+/* the matching of objects and arrays against enums: each container
+ * open keeps the values it may yet turn out to be, and each member it
+ * has narrows them to those with an equal member, as ajv_enum_match
+ * does but without keeping the document.  yajl calls the enumerating
+ * callbacks while it's under way, which hand on to inner */
+static void
+emit_matching(gen_schema * g)
+{
+    FILE * out = g->out;
+    const char * p = g->prefix;
+
+    fputs(
+"#define ENUM_HAS(set, i) ((set)[(i) / 32] & (1U << ((i) % 32)))\n"
+"#define ENUM_ADD(set, i) ((set)[(i) / 32] |= 1U << ((i) % 32))\n\n"
+"/* ajv_enum's notion of equality, for a scalar of type t */\n"
+"static int\nenum_equal(const enum_value * e, int t, long i, double d,\n"
+"           const unsigned char * s, unsigned int len)\n{\n"
+"    switch (t) {\n"
+"    case EV_INTEGER:\n"
+"        return e->t == EV_INTEGER ? e->i == i\n"
+"            : e->t == EV_DOUBLE && e->d == (double) i;\n"
+"    case EV_DOUBLE:\n"
+"        return e->t == EV_DOUBLE ? e->d == d\n"
+"            : e->t == EV_INTEGER && (double) e->i == d;\n"
+"    case EV_STRING:\n"
+"        return e->t == EV_STRING && e->len == len && !memcmp(e->s, s, len);\n"
+"    default:\n"
+"        return e->t == t;\n"
+"    }\n}\n\n"
+"/* in an array, the members of the candidates the next element is\n"
+" * matched against */\n"
+"static void\nenum_element(enum_frame * f)\n{\n"
+"    unsigned int i;\n"
+"    memset((void *) f->next, 0, sizeof(f->next));\n"
+"    for (i = 0; i < ENUM_VALUES; i++) {\n"
+"        if (ENUM_HAS(f->cand, i) && f->count < enumerated[i].len) {\n"
+"            ENUM_ADD(f->next, enumerated[i].first + f->count);\n"
+"        }\n"
+"    }\n}\n\n"
+"/* in an object, the members of the candidates named key, the first\n"
+" * when several are */\n"
+"static void\nenum_key(enum_frame * f, const unsigned char * key, "
+"unsigned int len)\n{\n"
+"    unsigned int i, j;\n"
+"    memset((void *) f->next, 0, sizeof(f->next));\n"
+"    for (i = 0; i < ENUM_VALUES; i++) {\n"
+"        const enum_value * e = enumerated + i;\n"
+"        if (!ENUM_HAS(f->cand, i)) continue;\n"
+"        for (j = e->first; j < e->first + e->len; j++) {\n"
+"            if (enumerated[j].keylen == len\n"
+"                && !memcmp(enumerated[j].key, key, len))\n"
+"            {\n"
+"                ENUM_ADD(f->next, j);\n"
+"                break;\n"
+"            }\n"
+"        }\n"
+"    }\n}\n\n"
+"/* a member is complete, and equal to the values in equal: the\n"
+" * candidates left are their containers */\n"
+"static void\nenum_member(enum_frame * f, const unsigned int * equal)\n{\n"
+"    unsigned int i;\n"
+"    memset((void *) f->cand, 0, sizeof(f->cand));\n"
+"    for (i = 0; i < ENUM_VALUES; i++) {\n"
+"        if (ENUM_HAS(equal, i) && enumerated[i].parent >= 0) {\n"
+"            ENUM_ADD(f->cand, (unsigned int) enumerated[i].parent);\n"
+"        }\n"
+"    }\n"
+"    f->count++;\n}\n\n", out);
+
+    fprintf(out,
+"static void\nenum_scalar(%s_validator s, int t, long i, double d,\n"
+"            const unsigned char * str, unsigned int len)\n{\n"
+"    enum_frame * f = s->enums + s->nenums - 1;\n"
+"    unsigned int k, equal[ENUM_WORDS];\n"
+"    if (s->lost) return;\n"
+"    if (f->t == EV_ARRAY) enum_element(f);\n"
+"    memset((void *) equal, 0, sizeof(equal));\n"
+"    for (k = 0; k < ENUM_VALUES; k++) {\n"
+"        if (ENUM_HAS(f->next, k)\n"
+"            && enum_equal(enumerated + k, t, i, d, str, len))\n"
+"        {\n"
+"            ENUM_ADD(equal, k);\n"
+"        }\n"
+"    }\n"
+"    enum_member(f, equal);\n}\n\n", p);
+
+    fprintf(out,
+"/* a container has opened inside those being matched, or with an enum\n"
+" * of its own.  one which can't equal anything and has no enum of its\n"
+" * own is only counted, and its container's candidates are gone */\n"
+"static int\nenum_start(%s_validator s, int t)\n{\n"
+"    enum_frame * parent = s->nenums ? s->enums + s->nenums - 1 : NULL;\n"
+"    enum_frame * f;\n"
+"    unsigned int k, own = s->own, nown = s->nown, cand[ENUM_WORDS];\n\n"
+"    s->nown = 0;\n"
+"    memset((void *) cand, 0, sizeof(cand));\n"
+"    if (parent && !s->lost) {\n"
+"        if (parent->t == EV_ARRAY) enum_element(parent);\n"
+"        for (k = 0; k < ENUM_VALUES; k++) {\n"
+"            if (ENUM_HAS(parent->next, k) && enumerated[k].t == t) {\n"
+"                ENUM_ADD(cand, k);\n"
+"            }\n"
+"        }\n"
+"    }\n"
+"    for (k = own; k < own + nown; k++) {\n"
+"        if (enumerated[k].t == t) ENUM_ADD(cand, k);\n"
+"    }\n"
+"    if (!nown) {\n"
+"        for (k = 0; k < ENUM_WORDS && !cand[k]; k++) ;\n"
+"        if (k == ENUM_WORDS) {\n"
+"            if (!s->lost++) {\n"
+"                memset((void *) parent->cand, 0, sizeof(parent->cand));\n"
+"            }\n"
+"            return 1;\n"
+"        }\n"
+"    }\n"
+"    if (s->nenums == ENUM_DEPTH) return 0;\n"
+"    f = s->enums + s->nenums++;\n"
+"    f->t = t;\n"
+"    f->count = 0;\n"
+"    memcpy((void *) f->cand, (const void *) cand, sizeof(cand));\n"
+"    f->own = own;\n"
+"    f->nown = nown;\n"
+"    f->lost = s->lost;\n"
+"    s->lost = 0;\n"
+"    return 1;\n}\n\n", p);
+
+    fprintf(out,
+"/* a container being matched has closed: 0 if it isn't one of the\n"
+" * values of its enum */\n"
+"static int\nenum_end(%s_validator s)\n{\n"
+"    enum_frame * f;\n"
+"    unsigned int k;\n"
+"    int ok = 1;\n\n"
+"    if (s->lost) {\n"
+"        s->lost--;\n"
+"        return 1;\n"
+"    }\n"
+"    f = s->enums + --s->nenums;\n"
+"    for (k = 0; k < ENUM_VALUES; k++) {\n"
+"        if (ENUM_HAS(f->cand, k) && enumerated[k].len != f->count) {\n"
+"            f->cand[k / 32] &= ~(1U << (k %% 32));\n"
+"        }\n"
+"    }\n"
+"    if (f->nown) {\n"
+"        for (ok = 0, k = f->own; k < f->own + f->nown && !ok; k++) {\n"
+"            ok = ENUM_HAS(f->cand, k) != 0;\n"
+"        }\n"
+"    }\n"
+"    s->lost = f->lost;\n"
+"    if (s->nenums && !s->lost) {\n"
+"        enum_member(s->enums + s->nenums - 1, f->cand);\n"
+"    }\n"
+"    return ok;\n}\n\n", p);
+
+    fprintf(out,
+"/* a container checked against an enum with objects or arrays among\n"
+" * its values, own to own + nown, has opened.  matching starts with\n"
+" * it, unless it's under way, when the enumerating callbacks go on\n"
+" * once the container's validated */\n"
+"static int\nenum_open(%s_validator s, int t, unsigned int own, "
+"unsigned int nown)\n{\n"
+"    s->own = own;\n"
+"    s->nown = nown;\n"
+"    if (s->nenums) return 1;\n"
+"    memcpy((void *) &(s->inner), (const void *) &(s->callbacks),\n"
+"           sizeof(yajl_callbacks));\n"
+"    memcpy((void *) &(s->callbacks), (const void *) &enumerating,\n"
+"           sizeof(yajl_callbacks));\n"
+"    return enum_start(s, t);\n}\n\n", p);
+
+    fprintf(out,
+"static int\ne_null(void * ctx)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    enum_scalar(s, EV_NULL, 0, 0, NULL, 0);\n"
+"    return !s->inner.yajl_null || s->inner.yajl_null(ctx);\n}\n\n"
+"static int\ne_boolean(void * ctx, int v)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    enum_scalar(s, v ? EV_TRUE : EV_FALSE, 0, 0, NULL, 0);\n"
+"    return !s->inner.yajl_boolean || s->inner.yajl_boolean(ctx, v);\n}\n\n"
+"static int\ne_integer(void * ctx, long v)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    enum_scalar(s, EV_INTEGER, v, 0, NULL, 0);\n"
+"    return !s->inner.yajl_integer || s->inner.yajl_integer(ctx, v);\n}\n\n"
+"static int\ne_double(void * ctx, double v)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    enum_scalar(s, EV_DOUBLE, 0, v, NULL, 0);\n"
+"    return !s->inner.yajl_double || s->inner.yajl_double(ctx, v);\n}\n\n",
+            p, p, p, p, p, p, p, p);
+    fprintf(out,
+"static int\ne_string(void * ctx, const unsigned char * v, "
+"unsigned int len)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    enum_scalar(s, EV_STRING, 0, 0, v, len);\n"
+"    return !s->inner.yajl_string || s->inner.yajl_string(ctx, v, len);\n"
+"}\n\n"
+"static int\ne_map_key(void * ctx, const unsigned char * key, "
+"unsigned int len)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    if (!s->lost) enum_key(s->enums + s->nenums - 1, key, len);\n"
+"    return !s->inner.yajl_map_key || s->inner.yajl_map_key(ctx, key, len);\n"
+"}\n\n", p, p, p, p);
+    fprintf(out,
+"static int\ne_start_map(void * ctx)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    if (s->inner.yajl_start_map && !s->inner.yajl_start_map(ctx)) {\n"
+"        return 0;\n"
+"    }\n"
+"    return enum_start(s, EV_MAP);\n}\n\n"
+"static int\ne_start_array(void * ctx)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    if (s->inner.yajl_start_array && !s->inner.yajl_start_array(ctx)) {\n"
+"        return 0;\n"
+"    }\n"
+"    return enum_start(s, EV_ARRAY);\n}\n\n", p, p, p, p);
+    fprintf(out,
+"/* the last container matched closing ends the matching */\n"
+"static int\nenum_close(%s_validator s)\n{\n"
+"    if (!enum_end(s)) return 0;\n"
+"    if (!s->nenums) {\n"
+"        memcpy((void *) &(s->callbacks), (const void *) &(s->inner),\n"
+"               sizeof(yajl_callbacks));\n"
+"    }\n"
+"    return 1;\n}\n\n"
+"static int\ne_end_map(void * ctx)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    if (!enum_close(s)) return 0;\n"
+"    return !s->inner.yajl_end_map || s->inner.yajl_end_map(ctx);\n}\n\n"
+"static int\ne_end_array(void * ctx)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    if (!enum_close(s)) return 0;\n"
+"    return !s->inner.yajl_end_array || s->inner.yajl_end_array(ctx);\n"
+"}\n\n", p, p, p, p, p);
+}
+
+/* whether a property can be missing without the object failing */
+static int
+may_be_missing(const gen_node * prop)
+{
+    /* there's nobody to hand a default to, so it's as good as seen */
+    return prop->on->default_value != NULL;
+}
+
+static void
+emit_end_map(gen_schema * g)
+{
+    FILE * out = g->out;
+    unsigned int i, w;
+
+    fprintf(out, "static int\nv_end_map(void * ctx)\n{\n"
+            "    %s_validator s = (%s_validator) ctx;\n"
+            "    frame * f = s->frames + s->nframes - 1;\n"
+            "    switch (f->node) {\n", g->prefix, g->prefix);
+    for (i = 0; i < g->nnodes; i++) {
+        const gen_node * map = g->nodes[i], * cur;
+        unsigned int words, * required;
+        int requires = 0, any = 0;
+        if (!is_pushed(g, map) || map->on->t != orderly_node_object
+            || !map->nprops)
+        {
+            continue;
+        }
+        words = BITS_WORDS(map->nprops);
+        required = gen_malloc(sizeof(unsigned int) * words);
+        for (cur = map->child; cur; cur = cur->sibling) {
+            if (!cur->on->optional && !may_be_missing(cur)) {
+                required[cur->index / WORD_BITS] |=
+                    1u << (cur->index % WORD_BITS);
+                any = 1;
+            }
+            if (cur->on->requires) requires = any = 1;
+        }
+        if (any) {
+            fprintf(out, "    case %u:\n", map->id);
+            for (w = 0; w < words; w++) {
+                if (requires) {
+                    fprintf(out, "        if ((0x%xU | f->req[%u]) & "
+                            "~f->seen[%u]) return 0;\n", required[w], w, w);
+                } else if (required[w]) {
+                    fprintf(out, "        if (0x%xU & ~f->seen[%u]) "
+                            "return 0;\n", required[w], w);
+                }
+            }
+            fputs("        break;\n", out);
+        }
+        free((void *) required);
+    }
+    fputs("    default:\n        break;\n    }\n"
+          "    s->node = f->node;\n    s->nframes--;\n"
+          "    seen(s);\n    return 1;\n}\n\n", out);
+}
+
+static void
+emit_end_array(gen_schema * g)
+{
+    FILE * out = g->out;
+    unsigned int i;
+
+    fprintf(out, "static int\nv_end_array(void * ctx)\n{\n"
+            "    %s_validator s = (%s_validator) ctx;\n"
+            "    frame * f = s->frames + s->nframes - 1;\n"
+            "    switch (f->node) {\n", g->prefix, g->prefix);
+    for (i = 0; i < g->nnodes; i++) {
+        const gen_node * array = g->nodes[i], * cur, * rest;
+        int tuple = 0;
+        if (!is_pushed(g, array) || array->on->t != orderly_node_array) {
+            continue;
+        }
+        /* the members of a tuple the array may end at.  it may end at
+         * any whose rest all have defaults */
+        if (array->on->tuple_typed) {
+            for (cur = array->child; cur; cur = cur->sibling) {
+                for (rest = cur; rest && may_be_missing(rest);
+                     rest = rest->sibling);
+                if (rest) tuple++;
+            }
+        }
+        if (!ORDERLY_RANGE_SPECIFIED(array->on->range) && !tuple) continue;
+        fprintf(out, "    case %u:\n", array->id);
+        if (ORDERLY_RANGE_SPECIFIED(array->on->range)) {
+            emit_range(out, &(array->on->range), "f->count");
+        }
+        if (tuple) {
+            fputs("        if (", out);
+            tuple = 0;
+            for (cur = array->child; cur; cur = cur->sibling) {
+                for (rest = cur; rest && may_be_missing(rest);
+                     rest = rest->sibling);
+                if (!rest) continue;
+                fprintf(out, "%ss->node == %u", tuple++ ? "\n            || "
+                        : "", cur->id);
+            }
+            fputs(") {\n            return 0;\n        }\n", out);
+        }
+        fputs("        break;\n", out);
+    }
+    fputs("    default:\n        break;\n    }\n"
+          "    s->node = f->node;\n    s->nframes--;\n"
+          "    seen(s);\n    return 1;\n}\n\n", out);
+}
+
+static void
+emit_map_key(gen_schema * g)
+{
+    FILE * out = g->out;
+    unsigned int i, nmaps = 0;
+
+    for (i = 0; i < g->nnodes; i++) {
+        if (is_pushed(g, g->nodes[i])
+            && g->nodes[i]->on->t == orderly_node_object) nmaps++;
+    }
+    fputs("static int\nv_map_key(void * ctx, const unsigned char * key, "
+          "unsigned int len)\n{\n", out);
+    if (!nmaps) {
+        fputs("    (void) ctx;\n    (void) key;\n    (void) len;\n"
+              "    return 0;\n}\n\n", out);
+        return;
+    }
+    fprintf(out, "    %s_validator s = (%s_validator) ctx;\n"
+            "    frame * f = s->frames + s->nframes - 1;\n"
+            "    switch (f->node) {\n", g->prefix, g->prefix);
+    for (i = 0; i < g->nnodes; i++) {
+        const gen_node * map = g->nodes[i], * cur, * other;
+        const gen_node ** props;
+        unsigned int nprops = 0, j;
+        if (!is_pushed(g, map) || map->on->t != orderly_node_object) continue;
+
+        fprintf(out, "    case %u:\n", map->id);
+        props = gen_malloc(sizeof(gen_node *) * (map->nprops + 1));
+        /* on duplicate property names, the first definition wins */
+        for (cur = map->child; cur; cur = cur->sibling) {
+            if (find_key(map, cur->on->name) == cur) props[nprops++] = cur;
+        }
+        if (nprops) fputs("        switch (len) {\n", out);
+        for (j = 0; j < nprops; j++) {
+            size_t len = strlen(props[j]->on->name);
+            unsigned int k, seen = 0;
+            const char ** r;
+            /* each length once, with its names in order */
+            for (k = 0; k < j; k++) {
+                if (strlen(props[k]->on->name) == len) seen = 1;
+            }
+            if (seen) continue;
+            fprintf(out, "        case %u:\n", (unsigned int) len);
+            for (k = j; k < nprops; k++) {
+                cur = props[k];
+                if (strlen(cur->on->name) != len) continue;
+                fputs("            if (!memcmp(key, ", out);
+                emit_string(out, cur->on->name, len);
+                fprintf(out, ", %u)) {\n                s->node = %u;\n",
+                        (unsigned int) len, cur->id);
+                /* the siblings it requires, which can't be missing */
+                for (r = cur->on->requires; r && *r; r++) {
+                    if (!(other = find_key(map, *r)) || may_be_missing(other)) {
+                        continue;
+                    }
+                    fprintf(out, "                f->req[%u] |= 0x%xU;\n",
+                            other->index / WORD_BITS,
+                            1u << (other->index % WORD_BITS));
+                }
+                fputs("                return 1;\n            }\n", out);
+            }
+            fputs("            break;\n", out);
+        }
+        if (nprops) fputs("        default:\n            break;\n        }\n",
+                          out);
+        if (map->on->additional_properties == orderly_node_empty) {
+            fputs("        return 0;\n", out);
+        } else {
+            fprintf(out, "        s->node = %u;\n        return 1;\n",
+                    map->additional->id);
+        }
+        free((void *) props);
+    }
+    fputs("    default:\n        return 0;\n    }\n}\n\n", out);
+}
+
+/* the declarations of the functions the generated code exports */
+static void
+emit_api(FILE * out, const char * p)
+{
+    fprintf(out,
+"/** a check of strings of some format, as ajv_format_checker */\n"
+"typedef int (*%s_format_checker)(const char * s, unsigned int len);\n\n"
+"typedef struct %s_validator_t * %s_validator;\n\n"
+"/** allocate a validator, to parse with the given configuration.  NULL\n"
+" * is yajl's default: no comments, and strings must be utf8 */\n"
+"%s_validator %s_alloc(const yajl_parser_config * cfg);\n\n"
+"/** ready a validator for the next document */\n"
+"void %s_reset(%s_validator v);\n\n"
+"void %s_free(%s_validator v);\n\n"
+"/** validate more of a document.  anything but yajl_status_ok or\n"
+" * yajl_status_insufficient_data means it's invalid, as with\n"
+" * ajv_parse_and_validate */\n"
+"yajl_status %s_parse(%s_validator v, const unsigned char * text,\n"
+"                     unsigned int len);\n\n"
+"/** the document is done.  returns yajl_status_error if the document is\n"
+" * invalid or there was no document at all */\n"
+"yajl_status %s_parse_complete(%s_validator v);\n\n"
+"/** whether text holds a valid document */\n"
+"int %s_validate(const unsigned char * text, unsigned int len,\n"
+"                const yajl_parser_config * cfg);\n\n"
+"/** check strings of the named format with checker, as\n"
+" * ajv_register_format.  returns 0 if the schema has no such format */\n"
+"int %s_register_format(const char * name, %s_format_checker checker);\n\n",
+            p, p, p, p, p, p, p, p, p, p, p, p, p, p, p, p);
+}
+
+static void
+emit_header(FILE * out, const char * p)
+{
+    char * guard = gen_malloc(strlen(p) + 1);
+    unsigned int i;
+    for (i = 0; p[i]; i++) {
+        guard[i] = (p[i] >= 'a' && p[i] <= 'z') ? (char) (p[i] - 'a' + 'A')
+            : p[i];
+    }
+    fprintf(out, "/* generated by orderly_compile, do not edit */\n\n"
+            "#ifndef __%s_H__\n#define __%s_H__\n\n"
+            "#include <yajl/yajl_parse.h>\n\n"
+            "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n", guard, guard);
+    emit_api(out, p);
+    fputs("#ifdef __cplusplus\n}\n#endif\n\n#endif\n", out);
+    free((void *) guard);
+}
+
+static void
+emit_validator(gen_schema * g, const char * header)
+{
+    FILE * out = g->out;
+    const char * p = g->prefix;
+    unsigned int i, words = 1;
+
+    for (i = 0; i < g->nnodes; i++) {
+        if (BITS_WORDS(g->nodes[i]->nprops) > words) {
+            words = BITS_WORDS(g->nodes[i]->nprops);
+        }
+    }
+
+    fputs("/* generated by orderly_compile, do not edit */\n\n"
+          "#include <yajl/yajl_parse.h>\n", out);
+    if (g->nregexes) fputs("#include <pcre.h>\n", out);
+    fputs("#include <math.h>\n#include <stdlib.h>\n#include <string.h>\n\n",
+          out);
+    if (header) fprintf(out, "#include \"%s\"\n\n", header);
+    else emit_api(out, p);
+
+    fprintf(out,
+"/* the frames a document needs, the root's among them, and the words of\n"
+" * the largest object's bitmaps */\n"
+"#define DEPTH %u\n#define WORDS %u\n\n"
+"typedef struct {\n"
+"    /* the container, and the values it has had */\n"
+"    int node;\n"
+"    unsigned int count;\n"
+"    /* the properties seen, and those required by ones seen */\n"
+"    unsigned int seen[WORDS];\n"
+"    unsigned int req[WORDS];\n"
+"} frame;\n\n",
+            tree_depth(g->root) + 1, words);
+    if (g->nvalues) {
+        fprintf(out,
+"/* the objects and arrays of the schema's enums, and all they hold, and\n"
+" * the frames matching the deepest document against them needs */\n"
+"#define ENUM_VALUES %u\n#define ENUM_WORDS %u\n"
+"#define ENUM_DEPTH (DEPTH + %u)\n\n"
+"enum {\n"
+"    EV_NULL, EV_FALSE, EV_TRUE, EV_INTEGER, EV_DOUBLE, EV_STRING, EV_MAP,\n"
+"    EV_ARRAY\n"
+"};\n\n"
+"typedef struct {\n"
+"    int t;\n"
+"    /* the container it's a member of, or -1, and its key there */\n"
+"    int parent;\n"
+"    const char * key;\n"
+"    unsigned int keylen;\n"
+"    long i;\n"
+"    double d;\n"
+"    /* a string, or for a container the count of its members, which\n"
+"     * start at first */\n"
+"    const char * s;\n"
+"    unsigned int len;\n"
+"    unsigned int first;\n"
+"} enum_value;\n\n"
+"typedef struct {\n"
+"    int t;\n"
+"    unsigned int count;\n"
+"    /* the values the container may yet equal, and the members of those\n"
+"     * the next value is matched against */\n"
+"    unsigned int cand[ENUM_WORDS];\n"
+"    unsigned int next[ENUM_WORDS];\n"
+"    /* the values of its own enum, and the containers which matched\n"
+"     * nothing open around it */\n"
+"    unsigned int own, nown, lost;\n"
+"} enum_frame;\n\n",
+                g->nvalues, BITS_WORDS(g->nvalues), g->values_depth);
+    }
+    fprintf(out,
+"struct %s_validator_t {\n"
+"    yajl_handle yajl;\n"
+"    /* yajl keeps a pointer to these, so they can be switched to skip\n"
+"     * the contents of a container */\n"
+"    yajl_callbacks callbacks;\n"
+"    yajl_parser_config cfg;\n"
+"    int started;\n"
+"    /* the node the next value is checked against */\n"
+"    int node;\n"
+"    /* the depth of the containers being skipped */\n"
+"    unsigned int depth;\n"
+"    unsigned int nframes;\n"
+"    frame frames[DEPTH];\n", p);
+    if (g->nvalues) {
+        fputs("    /* while containers are matched against enums, the "
+              "callbacks which\n     * validate, the containers open which "
+              "matched nothing, and the enum\n     * of the one opening */\n"
+              "    yajl_callbacks inner;\n"
+              "    unsigned int nenums, lost, own, nown;\n"
+              "    enum_frame enums[ENUM_DEPTH];\n", out);
+    }
+    if (g->nregexes) fprintf(out, "    pcre * re[%u];\n", g->nregexes);
+    fputs("};\n\n", out);
+
+    fputs("static int v_null(void * ctx);\n"
+          "static int v_boolean(void * ctx, int v);\n"
+          "static int v_integer(void * ctx, long v);\n"
+          "static int v_double(void * ctx, double v);\n"
+          "static int v_string(void * ctx, const unsigned char * v, "
+          "unsigned int len);\n"
+          "static int v_start_map(void * ctx);\n"
+          "static int v_map_key(void * ctx, const unsigned char * key, "
+          "unsigned int len);\n"
+          "static int v_end_map(void * ctx);\n"
+          "static int v_start_array(void * ctx);\n"
+          "static int v_end_array(void * ctx);\n", out);
+    if (g->skips) {
+        fputs("static int skip_open(void * ctx);\n"
+              "static int skip_close(void * ctx);\n", out);
+    }
+    if (g->nvalues) {
+        fputs("static int e_null(void * ctx);\n"
+              "static int e_boolean(void * ctx, int v);\n"
+              "static int e_integer(void * ctx, long v);\n"
+              "static int e_double(void * ctx, double v);\n"
+              "static int e_string(void * ctx, const unsigned char * v, "
+              "unsigned int len);\n"
+              "static int e_start_map(void * ctx);\n"
+              "static int e_map_key(void * ctx, const unsigned char * key, "
+              "unsigned int len);\n"
+              "static int e_end_map(void * ctx);\n"
+              "static int e_start_array(void * ctx);\n"
+              "static int e_end_array(void * ctx);\n", out);
+    }
+    fputs("\nstatic const yajl_callbacks validating = {\n"
+          "    v_null,\n    v_boolean,\n    v_integer,\n    v_double,\n"
+          "    NULL,\n    v_string,\n    v_start_map,\n    v_map_key,\n"
+          "    v_end_map,\n    v_start_array,\n    v_end_array\n};\n\n",
+          out);
+    if (g->skips) {
+        fputs("/* inside a container which isn't validated, yajl neither "
+              "converts\n * numbers nor decodes strings */\n"
+              "static const yajl_callbacks skipping = {\n"
+              "    NULL,\n    NULL,\n    NULL,\n    NULL,\n    NULL,\n"
+              "    NULL,\n    skip_open,\n    NULL,\n    skip_close,\n"
+              "    skip_open,\n    skip_close\n};\n\n", out);
+    }
+    if (g->nvalues) {
+        fputs("/* while containers are matched against enums, each event "
+              "goes by them\n * on its way to the callbacks which "
+              "validate */\n"
+              "static const yajl_callbacks enumerating = {\n"
+              "    e_null,\n    e_boolean,\n    e_integer,\n    e_double,\n"
+              "    NULL,\n    e_string,\n    e_start_map,\n    e_map_key,\n"
+              "    e_end_map,\n    e_start_array,\n    e_end_array\n};\n\n",
+              out);
+    }
+
+    if (g->nregexes) {
+        fputs("static const char * const patterns[] = {\n", out);
+        for (i = 0; i < g->nregexes; i++) {
+            fputs("    ", out);
+            emit_string(out, g->regexes[i], strlen(g->regexes[i]));
+            fputs(i + 1 < g->nregexes ? ",\n" : "\n", out);
+        }
+        fputs("};\n\n", out);
+    }
+    if (g->nformats) {
+        fputs("static const char * const format_names[] = {\n", out);
+        for (i = 0; i < g->nformats; i++) {
+            fputs("    ", out);
+            emit_string(out, g->formats[i], strlen(g->formats[i]));
+            fputs(i + 1 < g->nformats ? ",\n" : "\n", out);
+        }
+        fprintf(out, "};\n\nstatic %s_format_checker formats[%u];\n\n",
+                p, g->nformats);
+    }
+
+    for (i = 0; i < g->nnodes; i++) {
+        if (enum_values(g->nodes[i])) emit_enum(g, g->nodes[i]);
+    }
+
+    emit_seen(g);
+    emit_push(g);
+    if (g->nvalues) {
+        emit_values(g);
+        emit_matching(g);
+    }
+
+    if (g->skips) {
+        /* while containers are matched against enums, yajl calls the
+         * enumerating callbacks, which hand on to these */
+        const char * cb = g->nvalues
+            ? "(s->nenums ? &(s->inner) : &(s->callbacks))"
+            : "&(s->callbacks)";
+        fprintf(out,
+"/* a container which isn't validated has opened */\n"
+"static int\nskip(%s_validator s)\n{\n"
+"    s->depth = 1;\n"
+"    memcpy((void *) %s, (const void *) &skipping,\n"
+"           sizeof(yajl_callbacks));\n"
+"    return 1;\n}\n\n"
+"static int\nskip_open(void * ctx)\n{\n"
+"    ((%s_validator) ctx)->depth++;\n    return 1;\n}\n\n"
+"static int\nskip_close(void * ctx)\n{\n"
+"    %s_validator s = (%s_validator) ctx;\n"
+"    if (--s->depth == 0) {\n"
+"        seen(s);\n"
+"        memcpy((void *) %s, (const void *) &validating,\n"
+"               sizeof(yajl_callbacks));\n"
+"    }\n    return 1;\n}\n\n", p, cb, p, p, p, cb);
+    }
+
+    emit_scalar(g, orderly_json_null, "null", "");
+    emit_scalar(g, orderly_json_boolean, "boolean", ", int v");
+    emit_scalar(g, orderly_json_integer, "integer", ", long v");
+    emit_scalar(g, orderly_json_number, "double", ", double v");
+    emit_scalar(g, orderly_json_string, "string",
+                ", const unsigned char * v,\n         unsigned int len");
+    emit_open(g, orderly_json_object, "start_map");
+    emit_map_key(g);
+    emit_end_map(g);
+    emit_open(g, orderly_json_array, "start_array");
+    emit_end_array(g);
+
+    fprintf(out,
+"static void\nbegin(%s_validator v)\n{\n"
+"    memcpy((void *) &(v->callbacks), (const void *) &validating,\n"
+"           sizeof(yajl_callbacks));\n"
+"    v->yajl = yajl_alloc(&(v->callbacks), &(v->cfg), NULL, (void *) v);\n"
+"    v->started = 0;\n"
+"    v->node = %u;\n"
+"    v->depth = 0;\n"
+"    v->nframes = 1;\n"
+"    v->frames[0].node = -1;\n"
+"    v->frames[0].count = 0;\n", p, g->root->id);
+    if (g->nvalues) {
+        fputs("    v->nenums = 0;\n    v->lost = 0;\n    v->nown = 0;\n", out);
+    }
+    fputs("}\n\n", out);
+
+    fprintf(out,
+"%s_validator\n%s_alloc(const yajl_parser_config * cfg)\n{\n"
+"    %s_validator v = (%s_validator) malloc(sizeof(struct %s_validator_t));\n"
+"    if (!v) return NULL;\n"
+"    memset((void *) v, 0, sizeof(struct %s_validator_t));\n"
+"    if (cfg) {\n"
+"        v->cfg = *cfg;\n"
+"    } else {\n"
+"        v->cfg.allowComments = 0;\n"
+"        v->cfg.checkUTF8 = 1;\n"
+"    }\n", p, p, p, p, p, p);
+    if (g->nregexes) {
+        fprintf(out,
+"    {\n"
+"        /* a pattern pcre won't have checks nothing, as in ajv */\n"
+"        const char * error;\n"
+"        int erroffset;\n"
+"        unsigned int i;\n"
+"        for (i = 0; i < %u; i++) {\n"
+"            v->re[i] = pcre_compile(patterns[i], 0, &error, &erroffset, "
+"NULL);\n"
+"        }\n"
+"    }\n", g->nregexes);
+    }
+    fputs("    begin(v);\n    return v;\n}\n\n", out);
+
+    fprintf(out,
+"void\n%s_reset(%s_validator v)\n{\n"
+"    yajl_free(v->yajl);\n    begin(v);\n}\n\n"
+"void\n%s_free(%s_validator v)\n{\n", p, p, p, p);
+    if (g->nregexes) {
+        fprintf(out, "    unsigned int i;\n"
+                "    for (i = 0; i < %u; i++) {\n"
+                "        if (v->re[i]) pcre_free(v->re[i]);\n    }\n",
+                g->nregexes);
+    }
+    fprintf(out,
+"    yajl_free(v->yajl);\n    free((void *) v);\n}\n\n"
+"yajl_status\n%s_parse(%s_validator v, const unsigned char * text, "
+"unsigned int len)\n{\n"
+"    v->started = 1;\n"
+"    return yajl_parse(v->yajl, text, len);\n}\n\n"
+"yajl_status\n%s_parse_complete(%s_validator v)\n{\n"
+"    yajl_status stat = yajl_parse_complete(v->yajl);\n"
+"    /* an empty root, as ajv_parse_complete */\n"
+"    if ((stat == yajl_status_ok || stat == yajl_status_insufficient_data)\n"
+"        && v->started && !v->frames[0].count)\n"
+"    {\n"
+"        stat = yajl_status_error;\n"
+"    }\n"
+"    return stat;\n}\n\n"
+"int\n%s_validate(const unsigned char * text, unsigned int len, "
+"const yajl_parser_config * cfg)\n{\n"
+"    %s_validator v = %s_alloc(cfg);\n"
+"    yajl_status stat;\n"
+"    if (!v) return 0;\n"
+"    stat = %s_parse(v, text, len);\n"
+"    if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {\n"
+"        stat = %s_parse_complete(v);\n"
+"    }\n"
+"    %s_free(v);\n"
+"    return stat == yajl_status_ok || stat == yajl_status_insufficient_data;\n"
+"}\n\n"
+"int\n%s_register_format(const char * name, %s_format_checker checker)\n{\n",
+            p, p, p, p, p, p, p, p, p, p, p, p);
+    if (g->nformats) {
+        fprintf(out,
+"    unsigned int i;\n"
+"    for (i = 0; i < %u; i++) {\n"
+"        if (!strcmp(name, format_names[i])) {\n"
+"            formats[i] = checker;\n"
+"            return 1;\n"
+"        }\n"
+"    }\n", g->nformats);
+    } else {
+        fputs("    (void) name;\n    (void) checker;\n", out);
+    }
+    fputs("    return 0;\n}\n", out);
+}
+
+int
+main(int argc, char ** argv)
+{
+    static char inbuf[MAX_INPUT_TEXT];
+    size_t tot = 0, rd;
+    orderly_format inform = ORDERLY_UNKNOWN;
+    const char * prefix = "validator", * base = NULL, * file = NULL;
+    orderly_reader r;
+    const orderly_node * n;
+    gen_schema g;
+    FILE * in = stdin;
+    unsigned int i, t;
+    int a = 1;
+
+    while (a < argc && argv[a][0] == '-' && strlen(argv[a]) == 2) {
+        if (a + 1 == argc) usage(argv[0]);
+        switch (argv[a][1]) {
+            case 'i':
+                if (!strcmp("jsonschema", argv[a + 1])) {
+                    inform = ORDERLY_JSONSCHEMA;
+                } else if (!strcmp("orderly", argv[a + 1])) {
+                    inform = ORDERLY_TEXTUAL;
+                } else {
+                    usage(argv[0]);
+                }
+                break;
+            case 'p': prefix = argv[a + 1]; break;
+            case 'o': base = argv[a + 1]; break;
+            default: usage(argv[0]);
+        }
+        a += 2;
+    }
+    if (a < argc) file = argv[a++];
+    if (a < argc) usage(argv[0]);
+
+    if (file && !(in = fopen(file, "rb"))) {
+        fprintf(stderr, "can't open %s\n", file);
+        return 1;
+    }
+    while (tot < MAX_INPUT_TEXT
+           && 0 < (rd = fread((void *) (inbuf + tot), 1,
+                              MAX_INPUT_TEXT - tot, in)))
+    {
+        tot += rd;
+    }
+    if (file) fclose(in);
+
+    r = orderly_reader_new(NULL);
+    n = orderly_read(r, inform, inbuf, tot);
+    if (!n) {
+        fprintf(stderr, "Schema is invalid: %s\n%s\n", orderly_get_error(r),
+                orderly_get_error_context(r, inbuf, tot));
+        orderly_reader_free(&r);
+        return 1;
+    }
+
+    memset((void *) &g, 0, sizeof(g));
+    g.prefix = prefix;
+    g.root = build_tree(&g, n, NULL);
+    g.reached = gen_malloc(g.nnodes * NTYPES);
+    for (i = 0; i < g.nnodes; i++) {
+        if (!is_entry(g.nodes[i])) continue;
+        for (t = 0; t < NTYPES; t++) {
+            const gen_node * d = g.nodes[i]->dispatch[t];
+            if (!d) continue;
+            g.reached[d->id * NTYPES + t] = 1;
+            /* an enum of scalars alone turns containers away instead */
+            if (d->on->t == orderly_node_any
+                && (t == TYPE_INDEX(orderly_json_object)
+                    || t == TYPE_INDEX(orderly_json_array))
+                && (!enum_values(d) || enum_has_containers(d)))
+            {
+                g.skips = 1;
+            }
+        }
+    }
+    /* the enums a container may be checked against */
+    for (i = 0; i < g.nnodes; i++) {
+        gen_node * d = g.nodes[i];
+        if (enum_values(d) && enum_has_containers(d)
+            && (REACHED(&g, d, orderly_json_object)
+                || REACHED(&g, d, orderly_json_array)))
+        {
+            collect_values(&g, d);
+        }
+    }
+
+    if (base) {
+        const char * name = strrchr(base, '/') ? strrchr(base, '/') + 1 : base;
+        char * path = gen_malloc(strlen(base) + 3);
+        char * header = gen_malloc(strlen(name) + 3);
+        FILE * out;
+
+        sprintf(path, "%s.h", base);
+        if (!(out = fopen(path, "w"))) {
+            fprintf(stderr, "can't write %s\n", path);
+            return 1;
+        }
+        emit_header(out, prefix);
+        fclose(out);
+
+        /* the generated code includes the header by its name alone */
+        sprintf(header, "%s.h", name);
+        sprintf(path, "%s.c", base);
+        if (!(g.out = fopen(path, "w"))) {
+            fprintf(stderr, "can't write %s\n", path);
+            return 1;
+        }
+        emit_validator(&g, header);
+        fclose(g.out);
+        free((void *) header);
+        free((void *) path);
+    } else {
+        g.out = stdout;
+        emit_validator(&g, NULL);
+    }
+
+    for (i = 0; i < g.nnodes; i++) free((void *) g.nodes[i]);
+    free((void *) g.nodes);
+    free((void *) g.regexes);
+    free((void *) g.formats);
+    free((void *) g.reached);
+    free((void *) g.values);
+    orderly_reader_free(&r);
+    return 0;
+}
@@ -0,0 +1,478 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#include "ajv_dfa.h"
+
+#include <pcre.h>
+#include <assert.h>
+#include <string.h>
+
+/* patterns are expanded into a chain of positions, one per character
+ * they consume (x{2,3} becomes x x x?).  Sets of positions are the
+ * states of the automaton while it's built, so there may be at most
+ * as many as there are bits in a set */
+typedef unsigned long long ajv_dfa_set;
+#define AJV_DFA_MAX_POSITIONS 63
+/* state 0 is the dead state, which never matches and never leaves */
+#define AJV_DFA_MAX_STATES 256
+#define AJV_DFA_MAX_ATOMS 64
+#define AJV_DFA_INFINITE ((unsigned int) -1)
+
+/* a byte bitmap */
+typedef struct {
+  unsigned char b[32];
+} ajv_dfa_bytes;
+
+#define BYTES_HAS(s, c) ((s)->b[(unsigned char) (c) >> 3] \
+                         & (1 << ((unsigned char) (c) & 7)))
+#define BYTES_ADD(s, c) ((s)->b[(unsigned char) (c) >> 3] \
+                         |= (unsigned char) (1 << ((unsigned char) (c) & 7)))
+
+/* one element of the pattern and how many times it repeats */
+typedef struct {
+  ajv_dfa_bytes set;
+  unsigned int min, max;
+} ajv_dfa_atom;
+
+/* one position in the expanded pattern */
+typedef struct {
+  ajv_dfa_bytes set;
+  /* may be skipped */
+  unsigned char opt;
+  /* may be repeated */
+  unsigned char loop;
+} ajv_dfa_pos;
+
+struct ajv_dfa_t {
+  /* patterns that are a single anchored, quantified class need no
+   * automaton: the subject's length is in range and every byte is in
+   * the class */
+  int span;
+  unsigned char inset[256];
+  unsigned int min, max;
+
+  /* bytes that no position tells apart share a column in next */
+  unsigned char classmap[256];
+  unsigned int nclasses;
+  unsigned int nstates;
+  /* states are numbered by their row's offset into next, which saves
+   * a multiply per byte */
+  unsigned int start;
+  unsigned char *accept;
+  unsigned short *next;
+  /* does the pattern end with $? otherwise any prefix of the subject
+   * may match */
+  int dollar;
+};
+
+static void bytes_range(ajv_dfa_bytes *s, unsigned int lo, unsigned int hi) {
+  for (; lo <= hi; lo++) BYTES_ADD(s, lo);
+}
+
+static void bytes_invert(ajv_dfa_bytes *s) {
+  unsigned int i;
+  for (i = 0; i < sizeof(s->b); i++) s->b[i] = (unsigned char) ~s->b[i];
+}
+
+static void bytes_union(ajv_dfa_bytes *s, const ajv_dfa_bytes *o) {
+  unsigned int i;
+  for (i = 0; i < sizeof(s->b); i++) s->b[i] |= o->b[i];
+}
+
+/* the byte a literal escape stands for, or -1 */
+static int ajv_dfa_escape_byte(char c) {
+  switch (c) {
+  case 't': return '\t';
+  case 'n': return '\n';
+  case 'r': return '\r';
+  case 'f': return '\f';
+  case 'e': return 0x1b;
+  case 'a': return 0x07;
+  }
+  if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+      || (c >= '0' && c <= '9') || c == '\0') {
+    return -1;
+  }
+  return (unsigned char) c;
+}
+
+/* fill in the set for a class escape like \d, returns 0 if c isn't
+ * one */
+static int ajv_dfa_escape_class(char c, ajv_dfa_bytes *s) {
+  memset((void *) s, 0, sizeof(*s));
+  switch (c) {
+  case 'd': case 'D':
+    bytes_range(s, '0', '9');
+    break;
+  case 'w': case 'W':
+    bytes_range(s, '0', '9');
+    bytes_range(s, 'a', 'z');
+    bytes_range(s, 'A', 'Z');
+    BYTES_ADD(s, '_');
+    break;
+  case 's': case 'S':
+    BYTES_ADD(s, ' ');
+    BYTES_ADD(s, '\t');
+    BYTES_ADD(s, '\n');
+    BYTES_ADD(s, '\f');
+    BYTES_ADD(s, '\r');
+#if PCRE_MAJOR > 8 || (PCRE_MAJOR == 8 && PCRE_MINOR >= 34)
+    /* perl added VT to \s, and pcre followed in 8.34 */
+    BYTES_ADD(s, 0x0b);
+#endif
+    break;
+  default:
+    return 0;
+  }
+  if (c >= 'A' && c <= 'Z') bytes_invert(s);
+  return 1;
+}
+
+/* parse a [...] class starting after the [, returns a pointer past the
+ * closing ] or NULL */
+static const char * ajv_dfa_parse_class(const char *p, ajv_dfa_bytes *set) {
+  int neg = 0, first = 1;
+  memset((void *) set, 0, sizeof(*set));
+
+  if (*p == '^') { neg = 1; p++; }
+  for (;; first = 0) {
+    int lo, hi;
+    if (*p == '\0') return NULL;
+    if (*p == ']' && !first) break;
+    /* posix classes and collating elements */
+    if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) return NULL;
+
+    if (*p == '\\') {
+      ajv_dfa_bytes cls;
+      if (ajv_dfa_escape_class(p[1], &cls)) {
+        /* a class can't be the end of a range */
+        if (p[2] == '-' && p[3] != ']') return NULL;
+        bytes_union(set, &cls);
+        p += 2;
+        continue;
+      }
+      if ((lo = ajv_dfa_escape_byte(p[1])) < 0) return NULL;
+      p += 2;
+    } else {
+      lo = (unsigned char) *p++;
+    }
+
+    hi = lo;
+    if (p[0] == '-' && p[1] != ']' && p[1] != '\0') {
+      if (p[1] == '\\') {
+        if ((hi = ajv_dfa_escape_byte(p[2])) < 0) return NULL;
+        p += 3;
+      } else if (p[1] == '[' && (p[2] == ':' || p[2] == '.' || p[2] == '=')) {
+        return NULL;
+      } else {
+        hi = (unsigned char) p[1];
+        p += 2;
+      }
+      if (hi < lo) return NULL;
+    }
+    bytes_range(set, (unsigned int) lo, (unsigned int) hi);
+  }
+  if (neg) bytes_invert(set);
+  return p + 1;
+}
+
+/* parse a decimal count of at most 4 digits */
+static const char * ajv_dfa_parse_count(const char *p, unsigned int *n) {
+  unsigned int digits = 0;
+  *n = 0;
+  while (*p >= '0' && *p <= '9') {
+    if (++digits > 4) return NULL;
+    *n = *n * 10 + (unsigned int) (*p++ - '0');
+  }
+  return digits ? p : NULL;
+}
+
+/* break a pattern into atoms, returns the number found or -1 if the
+ * pattern isn't one we handle */
+static int ajv_dfa_parse(const char *p, ajv_dfa_atom *atoms,
+                         int *caret, int *dollar)
+{
+  int natoms = 0;
+  *caret = *dollar = 0;
+
+  if (*p == '^') { *caret = 1; p++; }
+
+  while (*p) {
+    ajv_dfa_atom *a;
+    int c;
+
+    if (*p == '$' && p[1] == '\0') { *dollar = 1; break; }
+    if (natoms == AJV_DFA_MAX_ATOMS) return -1;
+    a = atoms + natoms++;
+    memset((void *) a, 0, sizeof(*a));
+    a->min = a->max = 1;
+
+    switch (*p) {
+    case '^': case '$': case '|': case '(': case ')':
+    case '*': case '+': case '?': case '{':
+      return -1;
+    case '.':
+      bytes_range(&(a->set), 0, 255);
+      a->set.b['\n' >> 3] &= (unsigned char) ~(1 << ('\n' & 7));
+      p++;
+      break;
+    case '[':
+      if (!(p = ajv_dfa_parse_class(p + 1, &(a->set)))) return -1;
+      break;
+    case '\\':
+      if (!ajv_dfa_escape_class(p[1], &(a->set))) {
+        if ((c = ajv_dfa_escape_byte(p[1])) < 0) return -1;
+        BYTES_ADD(&(a->set), c);
+      }
+      p += 2;
+      break;
+    default:
+      BYTES_ADD(&(a->set), *p);
+      p++;
+    }
+
+    switch (*p) {
+    case '?': a->min = 0; a->max = 1; p++; break;
+    case '*': a->min = 0; a->max = AJV_DFA_INFINITE; p++; break;
+    case '+': a->min = 1; a->max = AJV_DFA_INFINITE; p++; break;
+    case '{':
+      /* anything but {n}, {n,} or {n,m} is a literal { to pcre, leave
+       * those to it */
+      if (!(p = ajv_dfa_parse_count(p + 1, &(a->min)))) return -1;
+      if (*p == ',') {
+        if (p[1] == '}') {
+          a->max = AJV_DFA_INFINITE;
+          p++;
+        } else if (!(p = ajv_dfa_parse_count(p + 1, &(a->max)))) {
+          return -1;
+        }
+      } else {
+        a->max = a->min;
+      }
+      if (*p != '}' || a->max < a->min) return -1;
+      p++;
+      break;
+    default:
+      continue;
+    }
+    /* lazy quantifiers match the same strings, possessive ones may
+     * not, and a repeated repeat is an error */
+    if (*p == '?') p++;
+    if (*p == '+' || *p == '*' || *p == '?' || *p == '{') return -1;
+  }
+  return natoms;
+}
+
+/* add the positions reachable from those in s without consuming
+ * anything */
+static ajv_dfa_set ajv_dfa_closure(const ajv_dfa_pos *pos, unsigned int npos,
+                                   ajv_dfa_set s)
+{
+  unsigned int j;
+  for (j = 0; j < npos; j++) {
+    if ((s & ((ajv_dfa_set) 1 << j)) && pos[j].opt) {
+      s |= (ajv_dfa_set) 1 << (j + 1);
+    }
+  }
+  return s;
+}
+
+static ajv_dfa_set ajv_dfa_step(const ajv_dfa_pos *pos, unsigned int npos,
+                                ajv_dfa_set s, unsigned char c)
+{
+  ajv_dfa_set t = 0;
+  unsigned int j;
+  for (j = 0; j < npos; j++) {
+    if ((s & ((ajv_dfa_set) 1 << j)) && BYTES_HAS(&(pos[j].set), c)) {
+      t |= (ajv_dfa_set) 1 << (j + 1);
+      if (pos[j].loop) t |= (ajv_dfa_set) 1 << j;
+    }
+  }
+  return ajv_dfa_closure(pos, npos, t);
+}
+
+/* build the automaton by subset construction.  returns 0 if it grows
+ * too large */
+static int ajv_dfa_build(const orderly_alloc_funcs * alloc, ajv_dfa dfa,
+                         const ajv_dfa_pos *pos, unsigned int npos)
+{
+  ajv_dfa_set sets[AJV_DFA_MAX_STATES];
+  unsigned char rep[256];
+  unsigned int b, i, j, c;
+  unsigned short *next;
+
+  /* group the bytes no position tells apart */
+  dfa->nclasses = 0;
+  for (b = 0; b < 256; b++) {
+    for (c = 0; c < dfa->nclasses; c++) {
+      for (j = 0; j < npos; j++) {
+        if (!BYTES_HAS(&(pos[j].set), b) != !BYTES_HAS(&(pos[j].set), rep[c])) {
+          break;
+        }
+      }
+      if (j == npos) break;
+    }
+    if (c == dfa->nclasses) rep[dfa->nclasses++] = (unsigned char) b;
+    dfa->classmap[b] = (unsigned char) c;
+  }
+
+  next = OR_MALLOC(alloc, sizeof(unsigned short)
+                   * AJV_DFA_MAX_STATES * dfa->nclasses);
+  sets[0] = 0;
+  sets[1] = ajv_dfa_closure(pos, npos, 1);
+  dfa->start = dfa->nclasses;
+  dfa->nstates = 2;
+  memset((void *) next, 0, sizeof(unsigned short) * dfa->nclasses);
+
+  for (i = 1; i < dfa->nstates; i++) {
+    for (c = 0; c < dfa->nclasses; c++) {
+      ajv_dfa_set t = ajv_dfa_step(pos, npos, sets[i], rep[c]);
+      for (j = 0; j < dfa->nstates; j++) {
+        if (sets[j] == t) break;
+      }
+      if (j == dfa->nstates) {
+        if (dfa->nstates == AJV_DFA_MAX_STATES) {
+          OR_FREE(alloc, next);
+          return 0;
+        }
+        sets[dfa->nstates++] = t;
+      }
+      next[i * dfa->nclasses + c] = (unsigned short) (j * dfa->nclasses);
+    }
+  }
+
+  dfa->next = OR_MALLOC(alloc, sizeof(unsigned short)
+                        * dfa->nstates * dfa->nclasses);
+  memcpy((void *) dfa->next, (void *) next,
+         sizeof(unsigned short) * dfa->nstates * dfa->nclasses);
+  OR_FREE(alloc, next);
+
+  dfa->accept = OR_MALLOC(alloc, dfa->nstates);
+  for (i = 0; i < dfa->nstates; i++) {
+    dfa->accept[i] = (unsigned char) ((sets[i] >> npos) & 1);
+  }
+  return 1;
+}
+
+ajv_dfa ajv_dfa_compile(const orderly_alloc_funcs * alloc,
+                        const char * pattern)
+{
+  ajv_dfa_atom atoms[AJV_DFA_MAX_ATOMS];
+  ajv_dfa_pos pos[AJV_DFA_MAX_POSITIONS];
+  unsigned int npos = 0, i, k;
+  int natoms, caret, dollar;
+  ajv_dfa dfa;
+
+  natoms = ajv_dfa_parse(pattern, atoms, &caret, &dollar);
+  if (natoms < 0) return NULL;
+
+  dfa = OR_MALLOC(alloc, sizeof(struct ajv_dfa_t));
+  memset((void *) dfa, 0, sizeof(struct ajv_dfa_t));
+  dfa->dollar = dollar;
+
+  if (caret && dollar && natoms == 1) {
+    dfa->span = 1;
+    dfa->min = atoms[0].min;
+    dfa->max = atoms[0].max;
+    for (i = 0; i < 256; i++) {
+      dfa->inset[i] = BYTES_HAS(&(atoms[0].set), i) ? 1 : 0;
+    }
+    return dfa;
+  }
+
+  /* an unanchored pattern may start anywhere */
+  if (!caret) {
+    bytes_range(&(pos[npos].set), 0, 255);
+    pos[npos].opt = pos[npos].loop = 1;
+    npos++;
+  }
+  for (i = 0; i < (unsigned int) natoms; i++) {
+    unsigned int copies = atoms[i].max == AJV_DFA_INFINITE
+      ? atoms[i].min + 1 : atoms[i].max;
+    if (copies > AJV_DFA_MAX_POSITIONS - npos) {
+      OR_FREE(alloc, dfa);
+      return NULL;
+    }
+    for (k = 0; k < copies; k++, npos++) {
+      pos[npos].set = atoms[i].set;
+      pos[npos].opt = k >= atoms[i].min;
+      pos[npos].loop = atoms[i].max == AJV_DFA_INFINITE && k == atoms[i].min;
+    }
+  }
+
+  if (!ajv_dfa_build(alloc, dfa, pos, npos)) {
+    OR_FREE(alloc, dfa);
+    return NULL;
+  }
+  return dfa;
+}
+
+int ajv_dfa_match(const struct ajv_dfa_t * dfa, const unsigned char * s,
+                  unsigned int len)
+{
+  unsigned int i, state, prev;
+
+  if (dfa->span) {
+    for (i = 0; i < len && dfa->inset[s[i]]; i++) ;
+    if (i == len && len >= dfa->min && len <= dfa->max) return 1;
+    /* $ also matches before a final newline */
+    return len > 0 && s[len - 1] == '\n' && i >= len - 1
+      && len - 1 >= dfa->min && len - 1 <= dfa->max;
+  }
+
+  state = prev = dfa->start;
+  if (!dfa->dollar) {
+    /* matching any prefix will do */
+    for (i = 0; i < len; i++) {
+      if (dfa->accept[state / dfa->nclasses]) return 1;
+      if (!(state = dfa->next[state + dfa->classmap[s[i]]])) return 0;
+    }
+    return dfa->accept[state / dfa->nclasses];
+  }
+
+  for (i = 0; i < len; i++) {
+    prev = state;
+    if (!(state = dfa->next[state + dfa->classmap[s[i]]])) break;
+  }
+  if (i == len && dfa->accept[state / dfa->nclasses]) return 1;
+  return len > 0 && s[len - 1] == '\n' && i >= len - 1
+    && dfa->accept[prev / dfa->nclasses];
+}
+
+void ajv_dfa_free(const orderly_alloc_funcs * alloc, ajv_dfa dfa) {
+  if (dfa) {
+    if (dfa->next) OR_FREE(alloc, dfa->next);
+    if (dfa->accept) OR_FREE(alloc, dfa->accept);
+    OR_FREE(alloc, dfa);
+  }
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#ifndef __AJV_DFA_H__
+#define __AJV_DFA_H__
+
+#include "orderly_alloc.h"
+
+/* a deterministic automaton for the simple patterns most schemas use:
+ * literals, character classes and ., each optionally quantified, and
+ * optionally anchored with ^ and $.  Such patterns are matched in one
+ * pass over the subject without ever backtracking.  Matching follows
+ * pcre with no options: bytes, not characters, and a $ which also
+ * matches before a newline that ends the subject. */
+typedef struct ajv_dfa_t * ajv_dfa;
+
+/* returns NULL if the pattern uses anything outside that subset, or
+ * would need an unreasonably large automaton.  Such patterns are left
+ * to pcre */
+ajv_dfa ajv_dfa_compile(const orderly_alloc_funcs * alloc,
+                        const char * pattern);
+
+/* does the subject match? */
+int ajv_dfa_match(const struct ajv_dfa_t * dfa, const unsigned char * s,
+                  unsigned int len);
+
+void ajv_dfa_free(const orderly_alloc_funcs * alloc, ajv_dfa dfa);
+
+#endif
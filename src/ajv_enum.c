@@ -0,0 +1,621 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#include "ajv_enum.h"
+#include "ajv_schema.h"
+#include "orderly_json.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *s;
+  unsigned int len;
+  unsigned int hash;
+} ajv_enum_str;
+
+/* an enumerated object or array, NULL in an empty slot */
+typedef struct {
+  const orderly_json *v;
+  ajv_enum_hash hash;
+  unsigned long size;
+} ajv_enum_container;
+
+struct ajv_enum_t {
+  /* bit 0 for false, bit 1 for true */
+  unsigned int bools;
+  /* an open addressed hash of the strings, at most half full */
+  ajv_enum_str *strs;
+  unsigned int strmask;
+  /* the integers, sorted */
+  long *ints;
+  unsigned int nints;
+  /* the integers as doubles, sorted, for matching numbers */
+  double *intnums;
+  /* the numbers, sorted */
+  double *nums;
+  unsigned int nnums;
+  /* integer enums covering not much more than their range are also a
+   * bitmap of [intmin, intmin + intspan) */
+  ajv_bitword *intbits;
+  long intmin;
+  unsigned long intspan;
+  /* an open addressed hash of the objects and arrays, at most half
+   * full, and the size of the largest */
+  ajv_enum_container *conts;
+  unsigned int contmask;
+  unsigned long contmax;
+};
+
+/* the hashing of containers.  every event counts towards the size of
+ * the container it's in, the same whichever way a number is written,
+ * so equal containers are the same size */
+#define AJV_ENUM_SIZE_SCALAR 1
+#define AJV_ENUM_SIZE_NUMBER 9
+#define AJV_ENUM_SIZE_TEXT(len) (5 + (unsigned long) (len))
+#define AJV_ENUM_SIZE_START 5
+#define AJV_ENUM_SIZE_END 1
+
+/* spreads every bit of h over all those of the result */
+static ajv_enum_hash ajv_enum_mix(ajv_enum_hash h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/* a value of the type tagged, null 1, booleans 2, numbers 3, strings
+ * 4, arrays 5 and objects 6, with bits as its payload */
+static ajv_enum_hash ajv_enum_hash_of(unsigned int tag, ajv_enum_hash bits) {
+  return ajv_enum_mix(bits ^ (tag * 0x9e3779b97f4a7c15ULL));
+}
+
+/* numbers by value, so that an integer hashes as a number equal to it
+ * does */
+static ajv_enum_hash ajv_enum_hash_number(double d) {
+  ajv_enum_hash bits;
+  if (d == 0) d = 0; /* -0 */
+  memcpy((void *) &bits, (const void *) &d, sizeof(bits));
+  return ajv_enum_hash_of(3, bits);
+}
+
+static ajv_enum_hash ajv_enum_hash_text(const char *s, unsigned int len) {
+  return ((ajv_enum_hash) len << 32) | ajv_hash_key(s, len);
+}
+
+/* arrays take their elements in order, objects the sum of their
+ * members, which is the same in any order */
+static ajv_enum_hash ajv_enum_hash_add(const ajv_enum_frame *f,
+                                       ajv_enum_hash v) {
+  if (f->object) {
+    return f->hash + ajv_enum_mix(f->key * 0x9e3779b97f4a7c15ULL + v);
+  }
+  return ajv_enum_mix(f->hash ^ v);
+}
+
+static ajv_enum_hash ajv_enum_hash_end(const ajv_enum_frame *f) {
+  return f->object ? ajv_enum_hash_of(6, f->hash) : f->hash;
+}
+
+static void ajv_enum_frame_start(ajv_enum_frame *f, int object) {
+  f->object = object;
+  f->hash = object ? 0 : ajv_enum_hash_of(5, 0);
+  f->key = 0;
+}
+
+/* hash an enumerated value, and add up its size */
+static ajv_enum_hash ajv_enum_hash_json(const orderly_json *j,
+                                        unsigned long *size) {
+  ajv_enum_frame f;
+  const orderly_json *kid;
+  switch (j->t) {
+  case orderly_json_boolean:
+    *size += AJV_ENUM_SIZE_SCALAR;
+    return ajv_enum_hash_of(2, j->v.b != 0);
+  case orderly_json_integer:
+    *size += AJV_ENUM_SIZE_NUMBER;
+    return ajv_enum_hash_number((double) (long) j->v.i);
+  case orderly_json_number:
+    *size += AJV_ENUM_SIZE_NUMBER;
+    return ajv_enum_hash_number(j->v.n);
+  case orderly_json_string:
+    *size += AJV_ENUM_SIZE_TEXT(strlen(j->v.s));
+    return ajv_enum_hash_of(4, ajv_enum_hash_text(j->v.s, strlen(j->v.s)));
+  case orderly_json_object:
+  case orderly_json_array:
+    *size += AJV_ENUM_SIZE_START + AJV_ENUM_SIZE_END;
+    ajv_enum_frame_start(&f, j->t == orderly_json_object);
+    for (kid = j->v.children.first; kid; kid = kid->next) {
+      if (f.object) {
+        *size += AJV_ENUM_SIZE_TEXT(strlen(kid->k));
+        f.key = ajv_enum_hash_text(kid->k, strlen(kid->k));
+      }
+      f.hash = ajv_enum_hash_add(&f, ajv_enum_hash_json(kid, size));
+    }
+    return ajv_enum_hash_end(&f);
+  default:
+    *size += AJV_ENUM_SIZE_SCALAR;
+    return ajv_enum_hash_of(1, 0);
+  }
+}
+
+static int ajv_enum_cmp_long(const void *a, const void *b) {
+  long x = *(const long *) a, y = *(const long *) b;
+  return x < y ? -1 : x > y;
+}
+
+static int ajv_enum_cmp_double(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+ajv_enum ajv_enum_compile(const orderly_alloc_funcs * alloc,
+                          const orderly_json * values)
+{
+  const orderly_json *cur;
+  unsigned int nstrs = 0, nconts = 0, size = 4, i;
+  ajv_enum e;
+
+  if (!values || values->t != orderly_json_array) return NULL;
+
+  e = OR_MALLOC(alloc, sizeof(struct ajv_enum_t));
+  memset((void *) e, 0, sizeof(struct ajv_enum_t));
+
+  for (cur = values->v.children.first; cur; cur = cur->next) {
+    switch (cur->t) {
+    case orderly_json_string:  nstrs++; break;
+    case orderly_json_integer: e->nints++; break;
+    case orderly_json_number:  e->nnums++; break;
+    case orderly_json_boolean: e->bools |= cur->v.b ? 2 : 1; break;
+    case orderly_json_object:
+    case orderly_json_array:   nconts++; break;
+    default: break;
+    }
+  }
+
+  if (nstrs) {
+    while (size < nstrs * 2) size <<= 1;
+    e->strs = OR_MALLOC(alloc, sizeof(ajv_enum_str) * size);
+    memset((void *) e->strs, 0, sizeof(ajv_enum_str) * size);
+    e->strmask = size - 1;
+  }
+  if (e->nints) {
+    e->ints = OR_MALLOC(alloc, sizeof(long) * e->nints);
+    e->intnums = OR_MALLOC(alloc, sizeof(double) * e->nints);
+  }
+  if (e->nnums) e->nums = OR_MALLOC(alloc, sizeof(double) * e->nnums);
+  if (nconts) {
+    for (size = 4; size < nconts * 2; size <<= 1) ;
+    e->conts = OR_MALLOC(alloc, sizeof(ajv_enum_container) * size);
+    memset((void *) e->conts, 0, sizeof(ajv_enum_container) * size);
+    e->contmask = size - 1;
+  }
+
+  e->nints = e->nnums = 0;
+  for (cur = values->v.children.first; cur; cur = cur->next) {
+    if (cur->t == orderly_json_string) {
+      unsigned int len = strlen(cur->v.s), h = ajv_hash_key(cur->v.s, len);
+      for (i = h & e->strmask; e->strs[i].s; i = (i + 1) & e->strmask) {
+        if (e->strs[i].len == len && !memcmp(e->strs[i].s, cur->v.s, len)) {
+          break;
+        }
+      }
+      e->strs[i].s = cur->v.s;
+      e->strs[i].len = len;
+      e->strs[i].hash = h;
+    } else if (cur->t == orderly_json_integer) {
+      e->intnums[e->nints] = (double) cur->v.i;
+      e->ints[e->nints++] = (long) cur->v.i;
+    } else if (cur->t == orderly_json_number) {
+      e->nums[e->nnums++] = cur->v.n;
+    } else if (cur->t == orderly_json_object
+               || cur->t == orderly_json_array) {
+      unsigned long csize = 0;
+      ajv_enum_hash h = ajv_enum_hash_json(cur, &csize);
+      for (i = (unsigned int) h & e->contmask; e->conts[i].v;
+           i = (i + 1) & e->contmask) ;
+      e->conts[i].v = cur;
+      e->conts[i].hash = h;
+      e->conts[i].size = csize;
+      if (csize > e->contmax) e->contmax = csize;
+    }
+  }
+
+  if (e->nints) {
+    qsort(e->ints, e->nints, sizeof(long), ajv_enum_cmp_long);
+    qsort(e->intnums, e->nints, sizeof(double), ajv_enum_cmp_double);
+    e->intmin = e->ints[0];
+    e->intspan = (unsigned long) e->ints[e->nints - 1]
+      - (unsigned long) e->intmin + 1;
+    /* a bitmap no more than four times the size of the array */
+    if (e->intspan != 0 && e->intspan / AJV_WORD_BITS
+        <= e->nints * sizeof(long) * 4 / sizeof(ajv_bitword)) {
+      unsigned long words = AJV_BITS_WORDS(e->intspan);
+      e->intbits = OR_MALLOC(alloc, sizeof(ajv_bitword) * words);
+      memset((void *) e->intbits, 0, sizeof(ajv_bitword) * words);
+      for (i = 0; i < e->nints; i++) {
+        AJV_BIT_SET(e->intbits,
+                    (unsigned long) e->ints[i] - (unsigned long) e->intmin);
+      }
+    }
+  }
+  if (e->nnums) qsort(e->nums, e->nnums, sizeof(double), ajv_enum_cmp_double);
+
+  return e;
+}
+
+void ajv_enum_free(const orderly_alloc_funcs * alloc, ajv_enum e) {
+  if (e) {
+    if (e->strs) OR_FREE(alloc, e->strs);
+    if (e->ints) OR_FREE(alloc, e->ints);
+    if (e->intnums) OR_FREE(alloc, e->intnums);
+    if (e->nums) OR_FREE(alloc, e->nums);
+    if (e->intbits) OR_FREE(alloc, e->intbits);
+    if (e->conts) OR_FREE(alloc, e->conts);
+    OR_FREE(alloc, e);
+  }
+}
+
+int ajv_enum_has_boolean(const struct ajv_enum_t * e, int b) {
+  return (e->bools & (b ? 2 : 1)) != 0;
+}
+
+static int ajv_enum_bsearch_double(const double *a, unsigned int n,
+                                   double d)
+{
+  unsigned int lo = 0, hi = n;
+  while (lo < hi) {
+    unsigned int mid = lo + (hi - lo) / 2;
+    if (a[mid] < d) lo = mid + 1;
+    else if (a[mid] > d) hi = mid;
+    else return 1;
+  }
+  return 0;
+}
+
+int ajv_enum_has_integer(const struct ajv_enum_t * e, long l) {
+  if (e->intbits) {
+    unsigned long off = (unsigned long) l - (unsigned long) e->intmin;
+    if (l >= e->intmin && off < e->intspan
+        && (e->intbits[off / AJV_WORD_BITS]
+            & ((ajv_bitword) 1 << (off % AJV_WORD_BITS)))) {
+      return 1;
+    }
+  } else {
+    unsigned int lo = 0, hi = e->nints;
+    while (lo < hi) {
+      unsigned int mid = lo + (hi - lo) / 2;
+      if (e->ints[mid] < l) lo = mid + 1;
+      else if (e->ints[mid] > l) hi = mid;
+      else return 1;
+    }
+  }
+  return ajv_enum_bsearch_double(e->nums, e->nnums, (double) l);
+}
+
+int ajv_enum_has_double(const struct ajv_enum_t * e, double d) {
+  return ajv_enum_bsearch_double(e->nums, e->nnums, d)
+    || ajv_enum_bsearch_double(e->intnums, e->nints, d);
+}
+
+int ajv_enum_has_string(const struct ajv_enum_t * e, const char * s,
+                        unsigned int len)
+{
+  unsigned int h, i;
+  if (!e->strs) return 0;
+  h = ajv_hash_key(s, len);
+  for (i = h & e->strmask; e->strs[i].s; i = (i + 1) & e->strmask) {
+    if (e->strs[i].hash == h && e->strs[i].len == len
+        && !memcmp(e->strs[i].s, s, len)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int ajv_enum_has_containers(const struct ajv_enum_t * e) {
+  return e->conts != NULL;
+}
+
+/* is the value at pos on tape equal to j, as ajv_enum_has_* have it? */
+static int ajv_enum_tape_equal(const orderly_tape *tape, unsigned int pos,
+                               const orderly_json *j)
+{
+  const unsigned char *text;
+  unsigned int len, end, n = 0;
+  const orderly_json *kid;
+  long l;
+  double d;
+
+  switch (orderly_tape_event_at(tape, pos)) {
+  case orderly_tape_null:
+    return j->t == orderly_json_null;
+  case orderly_tape_false:
+  case orderly_tape_true:
+    return j->t == orderly_json_boolean
+      && !j->v.b == (orderly_tape_event_at(tape, pos) == orderly_tape_false);
+  case orderly_tape_integer:
+    memcpy((void *) &l, (const void *) (tape->data + pos + 1), sizeof(long));
+    if (j->t == orderly_json_integer) return (long) j->v.i == l;
+    return j->t == orderly_json_number && j->v.n == (double) l;
+  case orderly_tape_double:
+    memcpy((void *) &d, (const void *) (tape->data + pos + 1),
+           sizeof(double));
+    if (j->t == orderly_json_integer) return (double) (long) j->v.i == d;
+    return j->t == orderly_json_number && j->v.n == d;
+  case orderly_tape_string:
+    text = orderly_tape_text(tape, pos, &len);
+    return j->t == orderly_json_string && strlen(j->v.s) == len
+      && !memcmp(j->v.s, text, len);
+  case orderly_tape_start_map:
+    if (j->t != orderly_json_object) return 0;
+    end = orderly_tape_skip(tape, pos) - 1;
+    for (pos = orderly_tape_next(tape, pos); pos < end; n++) {
+      text = orderly_tape_text(tape, pos, &len);
+      kid = orderly_json_find(j, (const char *) text, len);
+      pos = orderly_tape_skip(tape, pos);
+      if (!kid || !ajv_enum_tape_equal(tape, pos, kid)) return 0;
+      pos = orderly_tape_skip(tape, pos);
+    }
+    return n == orderly_json_count(j);
+  case orderly_tape_start_array:
+    if (j->t != orderly_json_array) return 0;
+    end = orderly_tape_skip(tape, pos) - 1;
+    kid = j->v.children.first;
+    for (pos = orderly_tape_next(tape, pos); pos < end;
+         pos = orderly_tape_skip(tape, pos), kid = kid->next) {
+      if (!kid || !ajv_enum_tape_equal(tape, pos, kid)) return 0;
+    }
+    return kid == NULL;
+  default:
+    return 0;
+  }
+}
+
+/* is the container which hashes to h and is size big, at pos on the
+ * tape if it was kept, one of e's? */
+static int ajv_enum_has_container(const struct ajv_enum_t *e,
+                                  ajv_enum_hash h, unsigned long size,
+                                  const orderly_tape *tape, unsigned int pos)
+{
+  unsigned int i;
+  for (i = (unsigned int) h & e->contmask; e->conts[i].v;
+       i = (i + 1) & e->contmask) {
+    if (e->conts[i].hash == h && e->conts[i].size == size && tape
+        && ajv_enum_tape_equal(tape, pos, e->conts[i].v)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void ajv_enum_matcher_init(ajv_enum_matcher * m,
+                           const orderly_alloc_funcs * alloc)
+{
+  memset((void *) m, 0, sizeof(ajv_enum_matcher));
+  m->alloc = alloc;
+  orderly_tape_init(&(m->tape));
+  orderly_tape_builder_init(&(m->builder), alloc, &(m->tape));
+}
+
+void ajv_enum_matcher_free(ajv_enum_matcher * m) {
+  if (m->frames) OR_FREE(m->alloc, m->frames);
+  if (m->matches) OR_FREE(m->alloc, m->matches);
+  orderly_tape_builder_free(&(m->builder));
+  orderly_tape_free(m->alloc, &(m->tape));
+}
+
+void ajv_enum_matcher_reset(ajv_enum_matcher * m) {
+  m->nframes = m->nmatches = 0;
+}
+
+/* can the match under way still be confirmed: are its container's
+ * events on the tape, and no bigger than its enum's largest? */
+static int ajv_enum_viable(const ajv_enum_matcher *m,
+                           const ajv_enum_pending *match)
+{
+  const ajv_enum_frame *f = &(m->frames[match->frame]);
+  return f->kept && m->size - f->size <= match->e->contmax;
+}
+
+void ajv_enum_match(ajv_enum_matcher * m, const struct ajv_enum_t * e,
+                    const struct ajv_node_t * node)
+{
+  ajv_enum_pending *match;
+  unsigned int i;
+
+  if (!m->nmatches) {
+    m->nframes = 0;
+    m->size = 0;
+  }
+  for (i = 0; i < m->nmatches && !ajv_enum_viable(m, &(m->matches[i])); i++)
+    ;
+  if (i == m->nmatches) {
+    /* nothing on the tape can be used any more, so it starts over
+     * with this match's container */
+    for (i = 0; i < m->nframes; i++) m->frames[i].kept = 0;
+    m->tape.len = 0;
+    m->builder.depth = 0;
+    m->keeping = 1;
+    m->limit = m->size;
+  }
+  if (m->nmatches == m->matchescap) {
+    m->matchescap = m->matchescap ? m->matchescap * 2 : 4;
+    m->matches = OR_REALLOC(m->alloc, m->matches,
+                            sizeof(ajv_enum_pending) * m->matchescap);
+  }
+  match = &(m->matches[m->nmatches++]);
+  match->e = e;
+  match->node = node;
+  match->frame = m->nframes;
+  if (m->size + e->contmax > m->limit) m->limit = m->size + e->contmax;
+}
+
+/* count an event's size, and stop keeping events once they're more
+ * than any match can be confirmed with */
+static int ajv_enum_grow(ajv_enum_matcher *m, unsigned long size) {
+  m->size += size;
+  if (m->size > m->limit) m->keeping = 0;
+  return m->keeping;
+}
+
+/* a value in the innermost container, which there always is */
+static void ajv_enum_value(ajv_enum_matcher *m, ajv_enum_hash v) {
+  ajv_enum_frame *f = &(m->frames[m->nframes - 1]);
+  f->hash = ajv_enum_hash_add(f, v);
+}
+
+#define AJV_MATCHER(ctx) ((ajv_enum_matcher *) (ctx))
+
+static int ajv_enum_null(void * ctx) {
+  ajv_enum_matcher *m = AJV_MATCHER(ctx);
+  ajv_enum_value(m, ajv_enum_hash_of(1, 0));
+  if (ajv_enum_grow(m, AJV_ENUM_SIZE_SCALAR)) {
+    orderly_tape_callbacks.yajl_null(&(m->builder));
+  }
+  return 1;
+}
+
+static int ajv_enum_boolean(void * ctx, int b) {
+  ajv_enum_matcher *m = AJV_MATCHER(ctx);
+  ajv_enum_value(m, ajv_enum_hash_of(2, b != 0));
+  if (ajv_enum_grow(m, AJV_ENUM_SIZE_SCALAR)) {
+    orderly_tape_callbacks.yajl_boolean(&(m->builder), b);
+  }
+  return 1;
+}
+
+static int ajv_enum_integer(void * ctx, long l) {
+  ajv_enum_matcher *m = AJV_MATCHER(ctx);
+  ajv_enum_value(m, ajv_enum_hash_number((double) l));
+  if (ajv_enum_grow(m, AJV_ENUM_SIZE_NUMBER)) {
+    orderly_tape_callbacks.yajl_integer(&(m->builder), l);
+  }
+  return 1;
+}
+
+static int ajv_enum_double(void * ctx, double d) {
+  ajv_enum_matcher *m = AJV_MATCHER(ctx);
+  ajv_enum_value(m, ajv_enum_hash_number(d));
+  if (ajv_enum_grow(m, AJV_ENUM_SIZE_NUMBER)) {
+    orderly_tape_callbacks.yajl_double(&(m->builder), d);
+  }
+  return 1;
+}
+
+static int ajv_enum_string(void * ctx, const unsigned char * s,
+                           unsigned int len) {
+  ajv_enum_matcher *m = AJV_MATCHER(ctx);
+  ajv_enum_value(m, ajv_enum_hash_of(4, ajv_enum_hash_text(
+                                            (const char *) s, len)));
+  if (ajv_enum_grow(m, AJV_ENUM_SIZE_TEXT(len))) {
+    orderly_tape_callbacks.yajl_string(&(m->builder), s, len);
+  }
+  return 1;
+}
+
+static int ajv_enum_key(void * ctx, const unsigned char * s,
+                        unsigned int len) {
+  ajv_enum_matcher *m = AJV_MATCHER(ctx);
+  m->frames[m->nframes - 1].key = ajv_enum_hash_text((const char *) s, len);
+  if (ajv_enum_grow(m, AJV_ENUM_SIZE_TEXT(len))) {
+    orderly_tape_callbacks.yajl_map_key(&(m->builder), s, len);
+  }
+  return 1;
+}
+
+static void ajv_enum_start(ajv_enum_matcher *m, int object) {
+  ajv_enum_frame *f;
+  if (m->nframes == m->framescap) {
+    m->framescap = m->framescap ? m->framescap * 2 : 16;
+    m->frames = OR_REALLOC(m->alloc, m->frames,
+                           sizeof(ajv_enum_frame) * m->framescap);
+  }
+  f = &(m->frames[m->nframes++]);
+  ajv_enum_frame_start(f, object);
+  f->size = m->size;
+  f->pos = m->tape.len;
+  f->kept = ajv_enum_grow(m, AJV_ENUM_SIZE_START);
+  if (f->kept) {
+    if (object) orderly_tape_callbacks.yajl_start_map(&(m->builder));
+    else orderly_tape_callbacks.yajl_start_array(&(m->builder));
+  }
+}
+
+static int ajv_enum_start_map(void * ctx) {
+  ajv_enum_start(AJV_MATCHER(ctx), 1);
+  return 1;
+}
+
+static int ajv_enum_start_array(void * ctx) {
+  ajv_enum_start(AJV_MATCHER(ctx), 0);
+  return 1;
+}
+
+const yajl_callbacks ajv_enum_callbacks = {
+  ajv_enum_null,
+  ajv_enum_boolean,
+  ajv_enum_integer,
+  ajv_enum_double,
+  NULL,
+  ajv_enum_string,
+  ajv_enum_start_map,
+  ajv_enum_key,
+  NULL,
+  ajv_enum_start_array,
+  NULL
+};
+
+const struct ajv_node_t * ajv_enum_end(ajv_enum_matcher * m) {
+  ajv_enum_frame *f = &(m->frames[--m->nframes]);
+  ajv_enum_pending *match;
+  ajv_enum_hash h = ajv_enum_hash_end(f);
+  unsigned long size;
+  int kept = ajv_enum_grow(m, AJV_ENUM_SIZE_END) && f->kept;
+
+  if (kept) orderly_tape_callbacks.yajl_end_map(&(m->builder));
+  if (m->nframes) ajv_enum_value(m, h);
+
+  match = &(m->matches[m->nmatches - 1]);
+  if (match->frame != m->nframes) return NULL;
+  m->nmatches--;
+  size = m->size - f->size;
+  if (size <= match->e->contmax
+      && ajv_enum_has_container(match->e, h, size,
+                                kept ? &(m->tape) : NULL, f->pos)) {
+    return NULL;
+  }
+  return match->node;
+}
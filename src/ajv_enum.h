@@ -0,0 +1,146 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#ifndef __AJV_ENUM_H__
+#define __AJV_ENUM_H__
+
+#include "api/json.h"
+#include "orderly_alloc.h"
+#include "orderly_tape.h"
+
+#include <yajl/yajl_parse.h>
+
+/* the enumerated values of a node, indexed by type when the schema is
+ * compiled so that validating a value doesn't mean walking the list:
+ * strings are hashed, integers and numbers are kept sorted, dense
+ * integer enums are kept as a bitmap too, and objects and arrays are
+ * hashed whole, see ajv_enum_matcher */
+typedef struct ajv_enum_t * ajv_enum;
+
+/* values is the json array of a node's possible values */
+ajv_enum ajv_enum_compile(const orderly_alloc_funcs * alloc,
+                          const orderly_json * values);
+
+void ajv_enum_free(const orderly_alloc_funcs * alloc, ajv_enum e);
+
+/* these follow json's notion of equality, except that integers and
+ * numbers with the same value are equal */
+int ajv_enum_has_boolean(const struct ajv_enum_t * e, int b);
+int ajv_enum_has_integer(const struct ajv_enum_t * e, long l);
+int ajv_enum_has_double(const struct ajv_enum_t * e, double d);
+int ajv_enum_has_string(const struct ajv_enum_t * e, const char * s,
+                        unsigned int len);
+
+/* does e list any objects or arrays?  if not, no container is in it */
+int ajv_enum_has_containers(const struct ajv_enum_t * e);
+
+/* objects and arrays are matched against an enum's as their events
+ * stream past, rather than being read in first.  the events are hashed
+ * into a form in which the order of an object's members doesn't count
+ * and integers equal numbers of the same value, and a container whose
+ * hash and size are those of an enumerated one is then compared with
+ * it exactly.  for that, its events are kept, but only until there are
+ * more of them than in the largest of the enumerated containers, so
+ * what matching costs is bounded by the schema, not the document */
+typedef unsigned long long ajv_enum_hash;
+
+/* a container being hashed */
+typedef struct ajv_enum_frame_t {
+  /* what it hashes to so far, and in objects the hash of the key of
+   * the member being read */
+  ajv_enum_hash hash;
+  ajv_enum_hash key;
+  /* the size of the events before it, its offset on the tape, and
+   * whether the tape holds its events since then */
+  unsigned long size;
+  unsigned int pos;
+  int kept;
+  int object;
+} ajv_enum_frame;
+
+/* a container to be checked against an enum once it closes */
+typedef struct ajv_enum_pending_t {
+  const struct ajv_enum_t *e;
+  const struct ajv_node_t *node;
+  /* its frame */
+  unsigned int frame;
+} ajv_enum_pending;
+
+typedef struct ajv_enum_matcher_t {
+  const orderly_alloc_funcs *alloc;
+  /* the containers open since the outermost match began, and the
+   * matches in them, innermost last */
+  ajv_enum_frame *frames;
+  unsigned int nframes;
+  unsigned int framescap;
+  ajv_enum_pending *matches;
+  unsigned int nmatches;
+  unsigned int matchescap;
+  /* the size of the events seen since the outermost match began, and
+   * how big they can get before none of the matches can be confirmed */
+  unsigned long size;
+  unsigned long limit;
+  /* those events, while size is within limit.  a match begun when
+   * none under way can be confirmed any more starts the tape over
+   * from its own container */
+  int keeping;
+  orderly_tape tape;
+  orderly_tape_builder builder;
+} ajv_enum_matcher;
+
+void ajv_enum_matcher_init(ajv_enum_matcher * m,
+                           const orderly_alloc_funcs * alloc);
+
+void ajv_enum_matcher_free(ajv_enum_matcher * m);
+
+/* forget any matches under way, as when a document is abandoned */
+void ajv_enum_matcher_reset(ajv_enum_matcher * m);
+
+/* is a container being matched? */
+#define ajv_enum_matching(m) ((m)->nmatches > 0)
+
+/* the container whose start is the next event handed to the matcher
+ * is to be checked against e, and node blamed if it's not in it */
+void ajv_enum_match(ajv_enum_matcher * m, const struct ajv_enum_t * e,
+                    const struct ajv_node_t * node);
+
+/* the events of the containers being matched, the matcher their
+ * context, bar the ends of maps and arrays */
+extern const yajl_callbacks ajv_enum_callbacks;
+
+/* the end of a map or array.  if that closes a container being
+ * matched which isn't one of its enum's values, its node, otherwise
+ * NULL */
+const struct ajv_node_t * ajv_enum_end(ajv_enum_matcher * m);
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#include "ajv_program.h"
+#include "ajv_schema.h"
+
+#include <assert.h>
+#include <string.h>
+
+/* give the children and additional node of n, and then theirs, their
+ * instructions, counting the key slots and bitmap words they'll need */
+static void ajv_program_layout(ajv_program *p, ajv_node *n)
+{
+  ajv_node *cur;
+
+  for (cur = n->child; cur; cur = cur->sibling) cur->pc = p->ninsns++;
+  if (n->additional) n->additional->pc = p->ninsns++;
+
+  for (cur = n->child; cur; cur = cur->sibling) ajv_program_layout(p, cur);
+  if (n->additional) ajv_program_layout(p, n->additional);
+
+  if (n->keys.slots) p->nkeys += n->keys.mask + 1;
+  p->nwords += AJV_BITS_WORDS(n->nprops);
+  if (n->requires) p->nwords += AJV_BITS_WORDS(n->parent->nprops);
+}
+
+/* copy a bitmap of words words into the program */
+static unsigned int ajv_program_bits(ajv_program *p, const ajv_bitword *bits,
+                                     unsigned int words)
+{
+  unsigned int off = p->nwords;
+  memcpy((void *) (p->words + off), (const void *) bits,
+         words * sizeof(ajv_bitword));
+  p->nwords += words;
+  return off;
+}
+
+static void ajv_program_fill(ajv_program *p, const ajv_node *n)
+{
+  ajv_insn *in = &(p->insns[n->pc]);
+  const ajv_node *prop, *cur;
+  unsigned int i;
+
+  memset((void *) in, 0, sizeof(ajv_insn));
+  in->node = n;
+  in->t = (unsigned char) n->node->t;
+  in->range = n->node->range;
+  if (ORDERLY_RANGE_SPECIFIED(in->range)) in->ops |= AJV_OP_RANGE;
+  if ((in->regex = n->regex)) in->ops |= AJV_OP_REGEX;
+  if ((in->checker = n->checker)) in->ops |= AJV_OP_FORMAT;
+  if ((in->values = n->values)) in->ops |= AJV_OP_ENUM;
+  if (n->node->t == orderly_node_array && n->node->tuple_typed) {
+    in->ops |= AJV_OP_TUPLE;
+  }
+  for (i = 0; i < AJV_JSON_TYPES; i++) {
+    in->dispatch[i] = n->dispatch[i] ? n->dispatch[i]->pc : AJV_PC_NONE;
+  }
+
+  in->first = n->child ? n->child->pc : AJV_PC_NONE;
+  for (cur = n->child; cur; cur = cur->sibling) in->nchildren++;
+  in->additional = n->additional ? n->additional->pc : AJV_PC_NONE;
+
+  /* work out now what ajv_state_mark_seen works out every time */
+  in->seen = ajv_seen_count;
+  prop = n;
+  if (n->parent && n->parent->node->t == orderly_node_union) {
+    prop = n->parent;
+  }
+  if (prop->parent && prop != prop->parent->additional) {
+    if (prop->parent->node->t == orderly_node_object) {
+      in->seen = ajv_seen_prop;
+      in->index = prop->index;
+    } else if (prop->parent->node->t == orderly_node_array) {
+      in->seen = ajv_seen_cursor;
+      if (!prop->parent->node->tuple_typed) {
+        in->seenpc = prop->pc;
+      } else if (prop->sibling) {
+        in->seenpc = prop->sibling->pc;
+      } else {
+        in->seenpc = prop->parent->additional->pc;
+      }
+    }
+  }
+
+  in->keys = AJV_PC_NONE;
+  if (n->keys.slots) {
+    in->keys = p->nkeys;
+    in->keymask = n->keys.mask;
+    for (i = 0; i <= n->keys.mask; i++) {
+      ajv_key_slot *slot = &(p->keys[p->nkeys++]);
+      const ajv_node *k = n->keys.slots[i];
+      slot->pc = AJV_PC_NONE;
+      if (k) {
+        slot->hash = k->namehash;
+        slot->len = k->namelen;
+        slot->name = k->node->name;
+        slot->pc = k->pc;
+      }
+    }
+  }
+  if (n->nprops) {
+    in->required = ajv_program_bits(p, n->required,
+                                    AJV_BITS_WORDS(n->nprops));
+  }
+  if (n->requires) {
+    in->ops |= AJV_OP_REQUIRES;
+    in->requires = ajv_program_bits(p, n->requires,
+                                    AJV_BITS_WORDS(n->parent->nprops));
+  }
+
+  for (cur = n->child; cur; cur = cur->sibling) ajv_program_fill(p, cur);
+  if (n->additional) ajv_program_fill(p, n->additional);
+}
+
+void ajv_program_compile(ajv_schema schema)
+{
+  ajv_program *p = &(schema->program);
+
+  memset((void *) p, 0, sizeof(ajv_program));
+  schema->root->pc = p->root = p->ninsns++;
+  ajv_program_layout(p, schema->root);
+  schema->opaque->pc = p->opaque = p->ninsns++;
+  ajv_program_layout(p, schema->opaque);
+
+  p->insns = OR_MALLOC(schema->af, p->ninsns * sizeof(ajv_insn));
+  if (p->nkeys) {
+    p->keys = OR_MALLOC(schema->af, p->nkeys * sizeof(ajv_key_slot));
+  }
+  if (p->nwords) {
+    p->words = OR_MALLOC(schema->af, p->nwords * sizeof(ajv_bitword));
+  }
+  /* counted again as they're filled in */
+  p->nkeys = p->nwords = 0;
+  ajv_program_fill(p, schema->root);
+  ajv_program_fill(p, schema->opaque);
+}
+
+void ajv_program_free(const orderly_alloc_funcs * alloc, ajv_program *p)
+{
+  if (p->insns) OR_FREE(alloc, p->insns);
+  if (p->keys) OR_FREE(alloc, p->keys);
+  if (p->words) OR_FREE(alloc, p->words);
+  memset((void *) p, 0, sizeof(ajv_program));
+}
+
+unsigned int ajv_program_find_key(const ajv_program *p, const ajv_insn *map,
+                                  const char *key, unsigned int len)
+{
+  const ajv_key_slot *slots;
+  unsigned int h, i;
+
+  if (map->keys == AJV_PC_NONE) return AJV_PC_NONE;
+  slots = p->keys + map->keys;
+  h = ajv_hash_key(key, len);
+  for (i = h & map->keymask; slots[i].pc != AJV_PC_NONE;
+       i = (i + 1) & map->keymask) {
+    if (slots[i].hash == h && slots[i].len == len
+        && !memcmp(slots[i].name, key, len)) {
+      return slots[i].pc;
+    }
+  }
+  return AJV_PC_NONE;
+}
+
+void ajv_vm_push(ajv_state state, unsigned int pc)
+{
+  const ajv_insn *in = &(state->insns[pc]);
+  ajv_node_state s, parent;
+  assert(state->nframes < state->framescap);
+  parent = ajv_state_frame(state);
+  s = &(state->node_state[state->nframes++]);
+  s->node = in->node;
+  s->pc = pc;
+  s->count = 0;
+  s->seenbits = s->reqbits = NULL;
+  s->key = NULL;
+  s->keyoff = parent->keyoff + parent->keylen;
+  s->keylen = 0;
+  if (in->t == orderly_node_object && in->nchildren) {
+    unsigned int words = AJV_BITS_WORDS(in->nchildren);
+    assert(state->bitsused + 2 * words <= state->bitslen);
+    s->seenbits = state->bits + state->bitsused;
+    s->reqbits = s->seenbits + words;
+    memset((void *) s->seenbits, 0, 2 * words * sizeof(ajv_bitword));
+    state->bitsused += 2 * words;
+  }
+  state->pc = in->nchildren ? in->first : in->additional;
+}
+
+static void ajv_vm_pop(ajv_state state)
+{
+  ajv_node_state s = ajv_state_frame(state);
+  state->nframes--;
+  state->pc = s->pc;
+  if (s->seenbits) {
+    state->bitsused -= 2 * AJV_BITS_WORDS(state->insns[s->pc].nchildren);
+  }
+}
+
+void ajv_vm_mark_seen(ajv_state state, unsigned int pc)
+{
+  const ajv_insn *in = &(state->insns[pc]);
+  ajv_node_state ns = ajv_state_frame(state);
+  ns->count++;
+  if (in->seen == ajv_seen_prop) {
+    AJV_BIT_SET(ns->seenbits, in->index);
+  } else if (in->seen == ajv_seen_cursor) {
+    state->pc = in->seenpc;
+  }
+}
+
+void ajv_vm_require(ajv_state state, const ajv_insn *prop)
+{
+  ajv_node_state s = ajv_state_frame(state);
+  const ajv_bitword *requires = state->program->words + prop->requires;
+  unsigned int w, words = AJV_BITS_WORDS(state->insns[s->pc].nchildren);
+  for (w = 0 ; w < words ; w++) {
+    s->reqbits[w] |= requires[w];
+  }
+}
+
+int ajv_vm_map_complete(ajv_state state)
+{
+  ajv_node_state ns = ajv_state_frame(state);
+  unsigned int mappc = ns->pc;
+  const ajv_insn *map = &(state->insns[mappc]);
+  unsigned int w, words = AJV_BITS_WORDS(map->nchildren);
+
+  for (w = 0 ; w < words ; w++) {
+    ajv_bitword missing = 
+      (state->program->words[map->required + w] | ns->reqbits[w])
+      & ~ns->seenbits[w];
+    unsigned int i;
+    for (i = w * AJV_WORD_BITS; missing; i++, missing >>= 1) {
+      if (!(missing & 1)) continue;
+      if (!ajv_state_missing(state, map->node,
+                             state->insns[map->first + i].node)) {
+        return 0;
+      }
+    }
+  }
+  ajv_vm_pop(state);
+  ajv_vm_mark_seen(state, mappc);
+  return 1;
+}
+
+int ajv_vm_array_complete(ajv_state state)
+{
+  ajv_node_state s = ajv_state_frame(state);
+  const ajv_insn *array = &(state->insns[s->pc]);
+  if ((array->ops & AJV_OP_RANGE)
+      && !ajv_check_range(state, &(array->range), array->node, s->count)
+      && !ajv_state_keep_going(state)) {
+    return 0;
+  }
+  /* the cursor only leaves a tuple once every member was seen */
+  if ((array->ops & AJV_OP_TUPLE) && state->pc != array->additional
+      && !ajv_state_tuple_rest(state, array->node,
+                               state->insns[state->pc].node)) {
+    return 0;
+  }
+  ajv_vm_pop(state);
+  return 1;
+}
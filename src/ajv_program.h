@@ -0,0 +1,57 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#ifndef __AJV_PROGRAM_H__
+#define __AJV_PROGRAM_H__
+
+#include "ajv_state.h"
+
+/* compile the schema's tree, which must be complete, into
+ * schema->program */
+void ajv_program_compile(ajv_schema schema);
+
+void ajv_program_free(const orderly_alloc_funcs * alloc, ajv_program *p);
+
+/* the instruction of the property of map named key, or AJV_PC_NONE */
+unsigned int ajv_program_find_key(const ajv_program *p, const ajv_insn *map,
+                                  const char *key, unsigned int len);
+
+/* what ajv_state_push, ajv_state_mark_seen and friends do for the tree,
+ * for the program */
+void ajv_vm_push(ajv_state state, unsigned int pc);
+void ajv_vm_mark_seen(ajv_state state, unsigned int pc);
+void ajv_vm_require(ajv_state state, const ajv_insn *prop);
+int ajv_vm_map_complete(ajv_state state);
+int ajv_vm_array_complete(ajv_state state);
+
+#endif
@@ -1,41 +1,223 @@
 #include "api/ajv_parse.h"
 #include "ajv_state.h"
 #include "ajv_schema.h"
+#include "ajv_program.h"
 #include "orderly_alloc.h"
+#include "orderly_json.h"
 #include <string.h>
 #include <assert.h>
-typedef struct { 
+/* registered formats, most recent first.  entries are never changed
+ * or freed once they're on the list */
+typedef struct checker_tuple_t { 
   char *name;
   ajv_format_checker checker;
+  const struct checker_tuple_t *next;
 } checker_tuple;
 
-orderly_ptrstack format_checkers = { NULL, 0, 0};
+static const checker_tuple *format_checkers = NULL;
 
-ajv_node * ajv_alloc_node( const orderly_alloc_funcs * alloc, 
+/* the orderly nodes behind the nodes which check the properties and
+ * elements a schema doesn't name, indexed by type.  an object or array
+ * that lets anything through lets anything through its values too */
+static const orderly_node ajv_type_nodes[] = {
+  { orderly_node_empty },
+  { orderly_node_null },
+  { orderly_node_string },
+  { orderly_node_boolean },
+  { orderly_node_any },
+  { orderly_node_integer },
+  { orderly_node_number },
+  { orderly_node_object, NULL, NULL, NULL, NULL, NULL, 0, orderly_node_any },
+  { orderly_node_array, NULL, NULL, NULL, NULL, NULL, 0, orderly_node_any },
+  { orderly_node_union }
+};
+
+/* FNV-1a, used to hash property names for ajv_find_key */
+unsigned int ajv_hash_key(const char *key, unsigned int len)
+{
+  unsigned int h = 2166136261U;
+  while (len--) {
+    h ^= (unsigned char) *key++;
+    h *= 16777619U;
+  }
+  return h;
+}
+
+static void ajv_build_key_index(const orderly_alloc_funcs * alloc,
+                                ajv_node *map)
+{
+  ajv_node *cur;
+  unsigned int nkeys = 0, size = 4;
+
+  for (cur = map->child; cur; cur = cur->sibling) nkeys++;
+  if (nkeys == 0) return;
+  /* keep the table at most half full */
+  while (size < nkeys * 2) size <<= 1;
+
+  map->keys.slots = OR_MALLOC(alloc, sizeof(ajv_node *) * size);
+  memset((void *) map->keys.slots, 0, sizeof(ajv_node *) * size);
+  map->keys.mask = size - 1;
+
+  for (cur = map->child; cur; cur = cur->sibling) {
+    unsigned int i;
+    assert(cur->node->name);
+    for (i = cur->namehash & map->keys.mask;
+         map->keys.slots[i];
+         i = (i + 1) & map->keys.mask)
+    {
+      /* on duplicate property names, the first definition wins */
+      if (map->keys.slots[i]->namelen == cur->namelen
+          && !memcmp(map->keys.slots[i]->node->name, cur->node->name,
+                     cur->namelen)) {
+        break;
+      }
+    }
+    if (!map->keys.slots[i]) map->keys.slots[i] = cur;
+  }
+}
+
+/* the json types a node of type t accepts */
+static unsigned int ajv_type_bits(orderly_node_type t) {
+  switch (t) {
+  case orderly_node_null:    return AJV_JSON_BIT(orderly_json_null);
+  case orderly_node_string:  return AJV_JSON_BIT(orderly_json_string);
+  case orderly_node_boolean: return AJV_JSON_BIT(orderly_json_boolean);
+  case orderly_node_integer: return AJV_JSON_BIT(orderly_json_integer);
+  case orderly_node_number:  
+    return AJV_JSON_BIT(orderly_json_number) 
+      | AJV_JSON_BIT(orderly_json_integer);
+  case orderly_node_object:  return AJV_JSON_BIT(orderly_json_object);
+  case orderly_node_array:   return AJV_JSON_BIT(orderly_json_array);
+  case orderly_node_any:     return (1u << AJV_JSON_TYPES) - 1;
+  case orderly_node_empty:
+  case orderly_node_union:   break;
+  }
+  return 0;
+}
+
+/* "disallow" is a type name or an array of them, passed through from
+ * JSONSchema or orderly's backticks */
+static unsigned int ajv_node_disallow(const orderly_node *on) {
+  unsigned int mask = 0;
+  if (on->passthrough_properties
+      && on->passthrough_properties->t == orderly_json_object ) {
+    orderly_json *cur, *t;
+    
+    for (cur = on->passthrough_properties->v.children.first; cur; cur = cur->next) {
+      if (!strcmp(cur->k, "disallow")) {
+        if (cur->t == orderly_json_string) {
+          mask |= ajv_type_bits(orderly_string_to_node_type(cur->v.s,
+                                                            strlen(cur->v.s)));
+        } else if (cur->t == orderly_json_array) {
+          for (t = cur->v.children.first; t; t = t->next) {
+            if (t->t != orderly_json_string) continue;
+            mask |= ajv_type_bits(orderly_string_to_node_type(t->v.s,
+                                                              strlen(t->v.s)));
+          }
+        }
+      }
+    }
+  }
+  return mask;
+}
+
+/* fill in the type dispatch table of n.  a union takes, for each type,
+ * its first branch which accepts it, so its children must already
+ * have their tables */
+void ajv_build_dispatch(ajv_node *n) {
+  unsigned int i, accepts = ajv_type_bits(n->node->t);
+  const ajv_node *cur;
+
+  for (i = 0; i < AJV_JSON_TYPES; i++) {
+    n->dispatch[i] = NULL;
+    if (n->disallow & (1u << i)) continue;
+    if (n->node->t == orderly_node_union) {
+      for (cur = n->child; cur && !n->dispatch[i]; cur = cur->sibling) {
+        n->dispatch[i] = cur->dispatch[i];
+      }
+    } else if (accepts & (1u << i)) {
+      n->dispatch[i] = n;
+    }
+  }
+}
+
+/* compile a pattern, or find it among those the schema has already
+ * compiled.  returns NULL if pcre won't have it */
+static const ajv_regex * ajv_schema_regex(ajv_schema schema,
+                                          const char *pattern)
+{
+  const orderly_alloc_funcs * alloc = schema->af;
+  const char *regerror = NULL;
+  int erroffset;
+  unsigned int i;
+  ajv_regex *rx;
+  pcre *re;
+
+  for (i = 0; i < orderly_ps_length(schema->regexes); i++) {
+    rx = schema->regexes.stack[i];
+    if (!strcmp(rx->pattern, pattern)) return rx;
+  }
+
+  rx = OR_MALLOC(alloc, sizeof(ajv_regex));
+  memset((void *) rx, 0, sizeof(ajv_regex));
+  rx->pattern = pattern;
+  if ((rx->dfa = ajv_dfa_compile(alloc, pattern))) {
+    orderly_ps_push(alloc, schema->regexes, rx);
+    return rx;
+  }
+
+  re = pcre_compile(pattern, 0, &regerror, &erroffset, NULL);
+  if (!re) {
+    OR_FREE(alloc, rx);
+    return NULL;
+  }
+  rx->re = re;
+#ifdef AJV_PCRE_JIT
+  rx->extra = pcre_study(re, PCRE_STUDY_JIT_COMPILE, &regerror);
+  if (rx->extra && pcre_fullinfo(re, rx->extra, PCRE_INFO_JIT, &(rx->jit))) {
+    rx->jit = 0;
+  }
+  if (rx->jit) schema->jit = 1;
+#else
+  rx->extra = pcre_study(re, 0, &regerror);
+#endif
+  orderly_ps_push(alloc, schema->regexes, rx);
+  return rx;
+}
+
+ajv_node * ajv_alloc_node( ajv_schema schema, 
                            const orderly_node *on,    ajv_node *parent ) 
 {
+  const orderly_alloc_funcs * alloc = schema->af;
   ajv_node *n = (ajv_node *)OR_MALLOC(alloc, sizeof(ajv_node));
   memset((void *) n, 0, sizeof(ajv_node));
-  orderly_ps_init(n->required);
-  const char *regerror = NULL;
-  int erroffset;
   n->parent = parent;
   n->node   = on;
+  if (on->name) {
+    n->namelen  = strlen(on->name);
+    n->namehash = ajv_hash_key(on->name, n->namelen);
+  }
+  n->disallow = ajv_node_disallow(on);
   if (on->regex) {
-    n->regcomp = pcre_compile(on->regex,
-                              0,
-                              &regerror,
-                              &erroffset,
-                              NULL);
+    n->regex = ajv_schema_regex(schema, on->regex);
+  }
+  if (on->values) {
+    n->values = ajv_enum_compile(alloc, on->values);
+  }
+  if (on->default_value) {
+    if (on->name && parent && parent->node->t == orderly_node_object) {
+      orderly_tape_append_key(alloc, &n->defaults, on->name, n->namelen);
+    }
+    orderly_tape_append_json(alloc, &n->defaults, on->default_value);
   }
   {
     const char *formatname = ajv_node_format(on);
-    int i;
+    const checker_tuple *chk;
     if (formatname) {
-      for (i = 0; i < orderly_ps_length(format_checkers); i++) {
-        checker_tuple *chk = format_checkers.stack[i];
+      for (chk = format_checkers; chk; chk = chk->next) {
         if (!strcmp(formatname, chk->name)) {
           n->checker = chk->checker;
+          break;
         }
       }
     }
@@ -44,46 +226,120 @@ ajv_node * ajv_alloc_node( const orderly_alloc_funcs * alloc,
 }
 
 const char *ajv_node_format(const orderly_node *on) {
-  if (on->passthrough_properties
-      && on->passthrough_properties->t == orderly_json_object ) {
-    orderly_json *cur;
-    
-    for (cur = on->passthrough_properties->v.children.first; cur; cur = cur->next) {
-      if (!strcmp(cur->k, "format")) {
-        return cur->v.s;
+  const orderly_json *format =
+    orderly_json_find(on->passthrough_properties, "format", 6);
+  return format && format->t == orderly_json_string ? format->v.s : NULL;
+}
+
+/* number the properties of an object node and precompute the bitmaps
+ * used by ajv_state_map_complete */
+static void ajv_build_prop_bits(const orderly_alloc_funcs * alloc,
+                                ajv_node *map)
+{
+  ajv_node *cur;
+  unsigned int words, i = 0;
+  
+  for (cur = map->child; cur; cur = cur->sibling) map->nprops++;
+  if (map->nprops == 0) return;
+  words = AJV_BITS_WORDS(map->nprops);
+
+  map->props = OR_MALLOC(alloc, sizeof(ajv_node *) * map->nprops);
+  map->required = OR_MALLOC(alloc, sizeof(ajv_bitword) * words);
+  memset((void *) map->required, 0, sizeof(ajv_bitword) * words);
+
+  for (cur = map->child; cur; cur = cur->sibling) {
+    cur->index = i++;
+    map->props[cur->index] = cur;
+  }
+  for (cur = map->child; cur; cur = cur->sibling) {
+    if (!cur->node->optional) AJV_BIT_SET(map->required, cur->index);
+    if (cur->node->requires) {
+      const char **r;
+      cur->requires = OR_MALLOC(alloc, sizeof(ajv_bitword) * words);
+      memset((void *) cur->requires, 0, sizeof(ajv_bitword) * words);
+      for (r = cur->node->requires; *r; r++) {
+        ajv_node *req = ajv_find_key(map, *r, strlen(*r));
+        if (req) AJV_BIT_SET(cur->requires, req->index);
       }
     }
   }
-  return NULL;
 }
 
-ajv_node * ajv_alloc_tree(const orderly_alloc_funcs * alloc,
+/* a node checking nothing but the type of a value, such as what a
+ * container doesn't name, which may itself be a container */
+static ajv_node * ajv_alloc_typed(ajv_schema schema, orderly_node_type t,
+                                  ajv_node *parent) {
+  const orderly_node *on = &(ajv_type_nodes[t]);
+  ajv_node *n = (ajv_node *)OR_MALLOC(schema->af, sizeof(ajv_node));
+  memset((void *) n, 0, sizeof(ajv_node));
+  n->parent = parent;
+  n->node   = on;
+  if (on->t == orderly_node_object || on->t == orderly_node_array) {
+    n->additional = ajv_alloc_typed(schema, on->additional_properties, n);
+  }
+  ajv_build_dispatch(n);
+  return n;
+}
+
+ajv_node * ajv_alloc_tree(ajv_schema schema,
                           const orderly_node *n, ajv_node *parent) {
 
-  ajv_node *an = ajv_alloc_node(alloc, n, parent);
+  ajv_node *an = ajv_alloc_node(schema, n, parent);
 
-  if (n->sibling) an->sibling = ajv_alloc_tree(alloc,n->sibling,parent);
-  if (n->child)   an->child   = ajv_alloc_tree(alloc,n->child, an);
+  if (n->sibling) an->sibling = ajv_alloc_tree(schema,n->sibling,parent);
+  if (n->child)   an->child   = ajv_alloc_tree(schema,n->child, an);
   if (n->t == orderly_node_object) {
-    ajv_node *cur;
-    for (cur = an->child; cur; cur = cur->sibling) {
-      if (!cur->node->optional) {
-        orderly_ps_push(alloc, an->required, cur);
-      }
-    }
+    ajv_build_key_index(schema->af, an);
+    ajv_build_prop_bits(schema->af, an);
+  }
+  if (n->t == orderly_node_object || n->t == orderly_node_array) {
+    an->additional = ajv_alloc_typed(schema, n->additional_properties, an);
   }
+  ajv_build_dispatch(an);
   
   return an;
 }
 
+/* the bitmap words needed by the deepest chain of object frames a
+ * document can open beneath n */
+static unsigned int ajv_tree_bitwords(const ajv_node *n) {
+  const ajv_node *cur;
+  unsigned int max = 0;
+  for (cur = n->child; cur; cur = cur->sibling) {
+    unsigned int w = ajv_tree_bitwords(cur);
+    if (w > max) max = w;
+  }
+  return max + (n->nprops ? 2 * AJV_BITS_WORDS(n->nprops) : 0);
+}
+
+/* the frames of the deepest chain of containers a document can open
+ * beneath n, n's own among them */
+static unsigned int ajv_tree_depth(const ajv_node *n) {
+  const ajv_node *cur;
+  unsigned int max = 0, d;
+  for (cur = n->child; cur; cur = cur->sibling) {
+    if ((d = ajv_tree_depth(cur)) > max) max = d;
+  }
+  if (n->additional && (d = ajv_tree_depth(n->additional)) > max) max = d;
+  if (n->node->t == orderly_node_object || n->node->t == orderly_node_array) {
+    max++;
+  }
+  return max;
+}
+
 void ajv_free_node (const orderly_alloc_funcs * alloc, ajv_node ** n) {
   if (n && *n) {
     if ((*n)->sibling) ajv_free_node(alloc,&((*n)->sibling));
     if ((*n)->child) ajv_free_node(alloc,&((*n)->child));
-    /* the orderly_node *  belongs to the schema, don't free it */
-    if ((*n)->regcomp) {
-      pcre_free((*n)->regcomp);
-    }
+    if ((*n)->additional) ajv_free_node(alloc,&((*n)->additional));
+    /* the orderly_node * and the regex belong to the schema, don't
+     * free them */
+    if ((*n)->values) ajv_enum_free(alloc, (*n)->values);
+    if ((*n)->keys.slots) OR_FREE(alloc, (*n)->keys.slots);
+    if ((*n)->props) OR_FREE(alloc, (*n)->props);
+    if ((*n)->required) OR_FREE(alloc, (*n)->required);
+    if ((*n)->requires) OR_FREE(alloc, (*n)->requires);
+    orderly_tape_free(alloc, &(*n)->defaults);
     OR_FREE(alloc, *n);
     *n = NULL;
   }
@@ -92,36 +348,47 @@ void ajv_free_node (const orderly_alloc_funcs * alloc, ajv_node ** n) {
 
 ajv_schema
 ajv_alloc_schema(orderly_alloc_funcs *alloc, orderly_node *parsed) {
-  const orderly_alloc_funcs * AF = (const orderly_alloc_funcs *) alloc;
-  {
-    static orderly_alloc_funcs orderlyAllocFuncBuffer;
-    static orderly_alloc_funcs * orderlyAllocFuncBufferPtr = NULL;
-    
-    if (orderlyAllocFuncBufferPtr == NULL) {
-            orderly_set_default_alloc_funcs(&orderlyAllocFuncBuffer);
-            orderlyAllocFuncBufferPtr = &orderlyAllocFuncBuffer;
-    }
-    AF = orderlyAllocFuncBufferPtr;
-    
-  }
-
-  
+  const orderly_alloc_funcs * AF =
+    alloc ? (const orderly_alloc_funcs *) alloc : &orderly_default_alloc_funcs;
   struct ajv_schema_t *ret = 
     (struct ajv_schema_t *)
-    OR_MALLOC(AF, sizeof(struct ajv_state_t));
+    OR_MALLOC(AF, sizeof(struct ajv_schema_t));
   if (ret) {
     memset((void *) ret, 0, sizeof(struct ajv_schema_t));
-    ret->root = 
-      ajv_alloc_tree((const orderly_alloc_funcs *)AF, parsed, NULL);
-    ret->oroot = parsed;
     ret->af = AF;
+    orderly_ps_init(ret->regexes);
+    ret->root = ajv_alloc_tree(ret, parsed, NULL);
+    ret->opaque = ajv_alloc_typed(ret, orderly_node_any, NULL);
+    ajv_program_compile(ret);
+    ret->oroot = parsed;
+    ret->bitwords = ajv_tree_bitwords(ret->root);
+    ret->depth = ajv_tree_depth(ret->root) + 1;
   }
 
   return ret;
 }
 
 void ajv_free_schema(ajv_schema schema) {
+  unsigned int i;
+  ajv_program_free(schema->af, &(schema->program));
   ajv_free_node(schema->af, &schema->root);
+  ajv_free_node(schema->af, &schema->opaque);
+  for (i = 0; i < orderly_ps_length(schema->regexes); i++) {
+    ajv_regex *rx = schema->regexes.stack[i];
+    if (rx->dfa) {
+      ajv_dfa_free(schema->af, rx->dfa);
+      OR_FREE(schema->af, rx);
+      continue;
+    }
+#ifdef PCRE_STUDY_JIT_COMPILE
+    if (rx->extra) pcre_free_study(rx->extra);
+#else
+    if (rx->extra) pcre_free(rx->extra);
+#endif
+    pcre_free(rx->re);
+    OR_FREE(schema->af, rx);
+  }
+  orderly_ps_free(schema->af, schema->regexes);
   orderly_free_node(schema->af, &schema->oroot);
   OR_FREE(schema->af, schema);
 
@@ -130,27 +397,28 @@ void ajv_free_schema(ajv_schema schema) {
 
 ajv_node *ajv_find_key(const ajv_node *map, const char *key, unsigned int len) {
   ajv_node *cur;
-  
-  for (cur = map->child; cur; cur = cur->sibling) {
-    assert(cur->node->name);
-    if (!strncmp(cur->node->name,key,len)) {
+  unsigned int h, i;
+
+  if (!map->keys.slots) return NULL;
+
+  h = ajv_hash_key(key, len);
+  for (i = h & map->keys.mask; (cur = map->keys.slots[i]);
+       i = (i + 1) & map->keys.mask) {
+    if (cur->namehash == h && cur->namelen == len
+        && !memcmp(cur->node->name, key, len)) {
       break;
-      }
+    }
   }
   return cur;
 }
 
 void ajv_register_format(const char *name, ajv_format_checker checker) {
-  static orderly_alloc_funcs orderlyAllocFuncBuffer;
+  const orderly_alloc_funcs *AF = &orderly_default_alloc_funcs;
   checker_tuple *chk;  
-  static orderly_alloc_funcs * orderlyAllocFuncBufferPtr = NULL;
 
-  if (orderlyAllocFuncBufferPtr == NULL) {
-    orderly_set_default_alloc_funcs(&orderlyAllocFuncBuffer);
-    orderlyAllocFuncBufferPtr = &orderlyAllocFuncBuffer;
-  }
-  chk = OR_MALLOC(orderlyAllocFuncBufferPtr,sizeof(checker_tuple));
-  BUF_STRDUP(chk->name, orderlyAllocFuncBufferPtr, name, strlen(name));
+  chk = OR_MALLOC(AF, sizeof(checker_tuple));
+  BUF_STRDUP(chk->name, AF, name, strlen(name));
   chk->checker = checker;
-  orderly_ps_push(orderlyAllocFuncBufferPtr, format_checkers, chk);
+  chk->next = format_checkers;
+  format_checkers = chk;
 }
@@ -2,6 +2,9 @@
 #define __AJV_SCHEMA_H__
 #include "ajv_state.h"
 
+/* FNV-1a, used to hash property names and enumerated strings */
+unsigned int ajv_hash_key(const char *key, unsigned int len);
+
 ajv_node *ajv_find_key(const ajv_node *map, const char *key, unsigned int len);
 
 const char *ajv_node_format(const orderly_node *on);
@@ -3,80 +3,215 @@
 #include "yajl_interface.h"
 #include "api/ajv_parse.h"
 #include "orderly_json.h"
+#include "orderly_double.h"
 #include "ajv_schema.h"
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
 
 void ajv_state_push(ajv_state state, const ajv_node *n) {
-  ajv_node_state s = ajv_alloc_node_state(state->AF, n);
+  ajv_node_state s, parent;
   /* only maps and array have children */
   assert(n->node->t == orderly_node_object
          || n->node->t == orderly_node_array);
+  assert(state->nframes < state->framescap);
+  parent = ajv_state_frame(state);
+  s = &(state->node_state[state->nframes++]);
   s->node = state->node;
-  orderly_ps_push(state->AF, state->node_state, s);
+  s->count = 0;
+  s->seenbits = s->reqbits = NULL;
+  s->key = NULL;
+  s->keyoff = parent->keyoff + parent->keylen;
+  s->keylen = 0;
+  if (n->nprops) {
+    unsigned int words = AJV_BITS_WORDS(n->nprops);
+    assert(state->bitsused + 2 * words <= state->bitslen);
+    s->seenbits = state->bits + state->bitsused;
+    s->reqbits = s->seenbits + words;
+    memset((void *) s->seenbits, 0, 2 * words * sizeof(ajv_bitword));
+    state->bitsused += 2 * words;
+  }
 
-  state->node = state->node->child;
+  /* a container without a schema for its contents lets anything in */
+  state->node = n->child ? n->child : n->additional;
 }
 
 void ajv_state_pop(ajv_state state) {
-  ajv_node_state s = state->node_state.stack[state->node_state.used - 1];  
-  orderly_ps_pop(state->node_state);
+  ajv_node_state s = ajv_state_frame(state);
+  state->nframes--;
 
   state->node = s->node;
 
-  ajv_free_node_state(state->AF,&s);
+  if (s->seenbits) {
+    state->bitsused -= 2 * AJV_BITS_WORDS(s->node->nprops);
+  }
 
   return;
 }
+
+/* set up the root frame to validate a new document */
+static void ajv_state_begin(ajv_state state, ajv_schema schema) {
+  ajv_node_state s;
+  ajv_clear_error(state);
+  if (state->bitslen < schema->bitwords) {
+    if (state->bits) OR_FREE(state->AF, state->bits);
+    state->bits = OR_MALLOC(state->AF, schema->bitwords * sizeof(ajv_bitword));
+    state->bitslen = schema->bitwords;
+  }
+  state->bitsused = 0;
+  if (state->framescap < schema->depth) {
+    if (state->node_state) OR_FREE(state->AF, state->node_state);
+    state->node_state = OR_MALLOC(state->AF, schema->depth
+                                  * sizeof(struct ajv_node_state_t));
+    state->framescap = schema->depth;
+  }
+#ifdef AJV_PCRE_JIT
+  if (schema->jit && !state->jitstack) {
+    state->jitstack = pcre_jit_stack_alloc(32 * 1024, 1024 * 1024);
+  }
+#endif
+  state->s = schema;
+  state->node = schema->root;
+  state->validator = state->useprogram ? &ajv_program_callbacks
+                                       : &ajv_callbacks;
+  state->program = &(schema->program);
+  state->insns = schema->program.insns;
+  state->pc = schema->program.root;
+  state->depth = 0;
+  state->consumed = 0;
+  ajv_enum_matcher_reset(&(state->enums));
+  state->nframes = 1;
+  s = &(state->node_state[0]);
+  s->node = schema->root;
+  s->count = 0;
+  s->seenbits = s->reqbits = NULL;
+  s->key = NULL;
+  s->keyoff = s->keylen = 0;
+  s->pc = schema->program.root;
+}
  
    
   
 void ajv_clear_error (ajv_state s) {
+  s->nerrors = 0;
+  s->errortextused = 0;
+  s->nsteps = 0;
+}
 
-  if (s->error.extra_info) OR_FREE(s->AF,s->error.extra_info);
-
-  s->error.code       = ajv_e_no_error;
-  s->error.extra_info = NULL;
-  s->error.node       = NULL;
-
-
+/* copy len bytes into errortext, returning their offset */
+static unsigned int ajv_error_text(ajv_state s, const char *text,
+                                   unsigned int len) {
+  unsigned int off = s->errortextused;
+  if (off + len > s->errortextlen) {
+    s->errortextlen = s->errortextlen ? 2 * s->errortextlen : 256;
+    if (s->errortextlen < off + len) s->errortextlen = off + len;
+    s->errortext = OR_REALLOC(s->AF, s->errortext, s->errortextlen);
+  }
+  if (len) memcpy(s->errortext + off, text, len);
+  s->errortextused += len;
+  return off;
 }
 
-ajv_node_state ajv_alloc_node_state( const orderly_alloc_funcs * alloc, 
-                                     const ajv_node *node)
-{
-  ajv_node_state n = (ajv_node_state)OR_MALLOC(alloc, 
-                                               sizeof(struct ajv_node_state_t));
-  memset((void *) n, 0, sizeof(struct ajv_node_state_t));
-  orderly_ps_init(n->required);
-  orderly_ps_init(n->seen);
-  n->node = node;
-  return n;
+/* record the path to the value being validated, or to the innermost
+ * container when it's node that's at fault */
+static void ajv_error_path(ajv_state s, struct ajv_error_t *err,
+                           const ajv_node *node) {
+  unsigned int j, last;
+  err->path = s->nsteps;
+  err->pathlen = 0;
+  /* the document's own frame isn't a step */
+  if (s->nframes < 2) return;
+  last = s->nframes - 1;
+  if (node == s->node_state[last].node) last--;
+  if (s->nsteps + last > s->stepslen) {
+    s->stepslen = s->stepslen ? 2 * s->stepslen : 32;
+    if (s->stepslen < s->nsteps + last) s->stepslen = s->nsteps + last;
+    s->steps = OR_REALLOC(s->AF, s->steps,
+                          s->stepslen * sizeof(ajv_path_step));
+  }
+  for (j = 1; j <= last; j++) {
+    ajv_node_state f = &(s->node_state[j]);
+    ajv_path_step *step = &(s->steps[s->nsteps++]);
+    step->prop = NULL;
+    step->iskey = 0;
+    step->keylen = 0;
+    if (f->node->node->t == orderly_node_array) {
+      step->index = f->count;
+    } else if (f->key) {
+      step->prop = f->key;
+    } else {
+      step->iskey = 1;
+      step->index = ajv_error_text(s, s->keytext + f->keyoff, f->keylen);
+      step->keylen = f->keylen;
+    }
+  }
+  err->pathlen = last;
 }
 
-void ajv_free_node_state( const orderly_alloc_funcs * alloc, 
-                          ajv_node_state *node)
-{
-  if (node && *node) {
-    orderly_ps_free(alloc, (*node)->seen);
-    orderly_ps_free(alloc, (*node)->required);
-    OR_FREE(alloc,*node);
-    *node = NULL;
+void ajv_state_key(ajv_state s, const unsigned char *key, unsigned int len) {
+  ajv_node_state f = ajv_state_frame(s);
+  if (f->keyoff + len > s->keytextlen) {
+    s->keytextlen = s->keytextlen ? 2 * s->keytextlen : 256;
+    if (s->keytextlen < f->keyoff + len) s->keytextlen = f->keyoff + len;
+    s->keytext = OR_REALLOC(s->AF, s->keytext, s->keytextlen);
   }
+  memcpy(s->keytext + f->keyoff, key, len);
+  f->key = NULL;
+  f->keylen = len;
+}
+
+/* the next record, or NULL when the budget is spent, which can only
+ * be for an error found on the way out */
+static struct ajv_error_t * ajv_new_error ( ajv_state s, ajv_error e,
+                                            const ajv_node * node ) {
+  struct ajv_error_t *err;
+  if (s->nerrors == s->maxerrors) return NULL;
+  err = &(s->errors[s->nerrors++]);
+  err->code = e;
+  err->node = node;
+  err->kind = ajv_v_none;
+  err->element = s->nframes ? ajv_state_frame(s)->count + 1 : 0;
+  err->offset = s->parsing
+    ? s->consumed + yajl_get_bytes_consumed(s->yajl) : 0;
+  ajv_error_path(s, err, node);
+  return err;
 }
 
 void ajv_set_error ( ajv_state s, ajv_error e,
                      const ajv_node * node, const char *info, int infolen ) {
+  struct ajv_error_t *err = ajv_new_error(s, e, node);
+  if (err && info) {
+    err->kind = ajv_v_text;
+    err->value.text.off = ajv_error_text(s, info, infolen);
+    err->value.text.len = infolen;
+  }
+}
 
-  ajv_clear_error(s);
-  s->error.node = node;
-  s->error.code = e;
-  if (info) {
-    BUF_STRDUP(s->error.extra_info, 
-               s->AF, info, infolen);
+void ajv_set_error_name ( ajv_state s, ajv_error e,
+                          const ajv_node * node, const char *name ) {
+  struct ajv_error_t *err = ajv_new_error(s, e, node);
+  if (err && name) {
+    err->kind = ajv_v_name;
+    err->value.name = name;
   }
+}
 
+void ajv_set_error_integer ( ajv_state s, ajv_error e,
+                             const ajv_node * node, long l ) {
+  struct ajv_error_t *err = ajv_new_error(s, e, node);
+  if (err) {
+    err->kind = ajv_v_integer;
+    err->value.i = l;
+  }
+}
+
+void ajv_set_error_double ( ajv_state s, ajv_error e,
+                            const ajv_node * node, double d ) {
+  struct ajv_error_t *err = ajv_new_error(s, e, node);
+  if (err) {
+    err->kind = ajv_v_double;
+    err->value.d = d;
+  }
 }
 
 const char * ajv_error_to_string (ajv_error e) {
@@ -110,20 +245,126 @@ const char * ajv_error_to_string (ajv_error e) {
 unsigned char * ajv_get_error(ajv_handle hand, int verbose,
                               const unsigned char * jsonText,
                               unsigned int jsonTextLength) {
-  char * yajl_err;
+  return ajv_get_error_at(hand, 0, verbose, jsonText, jsonTextLength);
+}
+
+unsigned int ajv_get_error_count(ajv_handle hand) {
+  return hand->nerrors;
+}
+
+unsigned int ajv_get_error_offset(ajv_handle hand, unsigned int i) {
+  return i < hand->nerrors ? hand->errors[i].offset : 0;
+}
+
+/* a reference token of a JSON pointer, escaped per RFC 6901 */
+static void ajv_append_token(orderly_buf ret, const char *tok,
+                             unsigned int len) {
+  unsigned int i, from = 0;
+  for (i = 0; i < len; i++) {
+    if (tok[i] == '~' || tok[i] == '/') {
+      orderly_buf_append(ret, tok + from, i - from);
+      orderly_buf_append_string(ret, tok[i] == '~' ? "~0" : "~1");
+      from = i + 1;
+    }
+  }
+  orderly_buf_append(ret, tok + from, len - from);
+}
+
+unsigned char * ajv_get_error_path(ajv_handle hand, unsigned int i) {
   orderly_buf ret = orderly_buf_alloc(hand->AF);
+  unsigned char *cret;
+  if (i < hand->nerrors) {
+    const struct ajv_error_t *e = &(hand->errors[i]);
+    unsigned int j;
+    for (j = e->path; j < e->path + e->pathlen; j++) {
+      const ajv_path_step *step = &(hand->steps[j]);
+      orderly_buf_append_string(ret, "/");
+      if (step->prop) {
+        ajv_append_token(ret, step->prop->node->name, step->prop->namelen);
+      } else if (step->iskey) {
+        ajv_append_token(ret, hand->errortext + step->index, step->keylen);
+      } else {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%u", step->index);
+        orderly_buf_append_string(ret, buf);
+      }
+    }
+  }
+  BUF_STRDUP(cret, hand->AF,
+             orderly_buf_len(ret) ? orderly_buf_data(ret)
+                                  : (const unsigned char *) "",
+             orderly_buf_len(ret));
+  orderly_buf_free(ret);
+  return cret;
+}
+
+void ajv_use_program(ajv_handle hand, int use) {
+  hand->useprogram = use;
+}
+
+void ajv_collect_errors(ajv_handle hand, unsigned int max) {
+  ajv_clear_error(hand);
+  if (hand->errors != &(hand->firsterror)) OR_FREE(hand->AF, hand->errors);
+  hand->maxerrors = max > 1 ? max : 1;
+  hand->errors = &(hand->firsterror);
+  if (hand->maxerrors > 1) {
+    hand->errors = OR_MALLOC(hand->AF,
+                             hand->maxerrors * sizeof(struct ajv_error_t));
+  }
+}
+
+unsigned char * ajv_get_error_at(ajv_handle hand, unsigned int i, 
+                                 int verbose,
+                                 const unsigned char * jsonText,
+                                 unsigned int jsonTextLength) {
+  char * yajl_err;
+  orderly_buf ret;
   ajv_state s = hand;
   unsigned char *cret;
-  struct ajv_error_t *e = &(s->error);
+  const struct ajv_error_t *e;
+  const char *extra_info = NULL;
+  unsigned int extra_len = 0;
+  char valbuf[128];
 
   int yajl_length;
   const char *fn;
+  if (i >= s->nerrors) { 
+    /* yajl's message lives in yajl's blocks, hand out a copy that
+     * ajv_free_error can free */
+    unsigned char *yerr =
+      yajl_get_error(hand->yajl,verbose,jsonText,jsonTextLength);
+    BUF_STRDUP(cret, hand->AF, yerr, strlen((const char *) yerr));
+    yajl_free_error(hand->yajl, yerr);
+    return cret;
+  } 
+
+  e = &(s->errors[i]);
+  switch (e->kind) {
+    case ajv_v_text:
+      extra_info = s->errortext + e->value.text.off;
+      extra_len = e->value.text.len;
+      break;
+    case ajv_v_name:
+      extra_info = e->value.name;
+      extra_len = strlen(extra_info);
+      break;
+    case ajv_v_integer:
+      snprintf(valbuf, sizeof(valbuf), "%ld", e->value.i);
+      extra_info = valbuf;
+      extra_len = strlen(valbuf);
+      break;
+    case ajv_v_double:
+      orderly_format_double(e->value.d, valbuf);
+      extra_info = valbuf;
+      extra_len = strlen(valbuf);
+      break;
+    case ajv_v_none:
+      break;
+  }
   if (e->node) {
     fn = ajv_node_format(e->node->node);
   }
-  if (e->code == ajv_e_no_error) { 
-    return yajl_get_error(hand->yajl,verbose,jsonText,jsonTextLength);
-  } 
+  ret = orderly_buf_alloc(hand->AF);
 
   /* include the yajl error message when verbose */
   if (verbose == 1) {
@@ -132,6 +373,7 @@ unsigned char * ajv_get_error(ajv_handle hand, int verbose,
                              (unsigned char *)jsonText,jsonTextLength);
 
     yajl_length = strlen(yajl_err);
+    yajl_free_error(hand->yajl, (unsigned char *) yajl_err);
   }
 
   if (e->code == ajv_e_out_of_range) {
@@ -143,21 +385,21 @@ unsigned char * ajv_get_error(ajv_handle hand, int verbose,
       orderly_buf_append_string(ret," length");
     }
     orderly_buf_append_string(ret," ");
-    orderly_buf_append_string(ret,e->extra_info);
+    orderly_buf_append(ret, extra_info, extra_len);
     orderly_buf_append_string(ret," not in range ");
     if (ORDERLY_RANGE_SPECIFIED(on->range)) {
       char buf[128];
       orderly_buf_append_string(ret, "{");
       buf[0] = 0;
       if (ORDERLY_RANGE_LHS_DOUBLE & on->range.info)
-        sprintf(buf, "%.15g", on->range.lhs.d);
+        orderly_format_double(on->range.lhs.d, buf);
       else if (ORDERLY_RANGE_LHS_INT & on->range.info)
         sprintf(buf, "%ld", on->range.lhs.i);
       if (buf[0]) orderly_buf_append_string(ret, buf);
       orderly_buf_append_string(ret, ",");
       buf[0] = 0;
       if (ORDERLY_RANGE_RHS_DOUBLE & on->range.info)
-        sprintf(buf, "%.15g", on->range.rhs.d);
+        orderly_format_double(on->range.rhs.d, buf);
       else if (ORDERLY_RANGE_RHS_INT & on->range.info)
         sprintf(buf, "%ld", on->range.rhs.i);
       if (buf[0]) orderly_buf_append_string(ret, buf);
@@ -173,14 +415,14 @@ unsigned char * ajv_get_error(ajv_handle hand, int verbose,
     orderly_buf_append_string(ret, "':");
   }
 
-  if (e->extra_info) {
+  if (extra_info) {
     if (e->code == ajv_e_incomplete_container) {
       if (e->node) {
         if (e->node->node->t == orderly_node_object) {
           orderly_buf_append_string(ret, ", object missing required property");
         } else {
           orderly_buf_append_string(ret, ", tuple missing ");
-          orderly_buf_append_string(ret, e->extra_info);
+          orderly_buf_append(ret, extra_info, extra_len);
           orderly_buf_append_string(ret, " elements");
         }
       }
@@ -193,7 +435,7 @@ unsigned char * ajv_get_error(ajv_handle hand, int verbose,
              && e->node 
              && e->node->node->t == orderly_node_array)) {
       orderly_buf_append_string(ret, " '");
-      orderly_buf_append_string(ret, e->extra_info);
+      orderly_buf_append(ret, extra_info, extra_len);
       orderly_buf_append_string(ret, "'");
     }
   }
@@ -206,10 +448,9 @@ unsigned char * ajv_get_error(ajv_handle hand, int verbose,
           orderly_buf_append_string(ret, "'");
         }
         if (e->node->parent && e->node->parent->node->tuple_typed == 1) {
-          ajv_node_state ns = (ajv_node_state)orderly_ps_current(s->node_state);
           char buf[128];
           orderly_buf_append_string(ret, " for array element ");
-          snprintf(buf,128,"%d",orderly_ps_length(ns->seen)+1);
+          snprintf(buf,128,"%u",e->element);
           orderly_buf_append_string(ret,buf);
         }
         orderly_buf_append_string(ret, ", expected '");
@@ -239,20 +480,29 @@ yajl_status ajv_parse_and_validate(ajv_handle hand,
   yajl_status stat;
   yajl_handle yh = hand->yajl;
   if (schema) {
-    ajv_node_state s = ajv_alloc_node_state(hand->AF, schema->root);
-    ajv_clear_error(hand);
-    hand->s = schema;
-    hand->node = schema->root;
-    orderly_ps_push(hand->AF, hand->node_state, s);
-    memcpy(&hand->ourcb, &ajv_callbacks,sizeof(yajl_callbacks));
+    /* a document may arrive in many chunks, only set up at its start */
+    if (!hand->nframes) {
+      ajv_state_begin(hand, schema);
+      hand->parsing = 1;
+    }
+    /* unless this chunk starts part way through a subtree we're
+     * skipping, see ajv_skip, or one we're matching against an enum */
+    if ((hand->cb || hand->depth == 0)
+        && !ajv_enum_matching(&(hand->enums))) {
+      memcpy(&hand->ourcb, hand->validator, sizeof(yajl_callbacks));
+    }
   } else {
     memcpy(&hand->ourcb, &ajv_passthrough,sizeof(yajl_callbacks));
   }
   stat = yajl_parse(yh, jsonText, jsonTextLength);
-  if (hand->error.code != ajv_e_no_error) {
+  hand->consumed += jsonTextLength;
+  if (!ajv_state_keep_going(hand)) {
     assert(stat == yajl_status_client_canceled);
     stat = yajl_status_error;
-  } 
+  } else if (hand->nerrors && stat == yajl_status_client_canceled) {
+    /* there's no resyncing with a value after the end of the document */
+    stat = yajl_status_error;
+  }
 
   return stat;
 }
@@ -262,197 +512,289 @@ yajl_status ajv_validate(ajv_handle hand,
                         orderly_json *json) {
   yajl_status ret =  yajl_status_ok;
   int cancelled;
-  ajv_clear_error(hand);
-  hand->s = schema;
-  hand->node = schema->root;
-  ajv_node_state s = ajv_alloc_node_state(hand->AF, schema->root);
-  orderly_ps_push(hand->AF, hand->node_state, s);
-
-
-  cancelled = orderly_synthesize_callbacks(&ajv_callbacks,hand,json);
-  if (cancelled == 1) {
-    if (hand->error.code == ajv_e_no_error) {
-      ret = yajl_status_client_canceled;
-    } else {
-      ret = yajl_status_error;
-    }
+  ajv_state_begin(hand, schema);
+  hand->parsing = 0;
+  memcpy(&hand->ourcb, hand->validator, sizeof(yajl_callbacks));
+
+  cancelled = orderly_synthesize_callbacks(&hand->ourcb,hand,json);
+  if (hand->nerrors) {
+    ret = yajl_status_error;
+  } else if (cancelled == 1) {
+    ret = yajl_status_client_canceled;
   }
+  hand->nframes = 0;
   
   return ret;
 }
 
 void ajv_state_mark_seen(ajv_state s, const ajv_node *node) {
   ajv_node_state ns;
-  ns = (ajv_node_state)orderly_ps_current(s->node_state);
+  const ajv_node *prop = node;
+  ns = ajv_state_frame(s);
   if (node->parent && node->parent->node->t == orderly_node_union) {
-    orderly_ps_push(s->AF, ns->seen, (void *)(node->parent));
-  } else {
-    orderly_ps_push(s->AF, ns->seen, (void *)(node));
-  }
-  /* advance the current pointer if we're checking a tuple typed array */
-  if (node->parent &&
-      node->parent->node->t == orderly_node_array &&
-      node->parent->node->tuple_typed) {
-    if (node->sibling) {
-      s->node = s->node->sibling;
+    prop = node->parent;
+  }
+  ns->count++;
+  if (!prop->parent || prop == prop->parent->additional) return;
+
+  if (prop->parent->node->t == orderly_node_object) {
+    /* object properties are tracked by index */
+    assert(ns->node == prop->parent);
+    AJV_BIT_SET(ns->seenbits, prop->index);
+  } else if (prop->parent->node->t == orderly_node_array) {
+    /* arrays need nothing more than the count and, for tuple typed
+     * arrays, a cursor into the tuple held in s->node.  */
+    if (!prop->parent->node->tuple_typed) {
+      /* every element is checked against the same schema, forget which
+       * branch of a union the last one matched */
+      s->node = prop;
+    } else if (prop->sibling) {
+      s->node = prop->sibling;
     } else {
-      /* otherwise, put us into schemaless mode */
-      ((orderly_node *)(s->any.node))->t = 
-        ajv_state_parent(s)->node->additional_properties; 
-      s->any.sibling = &(s->any);
-      s->depth = 0;
-      s->any.parent = ajv_state_parent(s);
-      s->node = &(s->any);
+      /* otherwise, the rest of the array is checked against its
+       * additional properties */
+      s->node = prop->parent->additional;
     }
   }
 }
 
+/* the blocks yajl allocates through a handle carry their size in front
+ * of them, so that a cached block can be handed out again to any
+ * request it is big enough for */
+typedef union ajv_block_header_t {
+  unsigned int size;
+  /* alignment for whatever yajl keeps in the block */
+  double d;
+  long l;
+  void *p;
+} ajv_block_header;
+
+static void * ajv_block_malloc(void *ctx, unsigned int sz) {
+  ajv_state s = (ajv_state) ctx;
+  ajv_block_header *b;
+  unsigned int i, best = s->nblocks;
+  /* the smallest cached block that will do */
+  for (i = 0; i < s->nblocks; i++) {
+    ajv_block_header *c = (ajv_block_header *) s->blockcache[i] - 1;
+    if (c->size >= sz
+        && (best == s->nblocks
+            || c->size < ((ajv_block_header *) s->blockcache[best] - 1)->size)) {
+      best = i;
+    }
+  }
+  if (best < s->nblocks) {
+    void *ret = s->blockcache[best];
+    s->blockcache[best] = s->blockcache[--s->nblocks];
+    return ret;
+  }
+  b = (ajv_block_header *) OR_MALLOC(s->AF, sizeof(ajv_block_header) + sz);
+  if (!b) return NULL;
+  b->size = sz;
+  return b + 1;
+}
+
+static void ajv_block_free(void *ctx, void *ptr) {
+  ajv_state s = (ajv_state) ctx;
+  ajv_block_header *b;
+  if (!ptr) return;
+  b = (ajv_block_header *) ptr - 1;
+  if (s->nblocks < AJV_BLOCK_CACHE && b->size <= AJV_BLOCK_CACHE_MAX) {
+    s->blockcache[s->nblocks++] = ptr;
+  } else {
+    OR_FREE(s->AF, b);
+  }
+}
+
+static void * ajv_block_realloc(void *ctx, void *ptr, unsigned int sz) {
+  ajv_state s = (ajv_state) ctx;
+  ajv_block_header *b;
+  if (!ptr) return ajv_block_malloc(ctx, sz);
+  b = (ajv_block_header *) ptr - 1;
+  if (b->size >= sz) return ptr;
+  b = (ajv_block_header *) OR_REALLOC(s->AF, b, sizeof(ajv_block_header) + sz);
+  if (!b) return NULL;
+  b->size = sz;
+  return b + 1;
+}
+
+static void ajv_alloc_yajl(ajv_state s) {
+  s->yajl = yajl_alloc(&(s->ourcb), s->hasypc ? &(s->ypc) : NULL,
+                       &(s->yaf), (void *) s);
+}
+
 ajv_handle ajv_alloc(const yajl_callbacks * callbacks,
                      const yajl_parser_config * config,
                      const yajl_alloc_funcs * allocFuncs,
                      void * ctx) {
-  const orderly_alloc_funcs * AF = (const orderly_alloc_funcs *) allocFuncs;
-  {
-    static orderly_alloc_funcs orderlyAllocFuncBuffer;
-    static orderly_alloc_funcs * orderlyAllocFuncBufferPtr = NULL;
-    
-    if (orderlyAllocFuncBufferPtr == NULL) {
-            orderly_set_default_alloc_funcs(&orderlyAllocFuncBuffer);
-            orderlyAllocFuncBufferPtr = &orderlyAllocFuncBuffer;
-    }
-    AF = orderlyAllocFuncBufferPtr;
-
-    }
-
-  
+  const orderly_alloc_funcs * AF = allocFuncs
+    ? (const orderly_alloc_funcs *) allocFuncs : &orderly_default_alloc_funcs;
   struct ajv_state_t *ajv_state = 
     (struct ajv_state_t *)
     OR_MALLOC(AF, sizeof(struct ajv_state_t));
   memset((void *) ajv_state, 0, sizeof(struct ajv_state_t));
   ajv_state->AF = AF;
-  ajv_state->any.parent = ajv_state->any.child = ajv_state->any.sibling = NULL;
-  ajv_state->any.node = orderly_alloc_node((orderly_alloc_funcs *)AF, 
-                                           orderly_node_any);
+  ajv_state->errors = &(ajv_state->firsterror);
+  ajv_state->maxerrors = 1;
   ajv_state->cb = callbacks;
   ajv_state->cbctx = ctx;
-  ajv_state->ypc = config;
-  ajv_state->yajl = yajl_alloc(&(ajv_state->ourcb),
-                               config,
-                               allocFuncs,
-                               (void *)ajv_state);
+  if (config) {
+    ajv_state->ypc = *config;
+    ajv_state->hasypc = 1;
+  }
+  ajv_state->yaf.malloc = ajv_block_malloc;
+  ajv_state->yaf.realloc = ajv_block_realloc;
+  ajv_state->yaf.free = ajv_block_free;
+  ajv_state->yaf.ctx = ajv_state;
+  ajv_enum_matcher_init(&(ajv_state->enums), AF);
+  ajv_alloc_yajl(ajv_state);
 
-  orderly_ps_init(ajv_state->node_state);
-  
   return ajv_state;
 }
 
+void ajv_reset(ajv_handle hand) {
+  ajv_clear_error(hand);
+  /* yajl 1.x can't be rewound, but a new parser is built from the
+   * blocks the old one gives back to the cache */
+  yajl_free(hand->yajl);
+  ajv_alloc_yajl(hand);
+  hand->s = NULL;
+  hand->node = NULL;
+  hand->depth = 0;
+  hand->nframes = 0;
+  hand->bitsused = 0;
+  ajv_enum_matcher_reset(&(hand->enums));
+}
+
 
 void ajv_free(ajv_handle hand) {
   const orderly_alloc_funcs *AF = hand->AF;
-  ajv_node_state        cur;
  
-   ajv_clear_error(hand);
- 
-   orderly_free_node(hand->AF,(orderly_node **)&(hand->any.node));
-  
-  while (orderly_ps_length(hand->node_state)) {
-    cur = orderly_ps_current(hand->node_state);
-    ajv_free_node_state(hand->AF,&cur);
-    orderly_ps_pop(hand->node_state);
-  }
-  orderly_ps_free(hand->AF,hand->node_state);
-
-  orderly_free_node(hand->AF,(orderly_node **)&(hand->any.node));
+  if (hand->errors != &(hand->firsterror)) OR_FREE(AF, hand->errors);
+  if (hand->errortext) OR_FREE(AF, hand->errortext);
+  if (hand->steps) OR_FREE(AF, hand->steps);
+  if (hand->keytext) OR_FREE(AF, hand->keytext);
+  if (hand->bits) OR_FREE(hand->AF, hand->bits);
+  if (hand->node_state) OR_FREE(AF, hand->node_state);
+  ajv_enum_matcher_free(&(hand->enums));
+#ifdef AJV_PCRE_JIT
+  if (hand->jitstack) pcre_jit_stack_free(hand->jitstack);
+#endif
 
   yajl_free(hand->yajl);
+  while (hand->nblocks) {
+    OR_FREE(AF, (ajv_block_header *) hand->blockcache[--hand->nblocks] - 1);
+  }
   OR_FREE(AF,hand);
 
 }
 
+/* idle handles, all allocated alike and reset */
+struct ajv_pool_t {
+  const yajl_callbacks *cb;
+  yajl_parser_config cfg;
+  int hascfg;
+  yajl_alloc_funcs af;
+  int hasaf;
+  orderly_ptrstack idle;
+};
+
+ajv_pool ajv_pool_alloc(const yajl_callbacks * callbacks,
+                        const yajl_parser_config * config,
+                        const yajl_alloc_funcs * allocFuncs) {
+  const orderly_alloc_funcs * AF = allocFuncs
+    ? (const orderly_alloc_funcs *) allocFuncs : &orderly_default_alloc_funcs;
+  struct ajv_pool_t *pool = OR_MALLOC(AF, sizeof(struct ajv_pool_t));
+  memset((void *) pool, 0, sizeof(struct ajv_pool_t));
+  pool->cb = callbacks;
+  if (config) {
+    pool->cfg = *config;
+    pool->hascfg = 1;
+  }
+  if (allocFuncs) {
+    pool->af = *allocFuncs;
+    pool->hasaf = 1;
+  }
+  orderly_ps_init(pool->idle);
+  return pool;
+}
+
+ajv_handle ajv_pool_get(ajv_pool pool, void * ctx) {
+  ajv_handle hand;
+  if (orderly_ps_length(pool->idle)) {
+    hand = orderly_ps_current(pool->idle);
+    orderly_ps_pop(pool->idle);
+  } else {
+    hand = ajv_alloc(pool->cb, pool->hascfg ? &(pool->cfg) : NULL,
+                     pool->hasaf ? &(pool->af) : NULL, NULL);
+  }
+  hand->cbctx = ctx;
+  return hand;
+}
+
+void ajv_pool_put(ajv_pool pool, ajv_handle hand) {
+  ajv_reset(hand);
+  hand->cbctx = NULL;
+  orderly_ps_push(hand->AF, pool->idle, hand);
+}
+
+void ajv_pool_free(ajv_pool pool) {
+  const orderly_alloc_funcs * AF = pool->hasaf
+    ? (const orderly_alloc_funcs *) &(pool->af) : &orderly_default_alloc_funcs;
+  while (orderly_ps_length(pool->idle)) {
+    ajv_free((ajv_handle) orderly_ps_current(pool->idle));
+    orderly_ps_pop(pool->idle);
+  }
+  orderly_ps_free(AF, pool->idle);
+  OR_FREE(AF, pool);
+}
+
 yajl_status ajv_parse_complete(ajv_handle hand) {
   yajl_status stat = yajl_parse_complete(hand->yajl);
 
-  if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {
+  if (!ajv_state_keep_going(hand)) {
+    stat = yajl_status_error;
+  } else if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {
     if ( hand->s && !ajv_state_finished(hand) ) {
-      ajv_set_error(hand, ajv_e_incomplete_container, NULL, "Empty root", strlen("Empty root"));
-      stat = yajl_status_error;
+      ajv_set_error_name(hand, ajv_e_incomplete_container, NULL, "Empty root");
     }
+    if (hand->nerrors) stat = yajl_status_error;
   }
+  /* the errors stay for ajv_get_error, the next document starts
+   * afresh */
+  hand->nframes = 0;
   return stat;
 }
 
 
-int ajv_state_map_complete (ajv_state state, const ajv_node *map) {
-  ajv_node_state ns = state->node_state.stack[state->node_state.used - 1];
-  int i = 0, j;
-  int maxreq = orderly_ps_length(ns->required);
-  int maxseen = orderly_ps_length(ns->seen);
-  /* XXX: n^2 */
-  for (i = 0 ; i < maxreq ; i++) {
-    int found = 0;
-    ajv_node *req = ns->required.stack[i];
-    for (j = 0 ; j < maxseen; j++) {
-      ajv_node *seen = ns->seen.stack[j];
-      if (req == seen) {
-        found = 1;
-        break;
-      }
-    }
-    if (found == 0) {
-      if (req->node->default_value) {    
-        int ret;
-        if (state->cb->yajl_map_key) {
-          ret = state->cb->yajl_map_key(
-                                        state->cbctx,
-                                        (const unsigned char *)req->node->name,
-                                        strlen(req->node->name));
-          if (ret == 0) {
-            return 0;
-          }
-        }
-        ret = orderly_synthesize_callbacks(state->cb, state->cbctx, 
-                                           req->node->default_value);
-        if (ret == 0) {
-          return 0;
-        }
-      } else {
-        ajv_set_error(state,ajv_e_incomplete_container,map,req->node->name,strlen(req->node->name));
-        return 0;
-      }
-    }
+int ajv_state_missing (ajv_state state, const ajv_node *map,
+                       const ajv_node *req) {
+  if (req->node->default_value) {    
+    /* without downstream callbacks there is nobody to hand the
+     * default to */
+    if (!state->cb) return 1;
+    /* the tape leads with our key */
+    return orderly_tape_replay(&req->defaults, state->cb, state->cbctx);
+  } else {
+    ajv_set_error_name(state,ajv_e_incomplete_container,map,
+                       req->node->name);
+    if (!ajv_state_keep_going(state)) return 0;
   }
-  maxreq = orderly_ps_length(ns->node->required);
-  for (i = 0 ; i < maxreq ; i++) {
-    int found = 0;
-    ajv_node *req = ns->node->required.stack[i];
-    for (j = 0 ; j < maxseen; j++) {
-      ajv_node *seen = ns->seen.stack[j];
-      if (req == seen) {
-        found = 1;
-        break;
-      }
-    }
-    if (found == 0) {
-      if (req->node->default_value) {    
-        int ret;
-        if (state->cb->yajl_map_key) {
-          ret = state->cb->yajl_map_key(
-                                        state->cbctx,
-                                        (const unsigned char *)req->node->name,
-                                        strlen(req->node->name));
-          if (ret == 0) {
-            return 0;
-          }
-        }
-        ret = orderly_synthesize_callbacks(state->cb, state->cbctx, 
-                                           req->node->default_value);
-        if (ret == 0) {
-          return 0;
-        }
-      } else {
-        ajv_set_error(state,ajv_e_incomplete_container,map,req->node->name,strlen(req->node->name));
-        return 0;
-      }
+  return 1;
+}
+
+int ajv_state_map_complete (ajv_state state, const ajv_node *map) {
+  ajv_node_state ns = ajv_state_frame(state);
+  unsigned int w, words = AJV_BITS_WORDS(map->nprops);
+
+  for (w = 0 ; w < words ; w++) {
+    ajv_bitword missing = 
+      (map->required[w] | ns->reqbits[w]) & ~ns->seenbits[w];
+    unsigned int i;
+    for (i = w * AJV_WORD_BITS; missing; i++, missing >>= 1) {
+      const ajv_node *req;
+      if (!(missing & 1)) continue;
+      req = map->props[i];
+      if (!ajv_state_missing(state, map, req)) return 0;
     }
   }
   ajv_state_pop(state);
@@ -461,44 +803,45 @@ int ajv_state_map_complete (ajv_state state, const ajv_node *map) {
 }
 
 const ajv_node * ajv_state_parent(ajv_state state) {
-  ajv_node_state s = state->node_state.stack[state->node_state.used - 1];  
+  ajv_node_state s = ajv_state_frame(state);  
   return s->node;
 }
 
+int ajv_state_tuple_rest (ajv_state state, const ajv_node *array,
+                          const ajv_node *cur) {
+  do {
+    if (cur->node->default_value) {
+      if (state->cb
+          && !orderly_tape_replay(&cur->defaults, state->cb, state->cbctx)) {
+        return 0; /* parse was cancelled */
+      }
+    } else { 
+      long remaining = 0;
+      do {remaining++; } while ((cur = cur->sibling));
+      ajv_set_error_integer(state,ajv_e_incomplete_container,array,
+                            remaining);
+      return ajv_state_keep_going(state);
+    }
+    cur = cur->sibling;
+  } while (cur);
+  return 1;
+}
+
 int ajv_state_array_complete (ajv_state state) {
   const ajv_node *array;
-  ajv_node_state s = state->node_state.stack[state->node_state.used - 1];  
+  ajv_node_state s = ajv_state_frame(state);  
   array = s->node;
-  if (!ajv_check_integer_range(state,array,
-                               orderly_ps_length(s->seen))) {
+  if (!ajv_check_integer_range(state,array,s->count)
+      && !ajv_state_keep_going(state)) {
     return 0;
   }
-  /* with tuple typed nodes, we need to check that we've seen things */
+  /* with tuple typed nodes, we need to check that we've seen things.
+   * the cursor only leaves the tuple once every member was seen */
   if (array->node->tuple_typed) {
     assert(state->node->parent == array);
-    ajv_node_state s  = orderly_ps_current(state->node_state);
-    if ((! orderly_ps_length(s->seen) /* seen nothing */
-        || orderly_ps_current(s->seen) != state->node)
-        && state->node != &(state->any)) {
-      const ajv_node *cur = state->node;
-      do {
-        if (cur->node->default_value) {
-          int ret;
-          ret = orderly_synthesize_callbacks(state->cb, state->cbctx,
-                                             cur->node->default_value);
-          if (ret == 0) { /*parse was cancelled */
-            return 0;
-          }
-        } else { 
-          int remaining = 0;
-          char buf[128];
-          do {remaining++; } while ((cur = cur->sibling));
-          snprintf(buf,128,"%d",remaining);
-          ajv_set_error(state,ajv_e_incomplete_container,array,buf,strlen(buf));
-          return 0;
-        }
-        cur = cur->sibling;
-      } while (cur);
+    if (state->node != array->additional
+        && !ajv_state_tuple_rest(state, array, state->node)) {
+      return 0;
     }
   }
   ajv_state_pop(state); 
@@ -507,15 +850,17 @@ int ajv_state_array_complete (ajv_state state) {
 
 int ajv_state_finished(ajv_state state) {
   return 
-    (orderly_ps_length(((ajv_node_state)
-                        state->node_state.stack[0])->seen) != 0);
+    (state->node_state[0].count != 0);
 
 }
 
 
-void ajv_state_require(ajv_state state, ajv_node *req) {
- ajv_node_state s = state->node_state.stack[state->node_state.used - 1];  
- orderly_ps_push(state->AF, s->required, req);
+void ajv_state_require(ajv_state state, const ajv_node *prop) {
+  ajv_node_state s = ajv_state_frame(state);  
+  unsigned int w, words = AJV_BITS_WORDS(s->node->nprops);
+  for (w = 0 ; w < words ; w++) {
+    s->reqbits[w] |= prop->requires[w];
+  }
 }
 
 unsigned int ajv_get_bytes_consumed(ajv_state state) {
@@ -523,20 +868,22 @@ unsigned int ajv_get_bytes_consumed(ajv_state state) {
 }
 
 int ajv_check_integer_range(ajv_state state, const ajv_node *an, long l) {
-  char buf[128];
-  orderly_range r = an->node->range;
+  return ajv_check_range(state, &(an->node->range), an, l);
+}
+
+int ajv_check_range(ajv_state state, const orderly_range *range,
+                    const ajv_node *an, long l) {
+  orderly_range r = *range;
   if (ORDERLY_RANGE_SPECIFIED(r)) {
     if (ORDERLY_RANGE_HAS_LHS(r)) {
       if (((ORDERLY_RANGE_LHS_DOUBLE & r.info) ? r.lhs.d : r.lhs.i) > l) {
-        snprintf(buf,128,"%ld",l);
-        ajv_set_error(state, ajv_e_out_of_range, an, buf,strlen(buf));
+        ajv_set_error_integer(state, ajv_e_out_of_range, an, l);
         return 0;
       }
     }
     if (ORDERLY_RANGE_HAS_RHS(r)) {
       if (((ORDERLY_RANGE_RHS_DOUBLE & r.info) ? r.rhs.d : r.rhs.i) < l) {
-        snprintf(buf,128,"%ld",l);
-        ajv_set_error(state, ajv_e_out_of_range, an, buf,strlen(buf));
+        ajv_set_error_integer(state, ajv_e_out_of_range, an, l);
         return 0;
       }
     }
@@ -37,8 +37,53 @@
 #include "orderly_alloc.h"
 #include "api/node.h"
 #include "orderly_ptrstack.h"
+#include "ajv_dfa.h"
+#include "ajv_enum.h"
+#include "orderly_tape.h"
 #include <pcre.h>
 
+/* pcre_jit_exec, which lets every handle bring its own JIT stack to a
+ * shared compiled pattern, arrived in pcre 8.32 */
+#if defined(PCRE_STUDY_JIT_COMPILE) \
+  && (PCRE_MAJOR > 8 || (PCRE_MAJOR == 8 && PCRE_MINOR >= 32))
+#define AJV_PCRE_JIT 1
+#endif
+
+/* bitmaps over the properties of an object node, indexed by
+ * ajv_node->index */
+typedef unsigned long ajv_bitword;
+#define AJV_WORD_BITS (sizeof(ajv_bitword) * 8)
+#define AJV_BITS_WORDS(n) (((n) + AJV_WORD_BITS - 1) / AJV_WORD_BITS)
+#define AJV_BIT_SET(bits, i) \
+  ((bits)[(i) / AJV_WORD_BITS] |= (ajv_bitword)1 << ((i) % AJV_WORD_BITS))
+
+/* json values come in seven types.  every node carries a table,
+ * indexed by type, of the node which validates values of that type */
+#define AJV_JSON_TYPES 7
+#define AJV_JSON_INDEX(t) ((t) - orderly_json_null)
+#define AJV_JSON_BIT(t) (1u << AJV_JSON_INDEX(t))
+
+/* a compiled pattern.  nodes of a schema with identically spelled
+ * patterns share one of these */
+typedef struct ajv_regex_t {
+  /* belongs to the orderly_node the pattern was first seen on */
+  const char *pattern;
+  /* simple patterns are matched by a dfa of our own, the rest by pcre */
+  ajv_dfa dfa;
+  pcre *re;
+  /* study data, may be NULL */
+  pcre_extra *extra;
+  /* did the study produce JIT code? */
+  int jit;
+} ajv_regex;
+
+/* an open addressed hash of the properties of an object node, built
+ * when the schema is compiled so that map keys can be dispatched without
+ * scanning every child */
+typedef struct ajv_key_index_t {
+  struct ajv_node_t ** slots;
+  unsigned int mask;
+} ajv_key_index;
 
 typedef struct ajv_node_t {
   /* these pointers mirror the structure of the nodes they contain */
@@ -50,12 +95,118 @@ typedef struct ajv_node_t {
   const orderly_node *node;
   /* a "format" callback */
   ajv_format_checker checker;
-  /* a compiled regex for string nodes */
-  pcre *regcomp;
-  /* a ptrstack of required elements */
-  orderly_ptrstack required;
+  /* a compiled regex for string nodes, owned by the schema */
+  const ajv_regex *regex;
+  /* node->values, indexed */
+  ajv_enum values;
+  /* for object and array nodes, the node which checks properties or
+   * elements the schema doesn't name, per node->additional_properties */
+  struct ajv_node_t * additional;
+  /* for object nodes, the property lookup table */
+  ajv_key_index keys;
+  /* for object nodes, children in declaration order and a bitmap
+   * of the ones which aren't optional */
+  struct ajv_node_t ** props;
+  unsigned int nprops;
+  ajv_bitword * required;
+  /* for properties, the siblings made required by node->requires */
+  ajv_bitword * requires;
+  /* for properties, our position in the parent's props */
+  unsigned int index;
+  /* length and hash of node->name, if this node is a named property */
+  unsigned int namelen;
+  unsigned int namehash;
+  /* the types forbidden by a "disallow" property, of AJV_JSON_BIT */
+  unsigned int disallow;
+  /* for each json type, this node or the branch of this union that
+   * values of that type are checked against.  NULL on a mismatch */
+  const struct ajv_node_t *dispatch[AJV_JSON_TYPES];
+  /* our instruction in the schema's program */
+  unsigned int pc;
+  /* the events node->default_value is handed downstream as, led by
+   * our name if we're a property, recorded once here rather than
+   * walked out of the json each time a value goes missing */
+  orderly_tape defaults;
 } ajv_node;
 
+/* a schema compiled into one contiguous array of instructions, one
+ * per node, with what checking a value needs held inline and every
+ * reference an index into the program rather than a pointer across
+ * the heap.  the children of a node are laid out one after another,
+ * so a property's instruction is its object's first plus its index */
+#define AJV_PC_NONE 0xffffffffU
+
+/* the checks an instruction makes, beyond the type of its value */
+#define AJV_OP_RANGE    0x01
+#define AJV_OP_REGEX    0x02
+#define AJV_OP_FORMAT   0x04
+#define AJV_OP_ENUM     0x08
+#define AJV_OP_TUPLE    0x10
+#define AJV_OP_REQUIRES 0x20
+
+/* what seeing a value does to the frame it's in, the work
+ * ajv_state_mark_seen works out from the tree each time */
+typedef enum {
+  ajv_seen_count,   /* nothing but count it */
+  ajv_seen_prop,    /* set its property's bit */
+  ajv_seen_cursor   /* move the frame's cursor to seenpc */
+} ajv_seen_op;
+
+typedef struct ajv_insn_t {
+  /* an orderly_node_type */
+  unsigned char t;
+  /* AJV_OP_* */
+  unsigned char ops;
+  /* an ajv_seen_op */
+  unsigned char seen;
+  /* for each json type, the instruction that checks values of that
+   * type, AJV_PC_NONE on a mismatch */
+  unsigned int dispatch[AJV_JSON_TYPES];
+  /* for ajv_seen_prop the bit to set, for ajv_seen_cursor where the
+   * cursor goes: the element, or the next member of a tuple */
+  unsigned int index;
+  unsigned int seenpc;
+  /* for containers, the children and what checks values they don't
+   * name */
+  unsigned int first;
+  unsigned int nchildren;
+  unsigned int additional;
+  /* for objects, the key table, keymask + 1 slots from keys, and the
+   * offset of the required bitmap in words */
+  unsigned int keys;
+  unsigned int keymask;
+  unsigned int required;
+  /* for properties with AJV_OP_REQUIRES, the offset of their bitmap
+   * in words */
+  unsigned int requires;
+  orderly_range range;
+  const ajv_regex *regex;
+  ajv_format_checker checker;
+  ajv_enum values;
+  /* the node compiled, for error messages and default values */
+  const struct ajv_node_t *node;
+} ajv_insn;
+
+/* a slot of an object's key table, empty when pc is AJV_PC_NONE */
+typedef struct ajv_key_slot_t {
+  unsigned int hash;
+  unsigned int len;
+  const char *name;
+  unsigned int pc;
+} ajv_key_slot;
+
+typedef struct ajv_program_t {
+  ajv_insn *insns;
+  unsigned int ninsns;
+  ajv_key_slot *keys;
+  unsigned int nkeys;
+  ajv_bitword *words;
+  unsigned int nwords;
+  /* where validation starts, and the instruction of schema->opaque */
+  unsigned int root;
+  unsigned int opaque;
+} ajv_program;
+
 
 
 
@@ -75,79 +226,232 @@ typedef enum {
   ajv_e_invalid_format, /* format checker returned invalid */
 } ajv_error;
 
+/* how to read the value an error records */
+typedef enum {
+  ajv_v_none,
+  ajv_v_text,    /* copied into the handle's errortext */
+  ajv_v_name,    /* a string that outlives the handle's errors */
+  ajv_v_integer,
+  ajv_v_double
+} ajv_value_kind;
+
+/* one step of the path from the document to an error: a property the
+ * schema names, or, when prop is NULL, an array index or a key the
+ * schema doesn't name, copied into errortext */
+typedef struct ajv_path_step_t {
+  const struct ajv_node_t *prop;
+  int iskey;
+  /* the index, or the key's offset in errortext */
+  unsigned int index;
+  unsigned int keylen;
+} ajv_path_step;
+
+/* errors are recorded as found and only put into words by
+ * ajv_get_error, so a document fails about as cheaply as it passes */
 struct ajv_error_t  {
   ajv_error code;
   const ajv_node *node; 
-  char *extra_info; /* TODO union */
+  /* the value at fault */
+  ajv_value_kind kind;
+  union {
+    struct { unsigned int off; unsigned int len; } text;
+    const char *name;
+    long i;
+    double d;
+  } value;
+  /* for errors in tuple typed arrays, the element (from 1) at fault */
+  unsigned int element;
+  /* how far into the document, just past the token at fault */
+  unsigned int offset;
+  /* where in the document, pathlen steps from path in the handle's
+   * steps */
+  unsigned int path;
+  unsigned int pathlen;
 };
 
 typedef struct ajv_node_state_t {
-  orderly_ptrstack seen;
-  orderly_ptrstack required;
+  /* the number of values validated in this container */
+  unsigned int     count;
+  /* for object frames, the properties we've seen and those that
+   * have been made required by the requires of seen properties.
+   * each is AJV_BITS_WORDS(node->nprops) long */
+  ajv_bitword      *seenbits;
+  ajv_bitword      *reqbits;
   const ajv_node   *node;
+  /* for object frames, the key of the value being validated: the
+   * property it names, or NULL and keylen bytes at keyoff in the
+   * handle's keytext.  a frame's keys follow those of the frames it's
+   * nested in, so keytext is a stack */
+  const ajv_node   *key;
+  unsigned int     keyoff;
+  unsigned int     keylen;
+  /* node's instruction, when validating with the program */
+  unsigned int     pc;
 } * ajv_node_state;
 
+/* how many freed blocks a handle holds on to for yajl, and the largest
+ * it will hold */
+#define AJV_BLOCK_CACHE 8
+#define AJV_BLOCK_CACHE_MAX (64 * 1024)
+
 typedef struct ajv_state_t {
   yajl_handle             yajl;
   ajv_schema              s;
   /* pointer into the node tree. if it is of type any, consult depth
   **/
   const ajv_node                *node;
-  /* populated with a orderly_node of type any, used for representing 
-   * unknown map keys
-   */
-  ajv_node                any;
   yajl_callbacks            ourcb;
   const orderly_alloc_funcs *AF;
-  struct ajv_error_t        error;
+  /* the errors found in the document so far, which is never more
+   * than maxerrors.  a handle stops at the first unless asked to
+   * collect more with ajv_collect_errors, and then errors is an
+   * array of its own rather than firsterror */
+  struct ajv_error_t        *errors;
+  unsigned int              nerrors;
+  unsigned int              maxerrors;
+  struct ajv_error_t        firsterror;
+  /* the values of ajv_v_text errors, one after another.  kept from
+   * one document to the next, so only grows */
+  char                      *errortext;
+  unsigned int              errortextused;
+  unsigned int              errortextlen;
+  /* the paths of the errors, one after another, and like errortext
+   * kept from document to document */
+  ajv_path_step             *steps;
+  unsigned int              nsteps;
+  unsigned int              stepslen;
+  /* the keys of open frames that the schema doesn't name */
+  char                      *keytext;
+  unsigned int              keytextlen;
+  /* while validating text, the bytes of the document that came in
+   * earlier chunks */
+  int                       parsing;
+  unsigned int              consumed;
+  /* validate by running the schema's program, rather than walking
+   * its tree?  validator is ajv_callbacks or ajv_program_callbacks to
+   * match, and program, insns and pc what it runs and where it is */
+  int                       useprogram;
+  const yajl_callbacks      *validator;
+  const ajv_program         *program;
+  const ajv_insn            *insns;
+  unsigned int              pc;
   const yajl_callbacks      *cb;
 
   void                      *cbctx;
+  /* while non-zero, we're inside a container whose contents go
+   * unchecked, either because it's validated as any or because it
+   * failed validation and we're collecting errors.  this is how deep,
+   * and node is what the container was checked against */
   unsigned int            depth;
-  orderly_ptrstack        node_state;
-  const yajl_parser_config *ypc;
+  /* the objects and arrays being checked against enumerated values.
+   * while any are, ourcb is ajv_enum_tee, which hands events to them
+   * before the validator */
+  ajv_enum_matcher        enums;
+  /* one frame per open container, plus one for the document itself.
+   * sized to the schema in use, so that entering a container costs no
+   * allocation */
+  struct ajv_node_state_t *node_state;
+  unsigned int            nframes;
+  unsigned int            framescap;
+  /* storage for the frames' bitmaps, sized to the schema in use */
+  ajv_bitword             *bits;
+  unsigned int            bitsused;
+  unsigned int            bitslen;
+  /* a copy of the configuration yajl was allocated with, so that
+   * ajv_reset can allocate it again */
+  yajl_parser_config      ypc;
+  int                     hasypc;
+  /* yajl allocates through these, which keep the blocks it frees in
+   * blockcache for its next allocation.  resetting a handle then
+   * costs yajl no trips to the allocator */
+  yajl_alloc_funcs        yaf;
+  void                    *blockcache[AJV_BLOCK_CACHE];
+  unsigned int            nblocks;
+#ifdef AJV_PCRE_JIT
+  /* a JIT stack for the schema's patterns, allocated the first time
+   * the handle meets a schema that has any */
+  pcre_jit_stack          *jitstack;
+#endif
 } * ajv_state;
 
+/* may validation carry on past the errors found so far? */
+#define ajv_state_keep_going(s) ((s)->nerrors < (s)->maxerrors)
+
+/* the frame of the innermost open container */
+#define ajv_state_frame(s) \
+  (assert((s)->nframes > 0), &((s)->node_state[(s)->nframes - 1]))
+
 
 
 struct ajv_schema_t {
   ajv_node *root;
   orderly_node  *oroot;
   const orderly_alloc_funcs *af;
-  
+  /* the most bitmap words the frames validating a document against
+   * this schema can need at once */
+  unsigned int bitwords;
+  /* the most frames a document validated against this schema can have
+   * open at once, its own among them */
+  unsigned int depth;
+  /* the compiled patterns of the schema, one per distinct pattern */
+  orderly_ptrstack regexes;
+  /* does any of them use JIT code? */
+  int jit;
+  /* accepts anything and belongs to no container.  when collecting
+   * errors, values under keys an object forbids are checked against
+   * it */
+  ajv_node *opaque;
+  /* the tree, compiled */
+  ajv_program program;
 };
 void ajv_state_push(ajv_state state, const ajv_node *n);
 void ajv_state_pop(ajv_state state);
 int ajv_state_map_complete (ajv_state state, const ajv_node *map);
 int ajv_state_array_complete (ajv_state state);
-ajv_node * ajv_alloc_tree(const orderly_alloc_funcs * alloc,
+ajv_node * ajv_alloc_tree(ajv_schema schema,
                           const orderly_node *n, ajv_node *parent);
 
-ajv_node * ajv_alloc_node( const orderly_alloc_funcs * alloc, 
+ajv_node * ajv_alloc_node( ajv_schema schema, 
                            const orderly_node *on,    ajv_node *parent ) ;
 
 void ajv_free_node (const orderly_alloc_funcs * alloc, ajv_node ** n);
 
+void ajv_build_dispatch(ajv_node *n);
+
 void ajv_reset_node( ajv_node * n);
 
 
 void ajv_set_error ( ajv_state s, ajv_error e,
                      const ajv_node * node, const char *info, int length );
+void ajv_set_error_name ( ajv_state s, ajv_error e,
+                          const ajv_node * node, const char *name );
+void ajv_set_error_integer ( ajv_state s, ajv_error e,
+                             const ajv_node * node, long l );
+void ajv_set_error_double ( ajv_state s, ajv_error e,
+                            const ajv_node * node, double d );
 
 void ajv_clear_error (ajv_state  s);
 
 const char * ajv_error_to_string (ajv_error e);
 
-void ajv_free_node_state( const orderly_alloc_funcs * alloc, 
-                          ajv_node_state *node);
-
-ajv_node_state ajv_alloc_node_state( const orderly_alloc_funcs * alloc, 
-                                     const ajv_node *node);
-
 void ajv_state_mark_seen(ajv_state s, const ajv_node *node) ;
 int ajv_state_finished(ajv_state state);
 const ajv_node * ajv_state_parent(ajv_state state);
-void ajv_state_require(ajv_state state, ajv_node *req) ;
+void ajv_state_require(ajv_state state, const ajv_node *prop) ;
+/* note a key the schema doesn't name, of the value about to be
+ * validated in the innermost frame */
+void ajv_state_key(ajv_state s, const unsigned char *key, unsigned int len);
 int ajv_check_integer_range(ajv_state state, const ajv_node *an, long l);
+/* the same, against a range held elsewhere, with an the node at fault */
+int ajv_check_range(ajv_state state, const orderly_range *range,
+                    const ajv_node *an, long l);
+/* a property of map that wasn't seen: hand on its default or record
+ * an error.  false if validation can't go on */
+int ajv_state_missing (ajv_state state, const ajv_node *map,
+                       const ajv_node *req);
+/* the members of a tuple from cur on weren't seen: hand on their
+ * defaults, up to the first without one, which is an error */
+int ajv_state_tuple_rest (ajv_state state, const ajv_node *array,
+                          const ajv_node *cur);
 
 #endif
@@ -31,7 +31,38 @@ ORDERLY_API ajv_handle ajv_alloc(const yajl_callbacks * callbacks,
 
 ORDERLY_API void ajv_free(ajv_handle hand);
 
-/** parsed belongs to the returned ajv_schema */
+/** ready a handle for a new document, as though it were freshly
+ * allocated with the same arguments, while holding on to the memory
+ * it has already allocated */
+ORDERLY_API void ajv_reset(ajv_handle hand);
+
+/** A pool of reset handles, all allocated with the same callbacks,
+ * config and allocation routines.  Getting a handle from a pool which
+ * has one idle costs no allocation.  A pool, like a handle, is for one
+ * thread at a time: give each thread its own. */
+typedef struct ajv_pool_t * ajv_pool;
+
+ORDERLY_API ajv_pool ajv_pool_alloc(const yajl_callbacks * callbacks,
+                                    const yajl_parser_config * config,
+                                    const yajl_alloc_funcs * allocFuncs);
+
+/** ctx is handed to the callbacks for as long as the handle is out */
+ORDERLY_API ajv_handle ajv_pool_get(ajv_pool pool, void * ctx);
+
+/** hand hand back to pool for the next ajv_pool_get */
+ORDERLY_API void ajv_pool_put(ajv_pool pool, ajv_handle hand);
+
+/** every handle from pool must be put back (or freed with ajv_free)
+ * first */
+ORDERLY_API void ajv_pool_free(ajv_pool pool);
+
+/** parsed belongs to the returned ajv_schema.
+ *
+ * A schema is never written to once ajv_alloc_schema returns, so any
+ * number of handles, on any number of threads, may validate against
+ * it at once without locking.  A handle itself must only be used by
+ * one thread at a time, and the schema must outlive every handle
+ * using it. */
 ORDERLY_API ajv_schema ajv_alloc_schema(orderly_alloc_funcs *alloc,
                                         orderly_node *parsed);
 
@@ -51,11 +82,56 @@ ORDERLY_API unsigned char * ajv_get_error(ajv_handle hand, int verbose,
                                           const unsigned char * jsonText,
                                           unsigned int jsonTextLength);
 
+/** finish the document being parsed.  Its errors stay until the next
+ * document begins, which ajv_validate may do straight away; yajl 1.x
+ * goes no further than one document, so parsing another needs
+ * ajv_reset first */
 ORDERLY_API yajl_status ajv_parse_complete(ajv_handle hand);
 ORDERLY_API void ajv_free_error(ajv_handle hand, unsigned char *err);
+
+/** validate by running the program the schema is compiled into when
+ * it's allocated, rather than walking its tree of nodes.  the verdicts
+ * and errors are the same either way; the program keeps what's needed
+ * to check a value together in one array, where the tree scatters it
+ * across the heap.  Call between documents; the choice survives
+ * ajv_reset. */
+ORDERLY_API void ajv_use_program(ajv_handle hand, int use);
+
+/** keep validating after a document fails, recording up to max errors
+ * before giving up on it.  The records are allocated here, once, and
+ * reused for every document, so collecting costs nothing per error
+ * beyond copying its text.  Call between documents; the budget
+ * survives ajv_reset.  The default of 1 stops at the first error. */
+ORDERLY_API void ajv_collect_errors(ajv_handle hand, unsigned int max);
+
+/** the number of errors recorded for the current document */
+ORDERLY_API unsigned int ajv_get_error_count(ajv_handle hand);
+
+/** how many bytes into the document the i'th error was found, just
+ * past the value or key at fault.  0 for documents validated with
+ * ajv_validate */
+ORDERLY_API unsigned int ajv_get_error_offset(ajv_handle hand,
+                                              unsigned int i);
+
+/** where in the document the i'th error was found, as a JSON pointer
+ * (RFC 6901) such as /items/42/price, or "" for the document itself.
+ * free it with ajv_free_error */
+ORDERLY_API unsigned char * ajv_get_error_path(ajv_handle hand,
+                                               unsigned int i);
+
+/** like ajv_get_error, for the i'th recorded error.  ajv_get_error is
+ * ajv_get_error_at with an index of 0 */
+ORDERLY_API unsigned char * ajv_get_error_at(ajv_handle hand,
+                                             unsigned int i, int verbose,
+                                             const unsigned char * jsonText,
+                                             unsigned int jsonTextLength);
 ORDERLY_API unsigned int ajv_get_bytes_consumed(ajv_handle hand);
 typedef int (*ajv_format_checker)(const char *string, unsigned int length);
 
+/** formats are looked up when a schema is allocated, and the most
+ * recently registered checker for a name wins.  Register them all at
+ * startup, before allocating the schemas that use them; registration
+ * must not race with itself or with ajv_alloc_schema. */
 ORDERLY_API void ajv_register_format(const char *name, ajv_format_checker checker);
   
 #ifdef __cplusplus
@@ -62,9 +62,17 @@ typedef struct orderly_json_t {
         {
             struct orderly_json_t * first;
             struct orderly_json_t * last;            
+            /* an index, once the container is finished with: the
+             * children in order, followed for larger objects by mask + 1
+             * slots of them hashed by key.  NULL if not indexed */
+            struct orderly_json_t ** items;
+            unsigned int count;
+            unsigned int mask;
         } children;
     } v;
     struct orderly_json_t * next; /* sibling ptr */
+    /* when v is shared between clones, how many of them there are */
+    unsigned int * refs;
 } orderly_json;
 
 #endif
@@ -55,6 +55,13 @@ static void orderly_internal_free(void *ctx, void * ptr)
     free(ptr);
 }
 
+const orderly_alloc_funcs orderly_default_alloc_funcs = {
+    orderly_internal_malloc,
+    orderly_internal_realloc,
+    orderly_internal_free,
+    NULL
+};
+
 void orderly_set_default_alloc_funcs(orderly_alloc_funcs * yaf)
 {
     yaf->malloc = orderly_internal_malloc;
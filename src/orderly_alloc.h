@@ -53,4 +53,8 @@
 
 void orderly_set_default_alloc_funcs(orderly_alloc_funcs * oaf);
 
+/* the malloc based routines, for use when the client supplies none.
+ * initialized at load time and never written, so safe to share */
+extern const orderly_alloc_funcs orderly_default_alloc_funcs;
+
 #endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#include "orderly_arena.h"
+
+#include <assert.h>
+#include <string.h>
+
+/* chunks start small, so that an arena used for a little json costs
+ * little, and double up to a limit */
+#define ORDERLY_ARENA_INIT_SIZE 4096
+#define ORDERLY_ARENA_MAX_SIZE (1024 * 1024)
+
+/* what allocations are aligned to */
+typedef union {
+    void * p;
+    long l;
+    double d;
+} orderly_arena_align;
+
+#define ORDERLY_ARENA_ROUND(n) \
+    (((n) + sizeof(orderly_arena_align) - 1) \
+     & ~(sizeof(orderly_arena_align) - 1))
+
+typedef struct orderly_arena_chunk_t {
+    struct orderly_arena_chunk_t * next;
+    size_t size;
+    size_t used;
+    orderly_arena_align data[1];
+} orderly_arena_chunk;
+
+#define ORDERLY_ARENA_CHUNK_HEADER offsetof(orderly_arena_chunk, data)
+
+struct orderly_arena_t {
+    /* the chunk allocations come from, then the ones filled before it */
+    orderly_arena_chunk * chunks;
+    /* how big the next chunk will be */
+    size_t next;
+    const orderly_alloc_funcs * alloc;
+};
+
+orderly_arena orderly_arena_alloc(const orderly_alloc_funcs * alloc)
+{
+    orderly_arena a = OR_MALLOC(alloc, sizeof(struct orderly_arena_t));
+    memset((void *) a, 0, sizeof(struct orderly_arena_t));
+    a->next = ORDERLY_ARENA_INIT_SIZE;
+    a->alloc = alloc;
+    return a;
+}
+
+static
+void orderly_arena_free_chunks(orderly_arena arena, orderly_arena_chunk * c)
+{
+    while (c) {
+        orderly_arena_chunk * next = c->next;
+        OR_FREE(arena->alloc, c);
+        c = next;
+    }
+}
+
+void orderly_arena_free(orderly_arena arena)
+{
+    assert(arena != NULL);
+    orderly_arena_free_chunks(arena, arena->chunks);
+    OR_FREE(arena->alloc, arena);
+}
+
+void orderly_arena_reset(orderly_arena arena)
+{
+    orderly_arena_chunk * c, * largest = arena->chunks;
+
+    for (c = arena->chunks; c; c = c->next) {
+        if (c->size > largest->size) largest = c;
+    }
+    if (!largest) return;
+    /* unlink the keeper and free the rest */
+    if (largest != arena->chunks) {
+        for (c = arena->chunks; c->next != largest; c = c->next) ;
+        c->next = largest->next;
+        largest->next = arena->chunks;
+    }
+    orderly_arena_free_chunks(arena, largest->next);
+    largest->next = NULL;
+    largest->used = 0;
+    arena->chunks = largest;
+}
+
+/* size bytes, aligned for any type if aligned is set.  strings aren't,
+ * so that they pack tightly */
+static
+void * orderly_arena_take(orderly_arena arena, size_t size, int aligned)
+{
+    orderly_arena_chunk * c = arena->chunks;
+    size_t start = 0;
+    void * p;
+
+    if (c) start = aligned ? ORDERLY_ARENA_ROUND(c->used) : c->used;
+    if (!c || start > c->size || c->size - start < size) {
+        size_t want = arena->next;
+        /* an allocation big enough to waste much of a fresh chunk gets
+         * one to itself, behind the current one so that the current
+         * one's space isn't abandoned */
+        if (size > want / 4) {
+            orderly_arena_chunk * big = (orderly_arena_chunk *)
+                OR_MALLOC(arena->alloc, ORDERLY_ARENA_CHUNK_HEADER + size);
+            big->size = big->used = size;
+            if (c) {
+                big->next = c->next;
+                c->next = big;
+            } else {
+                big->next = NULL;
+                arena->chunks = big;
+            }
+            return (void *) big->data;
+        }
+        c = (orderly_arena_chunk *)
+            OR_MALLOC(arena->alloc, ORDERLY_ARENA_CHUNK_HEADER + want);
+        c->size = want;
+        c->used = 0;
+        c->next = arena->chunks;
+        arena->chunks = c;
+        if (arena->next < ORDERLY_ARENA_MAX_SIZE) arena->next <<= 1;
+        start = 0;
+    }
+    p = (void *) ((char *) c->data + start);
+    c->used = start + size;
+    return p;
+}
+
+void * orderly_arena_malloc(orderly_arena arena, size_t size)
+{
+    return orderly_arena_take(arena, size, 1);
+}
+
+char * orderly_arena_strdup(orderly_arena arena, const void * s, size_t len)
+{
+    char * d = (char *) orderly_arena_take(arena, len + 1, 0);
+    memcpy((void *) d, s, len);
+    d[len] = 0;
+    return d;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#ifndef __ORDERLY_ARENA_H__
+#define __ORDERLY_ARENA_H__
+
+#include "api/common.h"
+#include "orderly_alloc.h"
+
+#include <stddef.h>
+
+/**
+ * orderly_arena hands out memory carved from large chunks, for data
+ * that is let go of all at once.  there's no freeing what it hands out
+ * piece by piece, only resetting or freeing the whole arena
+ */
+typedef struct orderly_arena_t * orderly_arena;
+
+/* allocate a new arena, whose chunks come from alloc */
+orderly_arena orderly_arena_alloc(const orderly_alloc_funcs * alloc);
+
+/* free the arena and everything it handed out */
+void orderly_arena_free(orderly_arena arena);
+
+/* let go of everything the arena handed out, keeping its largest chunk
+ * for whatever comes next */
+void orderly_arena_reset(orderly_arena arena);
+
+/* size bytes, aligned for any type */
+void * orderly_arena_malloc(orderly_arena arena, size_t size);
+
+/* a null terminated copy of len bytes of s */
+char * orderly_arena_strdup(orderly_arena arena, const void * s, size_t len);
+
+#endif
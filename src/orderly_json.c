@@ -33,6 +33,7 @@
 /* a lightweight C representation of json data */
 
 #include "orderly_json.h"
+#include "orderly_double.h"
 
 #include <yajl/yajl_parse.h>
 #include <yajl/yajl_gen.h>
@@ -40,53 +41,61 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* the refs of json read into an arena.  it can't outlive the arena, so
+ * its values are copied rather than shared */
+static unsigned int orderly_json_arena_refs;
+
+/* let go of node's hold on its value, returning whether it was the last
+ * one and the value is now its to free */
+static int
+orderly_json_release(const orderly_alloc_funcs * alloc, orderly_json * node)
+{
+    if (!node->refs) return 1;
+    if (--*(node->refs)) return 0;
+    OR_FREE(alloc, (void *) node->refs);
+    node->refs = NULL;
+    return 1;
+}
+
 void
 orderly_free_json(const orderly_alloc_funcs * alloc, orderly_json ** node)
 {
     if (node && *node) {
         if ((*node)->k) OR_FREE(alloc, (void *) (*node)->k);
 
-        if ((*node)->t == orderly_json_string) {
+        if (!orderly_json_release(alloc, *node)) {
+            /* a clone still holds the value */
+        } else if ((*node)->t == orderly_json_string) {
             OR_FREE(alloc, (void *) (*node)->v.s);
         } else if ((*node)->t == orderly_json_array ||
                    (*node)->t == orderly_json_object)
         {
             orderly_free_json(alloc, &((*node)->v.children.first));
+            if ((*node)->v.children.items) {
+                OR_FREE(alloc, (void *) (*node)->v.children.items);
+            }
         }
         if ((*node)->next) orderly_free_json(alloc, &((*node)->next));
         OR_FREE(alloc, (void *) (*node));        
     }
 }
 
-orderly_json *
-orderly_clone_json(const orderly_alloc_funcs * alloc, orderly_json * j)
+/* give copy a value of its own equal to j's.  strings are duplicated
+ * and the children of containers cloned, so they share their own values
+ * with j's where they can */
+static void
+orderly_json_copy_value(const orderly_alloc_funcs * alloc,
+                        orderly_json * copy, const orderly_json * j)
 {
-    orderly_json * copy = NULL;
-    if (!j) return copy;
-    copy = orderly_alloc_json(alloc, j->t);
-    if (j->k) BUF_STRDUP(copy->k, alloc, j->k, strlen(j->k));
-    
+    orderly_json * p;
+
     switch(j->t) {
-        case orderly_json_none:
-        case orderly_json_null:
-            break;
         case orderly_json_string:
             if (j->v.s) BUF_STRDUP(copy->v.s, alloc, j->v.s, strlen(j->v.s));
             break;
-        case orderly_json_boolean:
-            copy->v.b = j->v.b;
-            break;
-        case orderly_json_integer:
-            copy->v.i = j->v.i;
-            break;
-        case orderly_json_number:
-            copy->v.n = j->v.n;
-            break;
         case orderly_json_object:
-        case orderly_json_array: {
-            /* here's the deep copy part */
-            orderly_json * p;
-
+        case orderly_json_array:
+            memset((void *) &copy->v.children, 0, sizeof(copy->v.children));
             for (p = j->v.children.first; p != NULL; p = p->next) {
                 orderly_json * nk = orderly_clone_json(alloc, p);
                 if (copy->v.children.last) {
@@ -97,11 +106,74 @@ orderly_clone_json(const orderly_alloc_funcs * alloc, orderly_json * j)
                 }
             }
             break;
+        default:
+            copy->v = j->v;
+            break;
+    }
+}
+
+orderly_json *
+orderly_clone_json(const orderly_alloc_funcs * alloc, orderly_json * j)
+{
+    orderly_json * copy = NULL;
+    if (!j) return copy;
+    copy = orderly_alloc_json(alloc, j->t);
+    if (j->k) BUF_STRDUP(copy->k, alloc, j->k, strlen(j->k));
+
+    if (j->refs == &orderly_json_arena_refs) {
+        orderly_json_copy_value(alloc, copy, j);
+    } else {
+        copy->v = j->v;
+        /* only strings and containers have values worth sharing */
+        if (j->t == orderly_json_string || j->t == orderly_json_array
+            || j->t == orderly_json_object)
+        {
+            if (!j->refs) {
+                j->refs = (unsigned int *) OR_MALLOC(alloc,
+                                                     sizeof(unsigned int));
+                *(j->refs) = 1;
+            }
+            copy->refs = j->refs;
+            ++*(j->refs);
         }
     }
     return copy;
 }
 
+/* forget the index of a container whose value is its own, freeing it
+ * unless it's the arena's */
+static void
+orderly_json_unindex(const orderly_alloc_funcs * alloc, orderly_json * j)
+{
+    if (j->t != orderly_json_array && j->t != orderly_json_object) return;
+    if (j->v.children.items && j->refs != &orderly_json_arena_refs) {
+        OR_FREE(alloc, (void *) j->v.children.items);
+    }
+    j->v.children.items = NULL;
+    j->v.children.count = j->v.children.mask = 0;
+}
+
+void
+orderly_json_own(const orderly_alloc_funcs * alloc, orderly_json * j)
+{
+    orderly_json shared;
+
+    if (j->refs == &orderly_json_arena_refs) {
+        orderly_json_unindex(alloc, j);
+        return;
+    }
+    /* the sharers may all have gone */
+    if (j->refs && *(j->refs) > 1) {
+        shared = *j;
+        orderly_json_copy_value(alloc, j, &shared);
+        --*(j->refs);
+    } else {
+        orderly_json_unindex(alloc, j);
+        if (j->refs) OR_FREE(alloc, (void *) j->refs);
+    }
+    j->refs = NULL;
+}
+
 orderly_json *
 orderly_alloc_json(const orderly_alloc_funcs * alloc, orderly_json_type t)
 {
@@ -111,6 +183,140 @@ orderly_alloc_json(const orderly_alloc_funcs * alloc, orderly_json_type t)
     return n;
 }
 
+/* nodes and strings come from the arena when parsing into one */
+static orderly_json *
+o_json_parse_node(o_json_parse_context * pc, orderly_json_type t)
+{
+    orderly_json * n;
+    if (!pc->arena) return orderly_alloc_json(pc->alloc, t);
+    n = (orderly_json *) orderly_arena_malloc(pc->arena, sizeof(orderly_json));
+    memset((void *) n, 0, sizeof(orderly_json));
+    n->t = t;
+    n->refs = &orderly_json_arena_refs;
+    return n;
+}
+
+static char *
+o_json_parse_strdup(o_json_parse_context * pc, const unsigned char * v,
+                    unsigned int l)
+{
+    char * s = NULL;
+    if (pc->arena) return orderly_arena_strdup(pc->arena, v, l);
+    BUF_STRDUP(s, pc->alloc, v, l);
+    return s;
+}
+
+/* objects with fewer members than this are searched, not hashed */
+#define ORDERLY_JSON_HASH_MIN 8
+
+static unsigned int
+orderly_json_hash(const char * k, unsigned int len)
+{
+    /* FNV-1a */
+    unsigned int h = 2166136261U;
+    while (len--) {
+        h ^= (unsigned char) *k++;
+        h *= 16777619U;
+    }
+    return h;
+}
+
+static int
+orderly_json_key_is(const orderly_json * j, const char * k, unsigned int len)
+{
+    return j->k && !strncmp(j->k, k, len) && j->k[len] == 0;
+}
+
+void
+orderly_json_index(const orderly_alloc_funcs * alloc, orderly_arena arena,
+                   orderly_json * j)
+{
+    orderly_json * kid, ** items, ** table;
+    unsigned int n = 0, slots = 0, size;
+
+    if (!j || (j->t != orderly_json_array && j->t != orderly_json_object)) {
+        return;
+    }
+    for (kid = j->v.children.first; kid; kid = kid->next) {
+        orderly_json_index(alloc, arena, kid);
+        n++;
+    }
+    if (!n || j->v.children.items) return;
+    /* at most half full */
+    if (j->t == orderly_json_object && n >= ORDERLY_JSON_HASH_MIN) {
+        for (slots = 16; slots < 2 * n; slots <<= 1) ;
+    }
+    size = sizeof(orderly_json *) * (n + slots);
+    items = (orderly_json **) (arena ? orderly_arena_malloc(arena, size)
+                                     : OR_MALLOC(alloc, size));
+    n = 0;
+    for (kid = j->v.children.first; kid; kid = kid->next) items[n++] = kid;
+    if (slots) {
+        table = items + n;
+        memset((void *) table, 0, sizeof(orderly_json *) * slots);
+        /* members with the same key go in order, so the first is found
+         * first */
+        for (kid = j->v.children.first; kid; kid = kid->next) {
+            unsigned int i = kid->k ? orderly_json_hash(kid->k,
+                                                        strlen(kid->k)) : 0;
+            while (table[i & (slots - 1)]) i++;
+            table[i & (slots - 1)] = kid;
+        }
+    }
+    j->v.children.items = items;
+    j->v.children.count = n;
+    j->v.children.mask = slots ? slots - 1 : 0;
+}
+
+unsigned int
+orderly_json_count(const orderly_json * j)
+{
+    const orderly_json * kid;
+    unsigned int n = 0;
+
+    if (!j || (j->t != orderly_json_array && j->t != orderly_json_object)) {
+        return 0;
+    }
+    if (j->v.children.items) return j->v.children.count;
+    for (kid = j->v.children.first; kid; kid = kid->next) n++;
+    return n;
+}
+
+orderly_json *
+orderly_json_get(const orderly_json * j, unsigned int i)
+{
+    orderly_json * kid;
+
+    if (!j || (j->t != orderly_json_array && j->t != orderly_json_object)) {
+        return NULL;
+    }
+    if (j->v.children.items) {
+        return i < j->v.children.count ? j->v.children.items[i] : NULL;
+    }
+    for (kid = j->v.children.first; kid && i; kid = kid->next) i--;
+    return kid;
+}
+
+orderly_json *
+orderly_json_find(const orderly_json * j, const char * k, unsigned int len)
+{
+    orderly_json * kid;
+
+    if (!j || j->t != orderly_json_object) return NULL;
+    if (j->v.children.mask) {
+        orderly_json ** table = j->v.children.items + j->v.children.count;
+        unsigned int i = orderly_json_hash(k, len);
+        for (; (kid = table[i & j->v.children.mask]); i++) {
+            if (orderly_json_key_is(kid, k, len)) return kid;
+        }
+        return NULL;
+    }
+    for (kid = j->v.children.first; kid; kid = kid->next) {
+        if (orderly_json_key_is(kid, k, len)) return kid;
+    }
+    return NULL;
+}
+
 // push an element to the correct place
 #define PUSH_NODE(pc, __n)                                                      \
   if (orderly_ps_length((pc)->nodeStack) == 0) {                                \
@@ -133,7 +339,7 @@ orderly_alloc_json(const orderly_alloc_funcs * alloc, orderly_json_type t)
 int o_json_parse_start_array(void * ctx)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    orderly_json * n = orderly_alloc_json(pc->alloc, orderly_json_array);
+    orderly_json * n = o_json_parse_node(pc, orderly_json_array);
     orderly_ps_push(pc->alloc, pc->nodeStack, n);
     return 1;
 }
@@ -150,7 +356,7 @@ int o_json_parse_end_array(void * ctx)
 int o_json_parse_start_map(void * ctx)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    orderly_json * n = orderly_alloc_json(pc->alloc, orderly_json_object);
+    orderly_json * n = o_json_parse_node(pc, orderly_json_object);
     orderly_ps_push(pc->alloc, pc->nodeStack, n);
     return 1;
 }
@@ -159,8 +365,7 @@ int o_json_parse_map_key(void * ctx, const unsigned char * v,
                          unsigned int l)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    char * k = NULL;
-    BUF_STRDUP(k, pc->alloc, v, l);
+    char * k = o_json_parse_strdup(pc, v, l);
     orderly_ps_push(pc->alloc, pc->keyStack, k);
     return 1;
 }
@@ -177,8 +382,8 @@ int o_json_parse_end_map(void * ctx)
 int o_json_parse_string(void * ctx, const unsigned char * v, unsigned int l)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    orderly_json * n = orderly_alloc_json(pc->alloc, orderly_json_string);
-    BUF_STRDUP(n->v.s, pc->alloc, v, l);
+    orderly_json * n = o_json_parse_node(pc, orderly_json_string);
+    n->v.s = o_json_parse_strdup(pc, v, l);
     PUSH_NODE(pc, n);
     return 1;
 }
@@ -186,7 +391,7 @@ int o_json_parse_string(void * ctx, const unsigned char * v, unsigned int l)
 int o_json_parse_integer(void * ctx, long l)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    orderly_json * n = orderly_alloc_json(pc->alloc, orderly_json_integer);
+    orderly_json * n = o_json_parse_node(pc, orderly_json_integer);
     n->v.i = l;
     PUSH_NODE(pc, n);
     return 1;
@@ -195,7 +400,7 @@ int o_json_parse_integer(void * ctx, long l)
 int o_json_parse_double(void * ctx, double d)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    orderly_json * n = orderly_alloc_json(pc->alloc, orderly_json_number);
+    orderly_json * n = o_json_parse_node(pc, orderly_json_number);
     n->v.n = d;
     PUSH_NODE(pc, n);
     return 1;
@@ -204,7 +409,7 @@ int o_json_parse_double(void * ctx, double d)
 int o_json_parse_null(void * ctx)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    orderly_json * n = orderly_alloc_json(pc->alloc, orderly_json_null);
+    orderly_json * n = o_json_parse_node(pc, orderly_json_null);
     PUSH_NODE(pc, n);
     return 1;
 }
@@ -213,7 +418,7 @@ int o_json_parse_null(void * ctx)
 int o_json_parse_boolean(void * ctx, int val)
 {
     o_json_parse_context * pc = (o_json_parse_context *) ctx;
-    orderly_json * n = orderly_alloc_json(pc->alloc, orderly_json_boolean);
+    orderly_json * n = o_json_parse_node(pc, orderly_json_boolean);
     n->v.b = val;
     PUSH_NODE(pc, n);
     return 1;
@@ -223,10 +428,9 @@ int o_json_parse_boolean(void * ctx, int val)
 #include <stdio.h>
 
 
-orderly_json *
-orderly_read_json(orderly_alloc_funcs * alloc,
-                  const char * jsonText,
-                  unsigned int * len)
+static orderly_json *
+o_json_read(orderly_alloc_funcs * alloc, orderly_arena arena,
+            const char * jsonText, unsigned int * len)
 {
     static yajl_callbacks callbacks = {
         o_json_parse_null,
@@ -251,6 +455,7 @@ orderly_read_json(orderly_alloc_funcs * alloc,
 
     memset((void *) &pc, 0, sizeof(pc));
     pc.alloc = alloc;
+    pc.arena = arena;
 
     /* allocate a parser */
     hand = yajl_alloc(&callbacks, &cfg,
@@ -287,6 +492,35 @@ orderly_read_json(orderly_alloc_funcs * alloc,
     return j;
 }
 
+orderly_json *
+orderly_read_json(orderly_alloc_funcs * alloc,
+                  const char * jsonText,
+                  unsigned int * len)
+{
+    return o_json_read(alloc, NULL, jsonText, len);
+}
+
+orderly_json *
+orderly_read_json_arena(orderly_alloc_funcs * alloc,
+                        orderly_arena arena,
+                        const char * jsonText,
+                        unsigned int * len)
+{
+    return o_json_read(alloc, arena, jsonText, len);
+}
+
+
+yajl_gen_status
+orderly_gen_double(yajl_gen g, double d)
+{
+    char buf[ORDERLY_DOUBLE_BUFSIZE];
+    unsigned int len;
+
+    /* infinities and NaN aren't json, and are left to yajl */
+    if (d - d != 0) return yajl_gen_double(g, d);
+    len = orderly_format_double(d, buf);
+    return yajl_gen_number(g, buf, len);
+}
 
 int orderly_write_json2(yajl_gen g, const orderly_json * j)
 {
@@ -312,7 +546,7 @@ int orderly_write_json2(yajl_gen g, const orderly_json * j)
                 s = yajl_gen_integer(g, j->v.i);
                 break;
             case orderly_json_number:
-                s = yajl_gen_double(g, j->v.n);
+                s = orderly_gen_double(g, j->v.n);
                 break;
             case orderly_json_object:
                 s = yajl_gen_map_open(g);
@@ -39,6 +39,7 @@
 #include "api/common.h"
 #include "orderly_ptrstack.h"
 #include "orderly_buf.h"
+#include "orderly_arena.h"
 
 #include <yajl/yajl_gen.h>
 
@@ -47,6 +48,15 @@ orderly_json * orderly_read_json(orderly_alloc_funcs * alloc,
                                  const char * jsonText,
                                  unsigned int * len);
 
+/* like orderly_read_json, but every node and string of the json comes
+ * from arena, and goes when the arena is reset or freed.  json read
+ * this way mustn't be handed to orderly_free_json.  alloc is for the
+ * parse itself */
+orderly_json * orderly_read_json_arena(orderly_alloc_funcs * alloc,
+                                       orderly_arena arena,
+                                       const char * jsonText,
+                                       unsigned int * len);
+
 /* a high level interface to non-stream based json parsing */
 void orderly_write_json(const orderly_alloc_funcs * alloc,
                         const orderly_json * json,
@@ -57,16 +67,51 @@ void orderly_write_json(const orderly_alloc_funcs * alloc,
  * generator */
 int orderly_write_json2(yajl_gen g, const orderly_json * j);
 
+/* generate d as the fewest digits that read back as d, which
+ * yajl_gen_double's %g doesn't promise */
+yajl_gen_status orderly_gen_double(yajl_gen g, double d);
+
 void orderly_free_json(const orderly_alloc_funcs * alloc, orderly_json ** node);
 
 orderly_json * orderly_alloc_json(const orderly_alloc_funcs * alloc,
                                   orderly_json_type t);
 
-/* make a deep copy of a json object, copying everything except sibling
- * pointers */
+/* index the containers of j and all it holds, so that their children
+ * can be had by position and object members by key without walking
+ * them.  the index comes from arena if it's not NULL, and otherwise
+ * from alloc and goes with orderly_free_json.  an indexed container
+ * mustn't have children added or taken away until orderly_json_own
+ * drops its index */
+void orderly_json_index(const orderly_alloc_funcs * alloc,
+                        orderly_arena arena, orderly_json * j);
+
+/* the number of children of a container, 0 for anything else */
+unsigned int orderly_json_count(const orderly_json * j);
+
+/* child i of a container, NULL if there are fewer.  constant time once
+ * indexed */
+orderly_json * orderly_json_get(const orderly_json * j, unsigned int i);
+
+/* the first member of object j with key k, which is len bytes long, or
+ * NULL.  constant time once indexed, for all but the smallest objects */
+orderly_json * orderly_json_find(const orderly_json * j, const char * k,
+                                 unsigned int len);
+
+/* copy a json object, everything except its sibling pointer, in
+ * constant time.  the copy shares j's value, and the two must be
+ * treated as immutable until orderly_json_own gives one a value of its
+ * own.  json read into an arena can't be shared, and is copied deeply.
+ * the counts of sharers aren't atomic, so a value mustn't be cloned or
+ * freed by two threads at once */
 orderly_json * orderly_clone_json(const orderly_alloc_funcs * alloc,
                                   orderly_json * j);
 
+/* ready j to be changed, copying its value if that's shared with
+ * clones.  its members are then j's own to add to, remove or reorder,
+ * but each must itself be owned before it's changed, and any index is
+ * dropped */
+void orderly_json_own(const orderly_alloc_funcs * alloc, orderly_json * j);
+
 /* callbacks capable of building up orderly_json objects from yajl parse
  * events, used by orderly_json_parse to build json structures directly out
  * of the parse event stream */
@@ -75,6 +120,8 @@ typedef struct o_json_parse_context_t
     /* context for parsing nothing more than a stack and allocation
      * functions */
     orderly_alloc_funcs * alloc;
+    /* where nodes and strings come from, if not alloc */
+    orderly_arena arena;
     orderly_ptrstack nodeStack;
     orderly_ptrstack keyStack;
 } o_json_parse_context;
@@ -228,17 +228,18 @@ parse_json_schema(orderly_alloc_funcs * alloc,
                 }
             }
             else if (!strcmp(k->k, "additionalProperties")) {
+                /* of a schema, only the type is used */
+                orderly_json * type = orderly_json_find(k, "type", 4);
                 if (k->t == orderly_json_boolean) {
                     (*n)->additional_properties = 
                       k->v.b 
                       ? orderly_node_any
                       : orderly_node_empty;
-                } else if (k->t == orderly_json_object
-                           && !strcmp(k->v.children.first->k, "type")) {
-                  if (k->v.children.first->t == orderly_json_string) {
+                } else if (type) {
+                  if (type->t == orderly_json_string) {
                       (*n)->additional_properties = 
-                        orderly_string_to_node_type(k->v.children.first->v.s, 
-                                                    strlen(k->v.children.first->v.s));
+                        orderly_string_to_node_type(type->v.s, 
+                                                    strlen(type->v.s));
                     } else {
                       s = orderly_json_parse_s_invalid_type_value;
                       goto toErrIsHuman;
@@ -297,26 +298,23 @@ parse_json_schema(orderly_alloc_funcs * alloc,
                     (*n)->requires = OR_MALLOC(alloc, 2 * sizeof(char *));
                     BUF_STRDUP((*n)->requires[0], alloc, k->v.s, strlen(k->v.s));
                     (*n)->requires[1] = NULL;
-                } else if (k->t == orderly_json_array) {
+                } else if (k->t == orderly_json_array
+                           && orderly_json_count(k) > 0) {
                     unsigned int num = 0;
                     orderly_json * ks;
+                    char ** p = OR_MALLOC(alloc, sizeof(char *)
+                                          * (orderly_json_count(k) + 1));
                     
+                    p[0] = NULL;
+                    (*n)->requires = (const char **) p;
                     for (ks = k->v.children.first; ks; ks = ks->next)
                     {
-                        unsigned int i;
-                        char ** p;
-
                         if (ks->t != orderly_json_string) {
                             s = orderly_json_parse_s_requires_value_error;
                             goto toErrIsHuman;
                         }
-                        num++;
-                        p = OR_MALLOC(alloc, sizeof(char *) * (num + 1));
-                        for (i = 0; i < num - 1; i++) p[i] = (char *) (*n)->requires[i];
-                        BUF_STRDUP(p[i], alloc, ks->v.s, strlen(ks->v.s));
-                        p[++i] = NULL;
-                        if ((*n)->requires) OR_FREE(alloc, (*n)->requires);
-                        (*n)->requires = (const char **) p;
+                        BUF_STRDUP(p[num], alloc, ks->v.s, strlen(ks->v.s));
+                        p[++num] = NULL;
                     }
                 }
             }
@@ -359,18 +357,26 @@ orderly_json_parse(orderly_alloc_funcs * alloc,
     /* a high level interface to non-stream based json parsing */
     orderly_json_parse_status s;
     orderly_json * j;
+    /* the json is only needed until it's been interpreted, everything
+     * kept is copied out of it, so it's let go of all at once */
+    orderly_arena arena = orderly_arena_alloc(alloc);
 
     *final_offset = schemaTextLen;
     
-    j = orderly_read_json(alloc, (const char *) schemaText, final_offset);
-    if (j == NULL) return orderly_json_parse_s_invalid_json;
+    j = orderly_read_json_arena(alloc, arena, (const char *) schemaText,
+                                final_offset);
+    if (j == NULL) {
+        orderly_arena_free(arena);
+        return orderly_json_parse_s_invalid_json;
+    }
+    orderly_json_index(alloc, arena, j);
     
     /* we've parsed the json into a memory representation, now let's
      * interpret it's semantic meaning as we merge it over into a
      * orderly_node representation */
     s = parse_json_schema(alloc, j, n);
 
-    (void) orderly_free_json(alloc, &j);
+    orderly_arena_free(arena);
     
     return s;
 }
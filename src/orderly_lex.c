@@ -48,18 +48,12 @@ struct orderly_lexer_t {
 orderly_lexer
 orderly_lex_alloc(orderly_alloc_funcs * alloc)
 {
-    static orderly_alloc_funcs orderlyAllocFuncBuffer;
-    static orderly_alloc_funcs * orderlyAllocFuncBufferPtr = NULL;
-
     orderly_lexer lxr = NULL;
 
-    if (orderlyAllocFuncBufferPtr == NULL) {
-        orderly_set_default_alloc_funcs(&orderlyAllocFuncBuffer);
-        orderlyAllocFuncBufferPtr = &orderlyAllocFuncBuffer;
+    if (alloc == NULL) {
+        alloc = (orderly_alloc_funcs *) &orderly_default_alloc_funcs;
     }
 
-    if (alloc == NULL) alloc = orderlyAllocFuncBufferPtr;
-
     assert( alloc != NULL );
 
     lxr = (orderly_lexer) OR_MALLOC(alloc, sizeof(struct orderly_lexer_t));
@@ -755,15 +755,8 @@ orderly_parse(orderly_alloc_funcs * alloc,
      * to zero */
     if (final_offset) *final_offset = 0;
 
-    {
-        static orderly_alloc_funcs orderlyAllocFuncBuffer;
-        static orderly_alloc_funcs * orderlyAllocFuncBufferPtr = NULL;
-
-        if (orderlyAllocFuncBufferPtr == NULL) {
-            orderly_set_default_alloc_funcs(&orderlyAllocFuncBuffer);
-            orderlyAllocFuncBufferPtr = &orderlyAllocFuncBuffer;
-        }
-        if (alloc == NULL) alloc = orderlyAllocFuncBufferPtr;
+    if (alloc == NULL) {
+        alloc = (orderly_alloc_funcs *) &orderly_default_alloc_funcs;
     }
 
     *n = NULL;
@@ -61,16 +61,7 @@ orderly_reader_new(const orderly_alloc_funcs * alloc)
 {
     orderly_reader rdr = NULL;
 
-    {
-        static orderly_alloc_funcs orderlyAllocFuncBuffer;
-        static orderly_alloc_funcs * orderlyAllocFuncBufferPtr = NULL;
-
-        if (orderlyAllocFuncBufferPtr == NULL) {
-            orderly_set_default_alloc_funcs(&orderlyAllocFuncBuffer);
-            orderlyAllocFuncBufferPtr = &orderlyAllocFuncBuffer;
-        }
-        if (alloc == NULL) alloc = orderlyAllocFuncBufferPtr;
-    }
+    if (alloc == NULL) alloc = &orderly_default_alloc_funcs;
 
     rdr = OR_MALLOC(alloc, sizeof(struct orderly_reader_t));
     memcpy((void *) (&(rdr->alloc)), (void *) alloc,
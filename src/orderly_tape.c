@@ -0,0 +1,399 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#include "orderly_tape.h"
+
+#include <string.h>
+
+#define ORDERLY_TAPE_INIT_SIZE 64
+
+void orderly_tape_init(orderly_tape * tape)
+{
+    tape->data = NULL;
+    tape->len = tape->cap = 0;
+}
+
+void orderly_tape_free(const orderly_alloc_funcs * alloc, orderly_tape * tape)
+{
+    if (tape->data) OR_FREE(alloc, tape->data);
+    orderly_tape_init(tape);
+}
+
+/* room for want more bytes, returning where they go */
+static
+unsigned char * orderly_tape_extend(const orderly_alloc_funcs * alloc,
+                                    orderly_tape * tape, unsigned int want)
+{
+    unsigned char * p;
+    if (tape->cap - tape->len < want) {
+        unsigned int need = tape->cap ? tape->cap : ORDERLY_TAPE_INIT_SIZE;
+        while (need - tape->len < want) need <<= 1;
+        tape->data = (unsigned char *) OR_REALLOC(alloc, tape->data, need);
+        tape->cap = need;
+    }
+    p = tape->data + tape->len;
+    tape->len += want;
+    return p;
+}
+
+static
+void orderly_tape_append(const orderly_alloc_funcs * alloc,
+                         orderly_tape * tape, orderly_tape_event e,
+                         const void * payload, unsigned int len)
+{
+    unsigned char * p = orderly_tape_extend(alloc, tape, 1 + len);
+    *p = (unsigned char) e;
+    if (len) memcpy((void *) (p + 1), payload, len);
+}
+
+static
+void orderly_tape_append_text(const orderly_alloc_funcs * alloc,
+                              orderly_tape * tape, orderly_tape_event e,
+                              const char * s, unsigned int len)
+{
+    unsigned char * p = orderly_tape_extend(alloc, tape,
+                                            1 + sizeof(unsigned int) + len);
+    *p++ = (unsigned char) e;
+    memcpy((void *) p, (const void *) &len, sizeof(unsigned int));
+    memcpy((void *) (p + sizeof(unsigned int)), (const void *) s, len);
+}
+
+/* open a container, its byte count to be filled in when it's closed.
+ * returns the offset of its start */
+static
+unsigned int orderly_tape_open(const orderly_alloc_funcs * alloc,
+                               orderly_tape * tape, orderly_tape_event e)
+{
+    unsigned int pos = tape->len, count = 0;
+    orderly_tape_append(alloc, tape, e, &count, sizeof(unsigned int));
+    return pos;
+}
+
+static
+void orderly_tape_close(const orderly_alloc_funcs * alloc,
+                        orderly_tape * tape, unsigned int pos)
+{
+    unsigned int count;
+    orderly_tape_append(alloc, tape,
+                        tape->data[pos] == orderly_tape_start_map
+                        ? orderly_tape_end_map : orderly_tape_end_array,
+                        NULL, 0);
+    count = tape->len - (pos + 1 + sizeof(unsigned int));
+    memcpy((void *) (tape->data + pos + 1), (const void *) &count,
+           sizeof(unsigned int));
+}
+
+void orderly_tape_append_key(const orderly_alloc_funcs * alloc,
+                             orderly_tape * tape,
+                             const char * key, unsigned int len)
+{
+    orderly_tape_append_text(alloc, tape, orderly_tape_key, key, len);
+}
+
+void orderly_tape_append_json(const orderly_alloc_funcs * alloc,
+                              orderly_tape * tape, const orderly_json * j)
+{
+    const orderly_json * kid;
+    unsigned int pos;
+    long l;
+
+    switch (j->t) {
+        case orderly_json_null:
+            orderly_tape_append(alloc, tape, orderly_tape_null, NULL, 0);
+            break;
+        case orderly_json_boolean:
+            orderly_tape_append(alloc, tape, j->v.b ? orderly_tape_true
+                                : orderly_tape_false, NULL, 0);
+            break;
+        case orderly_json_integer:
+            l = j->v.i;
+            orderly_tape_append(alloc, tape, orderly_tape_integer,
+                                &l, sizeof(long));
+            break;
+        case orderly_json_number:
+            orderly_tape_append(alloc, tape, orderly_tape_double,
+                                &(j->v.n), sizeof(double));
+            break;
+        case orderly_json_string:
+            orderly_tape_append_text(alloc, tape, orderly_tape_string,
+                                     j->v.s, strlen(j->v.s));
+            break;
+        case orderly_json_object:
+            pos = orderly_tape_open(alloc, tape, orderly_tape_start_map);
+            for (kid = j->v.children.first; kid; kid = kid->next) {
+                orderly_tape_append_key(alloc, tape, kid->k, strlen(kid->k));
+                orderly_tape_append_json(alloc, tape, kid);
+            }
+            orderly_tape_close(alloc, tape, pos);
+            break;
+        case orderly_json_array:
+            pos = orderly_tape_open(alloc, tape, orderly_tape_start_array);
+            for (kid = j->v.children.first; kid; kid = kid->next) {
+                orderly_tape_append_json(alloc, tape, kid);
+            }
+            orderly_tape_close(alloc, tape, pos);
+            break;
+        case orderly_json_none:
+            break;
+    }
+}
+
+static
+int orderly_tape_replay_range(const unsigned char * p,
+                              const unsigned char * end,
+                              const yajl_callbacks * cb, void * ctx)
+{
+    unsigned int len;
+    long l;
+    double d;
+    int ret = 1;
+
+    while (p < end) {
+        switch ((orderly_tape_event) *p++) {
+            case orderly_tape_null:
+                if (cb->yajl_null) ret = cb->yajl_null(ctx);
+                break;
+            case orderly_tape_false:
+                if (cb->yajl_boolean) ret = cb->yajl_boolean(ctx, 0);
+                break;
+            case orderly_tape_true:
+                if (cb->yajl_boolean) ret = cb->yajl_boolean(ctx, 1);
+                break;
+            case orderly_tape_integer:
+                memcpy((void *) &l, (const void *) p, sizeof(long));
+                p += sizeof(long);
+                if (cb->yajl_integer) ret = cb->yajl_integer(ctx, l);
+                break;
+            case orderly_tape_double:
+                memcpy((void *) &d, (const void *) p, sizeof(double));
+                p += sizeof(double);
+                if (cb->yajl_double) ret = cb->yajl_double(ctx, d);
+                break;
+            case orderly_tape_string:
+                memcpy((void *) &len, (const void *) p, sizeof(unsigned int));
+                p += sizeof(unsigned int);
+                if (cb->yajl_string) ret = cb->yajl_string(ctx, p, len);
+                p += len;
+                break;
+            case orderly_tape_key:
+                memcpy((void *) &len, (const void *) p, sizeof(unsigned int));
+                p += sizeof(unsigned int);
+                if (cb->yajl_map_key) ret = cb->yajl_map_key(ctx, p, len);
+                p += len;
+                break;
+            case orderly_tape_start_map:
+                p += sizeof(unsigned int);
+                if (cb->yajl_start_map) ret = cb->yajl_start_map(ctx);
+                break;
+            case orderly_tape_end_map:
+                if (cb->yajl_end_map) ret = cb->yajl_end_map(ctx);
+                break;
+            case orderly_tape_start_array:
+                p += sizeof(unsigned int);
+                if (cb->yajl_start_array) ret = cb->yajl_start_array(ctx);
+                break;
+            case orderly_tape_end_array:
+                if (cb->yajl_end_array) ret = cb->yajl_end_array(ctx);
+                break;
+        }
+        if (!ret) return 0;
+    }
+    return 1;
+}
+
+int orderly_tape_replay(const orderly_tape * tape, const yajl_callbacks * cb,
+                        void * ctx)
+{
+    return orderly_tape_replay_range(tape->data, tape->data + tape->len,
+                                     cb, ctx);
+}
+
+unsigned int orderly_tape_next(const orderly_tape * tape, unsigned int pos)
+{
+    unsigned int len;
+
+    switch (orderly_tape_event_at(tape, pos)) {
+        case orderly_tape_integer:
+            return pos + 1 + sizeof(long);
+        case orderly_tape_double:
+            return pos + 1 + sizeof(double);
+        case orderly_tape_string:
+        case orderly_tape_key:
+            memcpy((void *) &len, (const void *) (tape->data + pos + 1),
+                   sizeof(unsigned int));
+            return pos + 1 + sizeof(unsigned int) + len;
+        case orderly_tape_start_map:
+        case orderly_tape_start_array:
+            return pos + 1 + sizeof(unsigned int);
+        default:
+            return pos + 1;
+    }
+}
+
+unsigned int orderly_tape_skip(const orderly_tape * tape, unsigned int pos)
+{
+    unsigned int count;
+
+    switch (orderly_tape_event_at(tape, pos)) {
+        case orderly_tape_start_map:
+        case orderly_tape_start_array:
+            memcpy((void *) &count, (const void *) (tape->data + pos + 1),
+                   sizeof(unsigned int));
+            return pos + 1 + sizeof(unsigned int) + count;
+        default:
+            return orderly_tape_next(tape, pos);
+    }
+}
+
+const unsigned char * orderly_tape_text(const orderly_tape * tape,
+                                        unsigned int pos, unsigned int * len)
+{
+    memcpy((void *) len, (const void *) (tape->data + pos + 1),
+           sizeof(unsigned int));
+    return tape->data + pos + 1 + sizeof(unsigned int);
+}
+
+int orderly_tape_replay_value(const orderly_tape * tape, unsigned int pos,
+                              const yajl_callbacks * cb, void * ctx)
+{
+    return orderly_tape_replay_range(tape->data + pos,
+                                     tape->data + orderly_tape_skip(tape, pos),
+                                     cb, ctx);
+}
+
+/* the builder's callbacks */
+#define BUILDER(ctx) ((orderly_tape_builder *) (ctx))
+
+static int orderly_tape_build_null(void * ctx)
+{
+    orderly_tape_append(BUILDER(ctx)->alloc, BUILDER(ctx)->tape,
+                        orderly_tape_null, NULL, 0);
+    return 1;
+}
+
+static int orderly_tape_build_boolean(void * ctx, int b)
+{
+    orderly_tape_append(BUILDER(ctx)->alloc, BUILDER(ctx)->tape,
+                        b ? orderly_tape_true : orderly_tape_false, NULL, 0);
+    return 1;
+}
+
+static int orderly_tape_build_integer(void * ctx, long l)
+{
+    orderly_tape_append(BUILDER(ctx)->alloc, BUILDER(ctx)->tape,
+                        orderly_tape_integer, &l, sizeof(long));
+    return 1;
+}
+
+static int orderly_tape_build_double(void * ctx, double d)
+{
+    orderly_tape_append(BUILDER(ctx)->alloc, BUILDER(ctx)->tape,
+                        orderly_tape_double, &d, sizeof(double));
+    return 1;
+}
+
+static int orderly_tape_build_string(void * ctx, const unsigned char * s,
+                                     unsigned int len)
+{
+    orderly_tape_append_text(BUILDER(ctx)->alloc, BUILDER(ctx)->tape,
+                             orderly_tape_string, (const char *) s, len);
+    return 1;
+}
+
+static int orderly_tape_build_key(void * ctx, const unsigned char * s,
+                                  unsigned int len)
+{
+    orderly_tape_append_text(BUILDER(ctx)->alloc, BUILDER(ctx)->tape,
+                             orderly_tape_key, (const char *) s, len);
+    return 1;
+}
+
+static int orderly_tape_build_open(orderly_tape_builder * b,
+                                   orderly_tape_event e)
+{
+    if (b->depth == b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 16;
+        b->open = (unsigned int *)
+            OR_REALLOC(b->alloc, b->open, sizeof(unsigned int) * b->cap);
+    }
+    b->open[b->depth++] = orderly_tape_open(b->alloc, b->tape, e);
+    return 1;
+}
+
+static int orderly_tape_build_start_map(void * ctx)
+{
+    return orderly_tape_build_open(BUILDER(ctx), orderly_tape_start_map);
+}
+
+static int orderly_tape_build_start_array(void * ctx)
+{
+    return orderly_tape_build_open(BUILDER(ctx), orderly_tape_start_array);
+}
+
+static int orderly_tape_build_close(void * ctx)
+{
+    orderly_tape_builder * b = BUILDER(ctx);
+    orderly_tape_close(b->alloc, b->tape, b->open[--b->depth]);
+    return 1;
+}
+
+const yajl_callbacks orderly_tape_callbacks = {
+    orderly_tape_build_null,
+    orderly_tape_build_boolean,
+    orderly_tape_build_integer,
+    orderly_tape_build_double,
+    NULL,
+    orderly_tape_build_string,
+    orderly_tape_build_start_map,
+    orderly_tape_build_key,
+    orderly_tape_build_close,
+    orderly_tape_build_start_array,
+    orderly_tape_build_close
+};
+
+void orderly_tape_builder_init(orderly_tape_builder * b,
+                               const orderly_alloc_funcs * alloc,
+                               orderly_tape * tape)
+{
+    b->alloc = alloc ? alloc : &orderly_default_alloc_funcs;
+    b->tape = tape;
+    b->open = NULL;
+    b->depth = b->cap = 0;
+}
+
+void orderly_tape_builder_free(orderly_tape_builder * b)
+{
+    if (b->open) OR_FREE(b->alloc, b->open);
+    b->open = NULL;
+    b->depth = b->cap = 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+/* json as a flat tape of the events that yajl would report parsing it,
+ * for replaying into callbacks without walking an orderly_json tree.
+ * a tape is one contiguous buffer, so whole documents can be held and
+ * handed on again for about the cost of reading it through */
+
+#ifndef __ORDERLY_TAPE_H__
+#define __ORDERLY_TAPE_H__
+
+#include "api/json.h"
+#include "orderly_alloc.h"
+
+#include <yajl/yajl_parse.h>
+
+/* each event is a byte, followed by its payload: a long for an
+ * integer, a double for a number, an unsigned int length and then
+ * the bytes themselves for a string or key, and for the start of a map
+ * or array an unsigned int count of the bytes after it up to and
+ * including the end event, so a container can be stepped over without
+ * reading it.  payloads aren't aligned */
+typedef enum {
+    orderly_tape_null,
+    orderly_tape_false,
+    orderly_tape_true,
+    orderly_tape_integer,
+    orderly_tape_double,
+    orderly_tape_string,
+    orderly_tape_key,
+    orderly_tape_start_map,
+    orderly_tape_end_map,
+    orderly_tape_start_array,
+    orderly_tape_end_array
+} orderly_tape_event;
+
+typedef struct {
+    unsigned char * data;
+    unsigned int len;
+    unsigned int cap;
+} orderly_tape;
+
+/* an empty tape, which needs no freeing until something is appended */
+void orderly_tape_init(orderly_tape * tape);
+
+void orderly_tape_free(const orderly_alloc_funcs * alloc, orderly_tape * tape);
+
+/* append a key */
+void orderly_tape_append_key(const orderly_alloc_funcs * alloc,
+                             orderly_tape * tape,
+                             const char * key, unsigned int len);
+
+/* append the events of a value.  the keys of its own members are
+ * recorded, any key of j itself isn't */
+void orderly_tape_append_json(const orderly_alloc_funcs * alloc,
+                              orderly_tape * tape, const orderly_json * j);
+
+/* hand the events on tape to cb, skipping those it has no callback
+ * for.  returns 0 if a callback cancels, 1 otherwise */
+int orderly_tape_replay(const orderly_tape * tape, const yajl_callbacks * cb,
+                        void * ctx);
+
+/* events are found by their offset in the tape.  the event at pos */
+#define orderly_tape_event_at(tape, pos) \
+    ((orderly_tape_event) (tape)->data[(pos)])
+
+/* the offset of the event after the one at pos, which for the start of
+ * a container is its first member */
+unsigned int orderly_tape_next(const orderly_tape * tape, unsigned int pos);
+
+/* the offset after the whole value at pos, in constant time.  for a
+ * key that's the offset of its value */
+unsigned int orderly_tape_skip(const orderly_tape * tape, unsigned int pos);
+
+/* the bytes of the string or key at pos */
+const unsigned char * orderly_tape_text(const orderly_tape * tape,
+                                        unsigned int pos, unsigned int * len);
+
+/* like orderly_tape_replay, for just the value at pos */
+int orderly_tape_replay_value(const orderly_tape * tape, unsigned int pos,
+                              const yajl_callbacks * cb, void * ctx);
+
+/* builds a tape from the events of a parse.  hand orderly_tape_callbacks
+ * to yajl with a builder as their context, and the events it parses
+ * are appended to tape */
+typedef struct {
+    const orderly_alloc_funcs * alloc;
+    orderly_tape * tape;
+    /* the offsets of the containers still open */
+    unsigned int * open;
+    unsigned int depth;
+    unsigned int cap;
+} orderly_tape_builder;
+
+extern const yajl_callbacks orderly_tape_callbacks;
+
+/* alloc may be NULL, for the malloc based routines */
+void orderly_tape_builder_init(orderly_tape_builder * b,
+                               const orderly_alloc_funcs * alloc,
+                               orderly_tape * tape);
+
+/* the tape is the caller's, and is left as it is */
+void orderly_tape_builder_free(orderly_tape_builder * b);
+
+#endif
@@ -35,6 +35,7 @@
 #include "orderly_buf.h"
 #include "orderly_lex.h"
 #include "orderly_json.h"
+#include "orderly_double.h"
 
 #include <yajl/yajl_gen.h>
 
@@ -52,16 +53,9 @@ orderly_writer
 orderly_writer_new(const struct orderly_writer_config * cfg)
 {
     orderly_writer w;
-    static struct orderly_writer_config s_cfg;
-    static orderly_alloc_funcs s_alloc;
-    static int initd;
-    
-    if (!initd) {
-        orderly_set_default_alloc_funcs(&s_alloc);
-        s_cfg.alloc = &s_alloc;
-        s_cfg.pretty = 1;
-        initd = 1;
-    }        
+    static const struct orderly_writer_config s_cfg = {
+        (orderly_alloc_funcs *) &orderly_default_alloc_funcs, 1
+    };
 
     /* if !cfg we'll use defaults */
     if (!cfg) cfg = &s_cfg;
@@ -71,7 +65,9 @@ orderly_writer_new(const struct orderly_writer_config * cfg)
     memcpy((void *) &(w->cfg), (void *) cfg,
            sizeof(struct orderly_writer_config));
 
-    if (!w->cfg.alloc) w->cfg.alloc = &s_alloc;
+    if (!w->cfg.alloc) {
+        w->cfg.alloc = (orderly_alloc_funcs *) &orderly_default_alloc_funcs;
+    }
 
     return w;
 }
@@ -146,14 +142,14 @@ dumpNodeAsOrderly(orderly_writer w, const orderly_node * n, unsigned int indent,
             orderly_buf_append_string(w->b, "{");
             buf[0] = 0;
             if (ORDERLY_RANGE_LHS_DOUBLE & n->range.info)
-                sprintf(buf, "%.15g", n->range.lhs.d);
+                orderly_format_double(n->range.lhs.d, buf);
             else if (ORDERLY_RANGE_LHS_INT & n->range.info)
                 sprintf(buf, "%ld", n->range.lhs.i);
             if (buf[0]) orderly_buf_append_string(w->b, buf);
             orderly_buf_append_string(w->b, ",");
             buf[0] = 0;
             if (ORDERLY_RANGE_RHS_DOUBLE & n->range.info)
-                sprintf(buf, "%.15g", n->range.rhs.d);
+                orderly_format_double(n->range.rhs.d, buf);
             else if (ORDERLY_RANGE_RHS_INT & n->range.info)
                 sprintf(buf, "%ld", n->range.rhs.i);
             if (buf[0]) orderly_buf_append_string(w->b, buf);
@@ -235,7 +231,10 @@ dumpNodeAsOrderly(orderly_writer w, const orderly_node * n, unsigned int indent,
 
             if (!pp) {
               pp = orderly_alloc_json(w->cfg.alloc,orderly_json_object);
-            } 
+            } else {
+              /* our clone shares the node's members until now */
+              orderly_json_own(w->cfg.alloc, pp);
+            }
             ap = orderly_alloc_json(w->cfg.alloc,orderly_json_string);
             type = orderly_alloc_json(w->cfg.alloc,orderly_json_string);
             key = orderly_alloc_json(w->cfg.alloc,orderly_json_string);
@@ -366,7 +365,7 @@ dumpNodeAsJSONSchema(orderly_writer w, const orderly_node * n, yajl_gen yg)
             if (ORDERLY_RANGE_HAS_LHS(n->range)) {
                 YAJL_GEN_STRING_WLEN(yg, minword);
                 if (ORDERLY_RANGE_LHS_DOUBLE & n->range.info)
-                    yajl_gen_double(yg, n->range.lhs.d);
+                    orderly_gen_double(yg, n->range.lhs.d);
                 else if (ORDERLY_RANGE_LHS_INT & n->range.info)
                     yajl_gen_integer(yg, n->range.lhs.i);
             }
@@ -374,7 +373,7 @@ dumpNodeAsJSONSchema(orderly_writer w, const orderly_node * n, yajl_gen yg)
             if (ORDERLY_RANGE_HAS_RHS(n->range)) {
                 YAJL_GEN_STRING_WLEN(yg, maxword);
                 if (ORDERLY_RANGE_RHS_DOUBLE & n->range.info)
-                    yajl_gen_double(yg, n->range.rhs.d);
+                    orderly_gen_double(yg, n->range.rhs.d);
                 else if (ORDERLY_RANGE_RHS_INT & n->range.info)
                     yajl_gen_integer(yg, n->range.rhs.i);
             }
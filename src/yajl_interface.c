@@ -32,6 +32,7 @@
 
 #include "ajv_state.h"
 #include "ajv_schema.h"
+#include "ajv_program.h"
 #include "yajl_interface.h"
 #include "api/ajv_parse.h"
 #include "api/reader.h"
@@ -72,55 +73,50 @@ static int pass_ajv_start_array(void * ctx);
 static int pass_ajv_end_array(void * ctx);
 static int pass_ajv_null(void * ctx);
 static int pass_ajv_boolean(void * ctx, int booleanValue);
-static const ajv_node * orderly_subsumed_by (const orderly_node_type a, 
-                                             const ajv_node *b);
-
-
-
-
-/* is type a subsumed by type b? (everything is subsumed by any) */
-static const ajv_node * orderly_subsumed_by (const orderly_node_type a, 
-                                             const ajv_node *b) {
-  const ajv_node *cur;
-  switch (b->node->t) {
-  case orderly_node_union:   
-    for (cur = b->child; cur; cur = cur->sibling) {
-      const ajv_node *ret = orderly_subsumed_by(a,cur);
-      if (ret) return ret;
-    }
-    return NULL;
-
-  case orderly_node_empty:   return a == b->node->t ? b : NULL; 
-  case orderly_node_null:    return a == b->node->t ? b : NULL; 
-  case orderly_node_string:  return a == b->node->t ? b : NULL; 
-  case orderly_node_integer: return a == b->node->t ? b : NULL; 
-  case orderly_node_boolean: return a == b->node->t ? b : NULL; 
-  case orderly_node_number:  
-    return a == b->node->t || a == orderly_node_integer ? b : NULL;
-  case orderly_node_object:  return a == b->node->t ? b : NULL; 
-  case orderly_node_array:   return a == b->node->t ? b : NULL;
-  case orderly_node_any:     return b;
-  }  
-  return NULL;
-}
-
-
-
-int ick_strcmp(const char *a, const char *b, unsigned int blen);
+static int prog_ajv_map_key(void * ctx, const unsigned char * key, 
+                            unsigned int stringLen);
+static int prog_ajv_start_map (void * ctx);
+static int prog_ajv_end_map(void * ctx);
+static int prog_ajv_integer(void * ctx, long integerValue);
+static int prog_ajv_double(void * ctx, double value);
+
+static int prog_ajv_string(void * ctx, const unsigned char * stringVal,
+               unsigned int stringLen);
+static int prog_ajv_start_array(void * ctx);
+static int prog_ajv_end_array(void * ctx);
+static int prog_ajv_null(void * ctx);
+static int prog_ajv_boolean(void * ctx, int booleanValue);
+static int skip_ajv_open(void * ctx);
+static int skip_ajv_close(void * ctx);
+static int tee_ajv_map_key(void * ctx, const unsigned char * key, 
+                           unsigned int stringLen);
+static int tee_ajv_start_map (void * ctx);
+static int tee_ajv_end_map(void * ctx);
+static int tee_ajv_integer(void * ctx, long integerValue);
+static int tee_ajv_double(void * ctx, double value);
+static int tee_ajv_string(void * ctx, const unsigned char * stringVal,
+                          unsigned int stringLen);
+static int tee_ajv_start_array(void * ctx);
+static int tee_ajv_end_array(void * ctx);
+static int tee_ajv_null(void * ctx);
+static int tee_ajv_boolean(void * ctx, int booleanValue);
+
+/* names of the json types, indexed by AJV_JSON_INDEX */
+static const char * ajv_json_type_names[AJV_JSON_TYPES] = {
+  "null", "string", "boolean", "integer", "number", "object", "array"
+};
 
 #define AJV_STATE(x)                    \
   struct ajv_state_t *state = (struct ajv_state_t *) x; 
 
 #define FAIL_TYPE_MISMATCH(s, node, type) do {                  \
-    ajv_set_error(s,ajv_e_type_mismatch,                        \
-                  node, orderly_node_type_to_string(type),      \
-                  strlen(orderly_node_type_to_string(type)));   \
+    ajv_set_error_name(s,ajv_e_type_mismatch,                   \
+                       node, orderly_node_type_to_string(type)); \
                   return 0; } while (0);                        \
 
 
 #define FAIL_REGEX_NOMATCH(s, node,regex) do {                   \
-    ajv_set_error(s,ajv_e_regex_failed,                          \
-                  node, regex, strlen(regex));                   \
+    ajv_set_error_name(s,ajv_e_regex_failed, node, regex);       \
     return 0; } while (0);                                       \
 
 
@@ -129,25 +125,20 @@ int ick_strcmp(const char *a, const char *b, unsigned int blen);
       return 0;} while (0);
 
 #define FAIL_OUT_OF_RANGE(s,n,d) do {                           \
-    char buf[128];                                              \
-    snprintf(buf,128,"%.15g",d);                                 \
-    ajv_set_error(s, ajv_e_out_of_range, n, buf,strlen(buf));   \
+    ajv_set_error_double(s, ajv_e_out_of_range, n, d);          \
     return 0;} while (0);
 
-#define FAIL_UNEXPECTED_KEY(s,n,k,kl) do {                      \
-    ajv_set_error(s,ajv_e_unexpected_key,n,(const char *)k,kl); \
-    return 0;} while (0);
 
-#define FAIL_MISSING_ELEMENT(s,n,k) do {             \
-    ajv_set_error(s,ajv_e_incomplete_container,n,k,strlen(k));  \
-    return 0;} while (0);
-  
-#define DO_TYPECHECK(st, t, n) do {                                     \
-    const ajv_node *tcn;                                                      \
-    if (!(tcn = ajv_do_typecheck(st,t,n))) return 0;                    \
-    n = tcn;                                                            \
-    on = tcn->node;                                                     \
-  } while(0);                                                           \
+/* inside a subtree that isn't being validated, see ajv_skip_opened */
+#define AJV_SKIPPING(s) ((s)->depth > 0)
+
+/* validate a scalar.  when collecting errors a value that fails still
+ * counts as seen, and we carry on with the next */
+#define AJV_CHECK_SCALAR(check)                                 \
+  if (!AJV_SKIPPING(state)) {                                   \
+    if (!(check) && !ajv_state_keep_going(state)) return 0;     \
+    ajv_state_mark_seen(state, state->node);                    \
+  }                                                             \
 
 #define AJV_SUFFIX(type,...)                                    \
   if (state->cb && state->cb->yajl_##type) {                    \
@@ -164,28 +155,30 @@ int ick_strcmp(const char *a, const char *b, unsigned int blen);
   }                                                             \
 
 
-static const ajv_node *
-ajv_do_typecheck(ajv_state state, orderly_node_type t, const ajv_node *node) {
-  const ajv_node * typecheck = node;                       
-  if (state->error.code != ajv_e_no_error) {
+/* resolve the schema node for a value of json type t, leaving it in
+ * state->node */
+static int ajv_do_typecheck(ajv_state state, orderly_json_type t) {
+  const ajv_node * typecheck;
+  if (!ajv_state_keep_going(state)) {
     assert("got a yajl callback while in an error state" == 0);
     /* NORETURN */
   }
   
   if (ajv_state_finished(state)) { 
     ajv_set_error(state, ajv_e_trailing_input, NULL, NULL, 0);
+    return 0;
   }
-  
-  typecheck = orderly_subsumed_by(t, typecheck);
+
+  typecheck = state->node->dispatch[AJV_JSON_INDEX(t)];
   
   if (! typecheck ) { 
-    ajv_set_error(state,ajv_e_type_mismatch,node,
-                  orderly_node_type_to_string(t),      
-                  strlen(orderly_node_type_to_string(t)));   
-    return NULL;
+    ajv_set_error_name(state,ajv_e_type_mismatch,state->node,
+                       ajv_json_type_names[AJV_JSON_INDEX(t)]);
+    return 0;
   }
 
-  return typecheck;
+  state->node = typecheck;
+  return 1;
 }
 
 const yajl_callbacks ajv_callbacks = {
@@ -217,6 +210,189 @@ const yajl_callbacks ajv_passthrough = {
   pass_ajv_end_array
 };
 
+/* the same, running the schema's program rather than walking its tree */
+const yajl_callbacks ajv_program_callbacks = {
+  prog_ajv_null,
+  prog_ajv_boolean, 
+  prog_ajv_integer, 
+  prog_ajv_double, 
+  NULL,
+  prog_ajv_string,
+  prog_ajv_start_map,
+  prog_ajv_map_key,
+  prog_ajv_end_map,
+  prog_ajv_start_array,
+  prog_ajv_end_array
+};
+
+/* the callbacks inside a container we aren't validating, when nobody
+ * downstream is listening.  with no scalar or key callbacks, yajl
+ * neither converts numbers nor decodes strings, and we see nothing but
+ * the nesting, until the container closes */
+static const yajl_callbacks ajv_skip = {
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+  skip_ajv_open,
+  NULL,
+  skip_ajv_close,
+  skip_ajv_open,
+  skip_ajv_close
+};
+
+/* the callbacks while a container is being matched against an enum,
+ * see ajv_enum_opened */
+static const yajl_callbacks ajv_enum_tee = {
+  tee_ajv_null,
+  tee_ajv_boolean,
+  tee_ajv_integer,
+  tee_ajv_double,
+  NULL,
+  tee_ajv_string,
+  tee_ajv_start_map,
+  tee_ajv_map_key,
+  tee_ajv_end_map,
+  tee_ajv_start_array,
+  tee_ajv_end_array
+};
+
+/* entering a container whose contents aren't validated: one validated
+ * as any or, when collecting errors, one that has already failed.
+ * skip its contents if we can, which we can't while they're being
+ * matched against an enum */
+static void ajv_skip_opened(ajv_state state) {
+  state->depth++;
+  if (!state->cb && state->depth == 1
+      && !ajv_enum_matching(&(state->enums))) {
+    memcpy(&state->ourcb, &ajv_skip, sizeof(yajl_callbacks));
+  }
+}
+
+static int skip_ajv_open(void * ctx) {
+  AJV_STATE(ctx);
+  state->depth++;
+  return 1;
+}
+
+static int skip_ajv_close(void * ctx) {
+  AJV_STATE(ctx);
+  if (--state->depth == 0) {
+    if (state->useprogram) ajv_vm_mark_seen(state, state->pc);
+    else ajv_state_mark_seen(state, state->node);
+    memcpy(&state->ourcb, state->validator, sizeof(yajl_callbacks));
+  }
+  return 1;
+}
+
+/* a container of json type t is opening against node, whose
+ * enumerated values it must be one of.  if they're all scalars, it
+ * isn't, otherwise its events are handed to the matcher, and from there
+ * on to the validator, until it closes.  when matching is already under
+ * way, the tee hands its start to the matcher once we return */
+static int ajv_enum_opened(ajv_state state, const ajv_node *node,
+                           ajv_enum e, orderly_json_type t) {
+  int first = !ajv_enum_matching(&(state->enums));
+  if (!ajv_enum_has_containers(e)) {
+    ajv_set_error_name(state, ajv_e_illegal_value, node,
+                       ajv_json_type_names[AJV_JSON_INDEX(t)]);
+    return 0;
+  }
+  ajv_enum_match(&(state->enums), e, node);
+  if (first) {
+    if (t == orderly_json_object) {
+      ajv_enum_callbacks.yajl_start_map(&(state->enums));
+    } else {
+      ajv_enum_callbacks.yajl_start_array(&(state->enums));
+    }
+    memcpy(&state->ourcb, &ajv_enum_tee, sizeof(yajl_callbacks));
+  }
+  return 1;
+}
+
+/* a container being matched, of json type t, has closed.  once the
+ * last has, the validator has the events to itself again */
+static int ajv_enum_closed(ajv_state state, orderly_json_type t) {
+  const ajv_node *node = ajv_enum_end(&(state->enums));
+  if (!ajv_enum_matching(&(state->enums))) {
+    memcpy(&state->ourcb, state->validator, sizeof(yajl_callbacks));
+  }
+  if (node) {
+    ajv_set_error_name(state, ajv_e_illegal_value, node,
+                       ajv_json_type_names[AJV_JSON_INDEX(t)]);
+    return ajv_state_keep_going(state);
+  }
+  return 1;
+}
+
+static int tee_ajv_null(void * ctx) {
+  AJV_STATE(ctx);
+  ajv_enum_callbacks.yajl_null(&(state->enums));
+  return state->validator->yajl_null(ctx);
+}
+
+static int tee_ajv_boolean(void * ctx, int booleanValue) {
+  AJV_STATE(ctx);
+  ajv_enum_callbacks.yajl_boolean(&(state->enums), booleanValue);
+  return state->validator->yajl_boolean(ctx, booleanValue);
+}
+
+static int tee_ajv_integer(void * ctx, long integerValue) {
+  AJV_STATE(ctx);
+  ajv_enum_callbacks.yajl_integer(&(state->enums), integerValue);
+  return state->validator->yajl_integer(ctx, integerValue);
+}
+
+static int tee_ajv_double(void * ctx, double doubleval) {
+  AJV_STATE(ctx);
+  ajv_enum_callbacks.yajl_double(&(state->enums), doubleval);
+  return state->validator->yajl_double(ctx, doubleval);
+}
+
+static int tee_ajv_string(void * ctx, const unsigned char * stringVal,
+                          unsigned int stringLen) {
+  AJV_STATE(ctx);
+  ajv_enum_callbacks.yajl_string(&(state->enums), stringVal, stringLen);
+  return state->validator->yajl_string(ctx, stringVal, stringLen);
+}
+
+static int tee_ajv_map_key(void * ctx, const unsigned char * key, 
+                           unsigned int stringLen) {
+  AJV_STATE(ctx);
+  ajv_enum_callbacks.yajl_map_key(&(state->enums), key, stringLen);
+  return state->validator->yajl_map_key(ctx, key, stringLen);
+}
+
+/* the validator opens first, so that the container is matched too if
+ * it has enumerated values of its own */
+static int tee_ajv_start_map(void * ctx) {
+  AJV_STATE(ctx);
+  if (!state->validator->yajl_start_map(ctx)) return 0;
+  ajv_enum_callbacks.yajl_start_map(&(state->enums));
+  return 1;
+}
+
+static int tee_ajv_start_array(void * ctx) {
+  AJV_STATE(ctx);
+  if (!state->validator->yajl_start_array(ctx)) return 0;
+  ajv_enum_callbacks.yajl_start_array(&(state->enums));
+  return 1;
+}
+
+static int tee_ajv_end_map(void * ctx) {
+  AJV_STATE(ctx);
+  if (!ajv_enum_closed(state, orderly_json_object)) return 0;
+  return state->validator->yajl_end_map(ctx);
+}
+
+static int tee_ajv_end_array(void * ctx) {
+  AJV_STATE(ctx);
+  if (!ajv_enum_closed(state, orderly_json_array)) return 0;
+  return state->validator->yajl_end_array(ctx);
+}
+
 static int pass_ajv_null(void * ctx) {
   AJV_STATE(ctx);
   AJV_SUFFIX_NOARGS(null);
@@ -262,62 +438,42 @@ static int pass_ajv_map_key(void * ctx, const unsigned char * key,
 }
 
 
+static int ajv_check_null(ajv_state state) {
+  return ajv_do_typecheck(state, orderly_json_null);
+}
+
 static int ajv_null(void * ctx) {
   AJV_STATE(ctx);
-  const orderly_node *on;
-  DO_TYPECHECK(state,orderly_node_null, state->node);
-
-
-  if (on->t == orderly_node_any) {
-    if (state->depth == 0) { ajv_state_mark_seen(state, state->node); }
-  } else {
-    ajv_state_mark_seen(state, state->node);
-  }
-
+  AJV_CHECK_SCALAR(ajv_check_null(state));
   AJV_SUFFIX_NOARGS(null);
 }
 
 
-static int ajv_boolean(void * ctx, int booleanValue) {
-  AJV_STATE(ctx);
-  const orderly_node *on;
-  DO_TYPECHECK(state,orderly_node_boolean, state->node);
+static int ajv_check_boolean(ajv_state state, int booleanValue) {
+  if (!ajv_do_typecheck(state, orderly_json_boolean)) return 0;
 
-  if (on->t == orderly_node_any) {
-    if (state->depth == 0) {  ajv_state_mark_seen(state, state->node); }
-  } else {
-    ajv_state_mark_seen(state, state->node);
-  }
-  if (on->values) {
-    orderly_json *cur;
-    int found = 0;
-    assert(on->values->t == orderly_json_array); /* docs say so */
-    for (cur = on->values->v.children.first; cur ; cur = cur->next) {
-      if (cur->t == orderly_json_boolean) {
-        if (cur->v.b == booleanValue) {
-          found = 1;
-        }
-      }
-    }
-    if (found == 0) {
-      FAIL_NOT_IN_LIST(state,state->node,
-                       booleanValue ? "true" : "false",
-                       booleanValue ? 4 : 5);
+  if (state->node->values) {
+    if (!ajv_enum_has_boolean(state->node->values, booleanValue)) {
+      ajv_set_error_name(state, ajv_e_illegal_value, state->node,
+                         booleanValue ? "true" : "false");
+      return 0;
     }
   }
+  return 1;
+}
 
+static int ajv_boolean(void * ctx, int booleanValue) {
+  AJV_STATE(ctx);
+  AJV_CHECK_SCALAR(ajv_check_boolean(state, booleanValue));
   AJV_SUFFIX(boolean,booleanValue);
 }
 
-static int ajv_double(void * ctx, double doubleval) {
-  AJV_STATE(ctx);
-  const orderly_node *on = state->node->node;
-  DO_TYPECHECK(state, orderly_node_number, state->node);
+static int ajv_check_double(ajv_state state, double doubleval) {
+  const orderly_node *on;
+  if (!ajv_do_typecheck(state, orderly_json_number)) return 0;
+  on = state->node->node;
 
-  if (on->t == orderly_node_any) {
-    if (state->depth == 0) { ajv_state_mark_seen(state, state->node); }
-  } else {
-  
+  if (on->t != orderly_node_any) {
     if (on->t != orderly_node_number) {
       FAIL_TYPE_MISMATCH(state,state->node, orderly_node_number);
     }
@@ -338,98 +494,74 @@ static int ajv_double(void * ctx, double doubleval) {
         }
       }
     }
-    ajv_state_mark_seen(state, state->node);
-    
   }
-  if (on->values) {
-    orderly_json *cur;
-    int found = 0;
-    assert(on->values->t == orderly_json_array); /* docs say so */
-    for (cur = on->values->v.children.first; cur ; cur = cur->next) {
-      if (cur->t == orderly_json_number) {
-        if (doubleval == cur->v.n) {
-          found = 1;
-        }
-      } else if (cur->t == orderly_json_integer) {
-        if (doubleval == (double)cur->v.i) {
-          found = 1;
-        }
-      }
-    }
-    if (found == 0) {
-      char doublestr[128];
-      snprintf(doublestr,128,"%.15g",doubleval);
-      FAIL_NOT_IN_LIST(state,state->node,doublestr,strlen(doublestr)); 
+  if (state->node->values) {
+    if (!ajv_enum_has_double(state->node->values, doubleval)) {
+      ajv_set_error_double(state, ajv_e_illegal_value, state->node,
+                           doubleval);
+      return 0;
     }
   }
-  
-  AJV_SUFFIX(double,doubleval);
+  return 1;
 }
 
-static int ajv_integer(void * ctx, long integerValue) {
+static int ajv_double(void * ctx, double doubleval) {
   AJV_STATE(ctx);
-  const orderly_node *on = state->node->node;
-  DO_TYPECHECK(state,orderly_node_integer, state->node);
+  AJV_CHECK_SCALAR(ajv_check_double(state, doubleval));
+  AJV_SUFFIX(double,doubleval);
+}
 
-  if (on->t == orderly_node_any) {
-    if (state->depth == 0) {  ajv_state_mark_seen(state, state->node); }
-  } else {
-    ajv_state_mark_seen(state, state->node);
+static int ajv_check_integer(ajv_state state, long integerValue) {
+  if (!ajv_do_typecheck(state, orderly_json_integer)) return 0;
+
+  if (state->node->node->t != orderly_node_any) {
     if (!ajv_check_integer_range(state,state->node,integerValue)) {
       return 0;
     }
   }
-  if (on->values) {
-    orderly_json *cur;
-    int found = 0;
-    assert(on->values->t == orderly_json_array); /* docs say so */
-    for (cur = on->values->v.children.first; cur ; cur = cur->next) {
-      if (cur->t == orderly_json_integer) {
-        if (integerValue == cur->v.i) {
-          found = 1;
-          break;
-        }
-      } else {
-        if ((double)integerValue == cur->v.n) {
-          found = 1;
-          break;
-        }
-      }
-    }
-    if (found == 0) {
-      char buf[128];
-      snprintf(buf,128,"%ld",integerValue);
-      FAIL_NOT_IN_LIST(state,state->node,buf,strlen(buf));
+  if (state->node->values) {
+    if (!ajv_enum_has_integer(state->node->values, integerValue)) {
+      ajv_set_error_integer(state, ajv_e_illegal_value, state->node,
+                            integerValue);
+      return 0;
     }
   }
+  return 1;
+}
 
+static int ajv_integer(void * ctx, long integerValue) {
+  AJV_STATE(ctx);
+  AJV_CHECK_SCALAR(ajv_check_integer(state, integerValue));
   AJV_SUFFIX(integer,integerValue);
 }
 
 
-int ick_strcmp(const char *a, const char *b, unsigned int blen) {
-  while (*a) {
-    if (blen == 0) { break; }
-    if (*a != *b) { return 1; }
-    a++; b++; blen--;
+/* simple patterns run on their dfa.  patterns studied into JIT code
+ * run on the handle's own JIT stack */
+static int ajv_regex_exec(ajv_state state, const ajv_regex *rx,
+                          const char *s, unsigned int len) {
+  if (rx->dfa) {
+    return ajv_dfa_match(rx->dfa, (const unsigned char *) s, len)
+      ? 0 : PCRE_ERROR_NOMATCH;
   }
-  if (*a != '\0' || blen != 0) { return 1; }
-  return 0;
+#ifdef AJV_PCRE_JIT
+  if (rx->jit) {
+    return pcre_jit_exec(rx->re, rx->extra, s, len, 0, 0, NULL, 0,
+                         state->jitstack);
+  }
+#else
+  (void) state;
+#endif
+  return pcre_exec(rx->re, rx->extra, s, len, 0, 0, NULL, 0);
 }
 
-/** strings are returned as pointers into the JSON text when,
- * possible, as a result, they are _not_ null padded */
-static int ajv_string(void * ctx, const unsigned char * stringVal,
-                unsigned int stringLen) {
-  AJV_STATE(ctx);
-  const orderly_node *on = state->node->node;
-  DO_TYPECHECK(state,orderly_node_string, state->node);
-
+static int ajv_check_string(ajv_state state, const unsigned char * stringVal,
+                            unsigned int stringLen) {
+  const orderly_node *on;
+  if (!ajv_do_typecheck(state, orderly_json_string)) return 0;
+  on = state->node->node;
 
-  if (on->t == orderly_node_any) {
-    if (state->depth == 0)  { ajv_state_mark_seen(state, state->node); }
-  } else {
-    ajv_state_mark_seen(state, state->node);
+  if (on->t != orderly_node_any) {
     if (on->t != orderly_node_string) {
       FAIL_TYPE_MISMATCH(state,state->node,orderly_node_string);
     }
@@ -437,10 +569,10 @@ static int ajv_string(void * ctx, const unsigned char * stringVal,
       return 0;
     }
     
-    if (state->node->regcomp) {
+    if (state->node->regex) {
       int pcrecode;
-      pcrecode = pcre_exec(state->node->regcomp,NULL,
-                           (char *)stringVal,stringLen,0,0,NULL,0);
+      pcrecode = ajv_regex_exec(state, state->node->regex,
+                                (const char *)stringVal, stringLen);
       if (pcrecode < 0) {
         if (pcrecode == PCRE_ERROR_NOMATCH) {
           FAIL_REGEX_NOMATCH(state,state->node,on->regex);
@@ -454,74 +586,73 @@ static int ajv_string(void * ctx, const unsigned char * stringVal,
         return 0;
       }
     }
-
   }
   
-  if (on->values) {
-    orderly_json *cur;
-    int found = 0;
-    assert(on->values->t == orderly_json_array); /* docs say so */
-    for (cur = on->values->v.children.first; cur ; cur = cur->next) {
-      if (cur->t == orderly_json_string) {
-        if (!ick_strcmp(cur->v.s, (const char *)stringVal, stringLen)) {
-          found = 1;
-        }
-      }
-    }
-    if (found == 0) {
+  if (state->node->values) {
+    if (!ajv_enum_has_string(state->node->values, (const char *)stringVal,
+                             stringLen)) {
       FAIL_NOT_IN_LIST(state,state->node, (const char *)stringVal,stringLen);
     }
   }
+  return 1;
+}
 
-
+/** strings are returned as pointers into the JSON text when,
+ * possible, as a result, they are _not_ null padded */
+static int ajv_string(void * ctx, const unsigned char * stringVal,
+                unsigned int stringLen) {
+  AJV_STATE(ctx);
+  AJV_CHECK_SCALAR(ajv_check_string(state, stringVal, stringLen));
   AJV_SUFFIX(string,stringVal,stringLen);
 }
 
+/* open a container, or skip it */
+static int ajv_open(ajv_state state, orderly_json_type t) {
+  if (AJV_SKIPPING(state)) {
+    state->depth++;
+  } else if (!ajv_do_typecheck(state, t)
+             || (state->node->values
+                 && !ajv_enum_opened(state, state->node,
+                                     state->node->values, t))) {
+    if (!ajv_state_keep_going(state)) return 0;
+    ajv_skip_opened(state);
+  } else if (state->node->node->t == orderly_node_any) {
+    ajv_skip_opened(state);
+  } else {
+    ajv_state_push(state,state->node);
+  }
+  return 1;
+}
 
-static int ajv_start_array(void * ctx) {
-   AJV_STATE(ctx);
-   const orderly_node *on = state->node->node;
-   DO_TYPECHECK(state,orderly_node_array, state->node);
-
-   if (on->t == orderly_node_any) {
-     state->depth++;
-   } else {
-     ajv_state_push(state,state->node);
-   }
+/* close a skipped container, false if we weren't skipping */
+static int ajv_close_skipped(ajv_state state) {
+  if (!AJV_SKIPPING(state)) return 0;
+  if (--state->depth == 0) ajv_state_mark_seen(state, state->node);
+  return 1;
+}
 
-   AJV_SUFFIX_NOARGS(start_array);
- }
+static int ajv_start_array(void * ctx) {
+  AJV_STATE(ctx);
+  if (!ajv_open(state, orderly_json_array)) return 0;
+  AJV_SUFFIX_NOARGS(start_array);
+}
 
 
- static int ajv_end_array(void * ctx) {
-   AJV_STATE(ctx);
-   const orderly_node *on = state->node ? state->node->node : NULL;
-   if (on && on->t == orderly_node_any && state->depth > 0) {
-     state->depth--;
-     if (state->depth == 0 ) { ajv_state_mark_seen(state, state->node); }
-   } else {
-     if (!ajv_state_array_complete(state)) {
-       return 0;
-     }
-     ajv_state_mark_seen(state, state->node);
-   }   
-   AJV_SUFFIX_NOARGS(end_array);
- }
+static int ajv_end_array(void * ctx) {
+  AJV_STATE(ctx);
+  if (!ajv_close_skipped(state)) {
+    if (!ajv_state_array_complete(state)) {
+      return 0;
+    }
+    ajv_state_mark_seen(state, state->node);
+  }   
+  AJV_SUFFIX_NOARGS(end_array);
+}
 
 
 static int ajv_start_map (void * ctx) {
   AJV_STATE(ctx);
-  const orderly_node *on;
-  DO_TYPECHECK(state, orderly_node_object, state->node);
-
-  on = state->node->node;
-
-  if (on->t == orderly_node_any) {
-    state->depth++;
-  }  else {
-    ajv_state_push(state,state->node);
-  }
-
+  if (!ajv_open(state, orderly_json_object)) return 0;
   AJV_SUFFIX_NOARGS(start_map);
 }
 
@@ -530,36 +661,35 @@ static int ajv_map_key(void * ctx, const unsigned char * key,
                        unsigned int stringLen) {
   AJV_STATE(ctx);
   ajv_node *cur;
-  if (state->node && state->node->node->t == orderly_node_any
-      && state->depth != 0) {
-    /* skip straight to return section */ 
-  } else {
+  if (!AJV_SKIPPING(state)) {
     const char *this_is_utf8_dont_do_math = (const char *)key;
     cur = ajv_find_key(ajv_state_parent(state), this_is_utf8_dont_do_math,
                        stringLen);
+    if (cur) {
+      ajv_node_state f = ajv_state_frame(state);
+      f->key = cur;
+      f->keylen = 0;
+    } else {
+      ajv_state_key(state, key, stringLen);
+    }
 
     if ( cur ){
       state->node = cur;
-      if (cur->node->requires) {
-        const char **n;
-        for (n = cur->node->requires; *n; n++) {
-          ajv_node *req = ajv_find_key(ajv_state_parent(state), 
-                                       *n,
-                                       strlen(*n));
-          ajv_state_require(state,req);
-        }
+      if (cur->requires) {
+        ajv_state_require(state,cur);
       }
     } else {
       if ( ajv_state_parent(state)->node->additional_properties == orderly_node_empty )  {
         /* we found a key which we don't have an associated schema for
          * if the object forbids this, throw an error */
-        FAIL_UNEXPECTED_KEY(state, ajv_state_parent(state), key,stringLen);
+        ajv_set_error(state,ajv_e_unexpected_key,ajv_state_parent(state),
+                      (const char *)key,stringLen);
+        if (!ajv_state_keep_going(state)) return 0;
+        /* and check its value against nothing at all */
+        state->node = state->s->opaque;
       } else {  
-        /* otherwise, put us into schemaless mode */
-        ((orderly_node *)(state->any.node))->t = ajv_state_parent(state)->node->additional_properties; 
-        state->depth = 0;
-        state->any.parent = ajv_state_parent(state);
-        state->node = &(state->any);
+        /* otherwise, check the value against additional properties */
+        state->node = ajv_state_parent(state)->additional;
       }
     }
   }
@@ -570,15 +700,273 @@ static int ajv_map_key(void * ctx, const unsigned char * key,
 static int ajv_end_map(void * ctx) {
   AJV_STATE(ctx);
 
-  if (state->node && state->node->node->t == orderly_node_any
-      && state->depth > 0) {
-    state->depth--;
-    if (state->depth == 0) { ajv_state_mark_seen(state, state->node); }
-  } else {
+  if (!ajv_close_skipped(state)) {
     if (!ajv_state_map_complete(state,ajv_state_parent(state))) {
       return 0;
     }
   }
   AJV_SUFFIX_NOARGS(end_map);
 }
-        
+
+/* the callbacks again, for the program.  each mirrors its counterpart
+ * above, keeping its place in state->pc rather than state->node */
+
+static int prog_ajv_typecheck(ajv_state state, orderly_json_type t) {
+  unsigned int pc;
+  if (!ajv_state_keep_going(state)) {
+    assert("got a yajl callback while in an error state" == 0);
+    /* NORETURN */
+  }
+
+  if (ajv_state_finished(state)) { 
+    ajv_set_error(state, ajv_e_trailing_input, NULL, NULL, 0);
+    return 0;
+  }
+
+  pc = state->insns[state->pc].dispatch[AJV_JSON_INDEX(t)];
+
+  if (pc == AJV_PC_NONE) {
+    ajv_set_error_name(state,ajv_e_type_mismatch,
+                       state->insns[state->pc].node,
+                       ajv_json_type_names[AJV_JSON_INDEX(t)]);
+    return 0;
+  }
+
+  state->pc = pc;
+  return 1;
+}
+
+#define PROG_CHECK_SCALAR(check)                                \
+  if (!AJV_SKIPPING(state)) {                                   \
+    if (!(check) && !ajv_state_keep_going(state)) return 0;     \
+    ajv_vm_mark_seen(state, state->pc);                         \
+  }                                                             \
+
+static int prog_ajv_null(void * ctx) {
+  AJV_STATE(ctx);
+  PROG_CHECK_SCALAR(prog_ajv_typecheck(state, orderly_json_null));
+  AJV_SUFFIX_NOARGS(null);
+}
+
+static int prog_check_boolean(ajv_state state, int booleanValue) {
+  const ajv_insn *in;
+  if (!prog_ajv_typecheck(state, orderly_json_boolean)) return 0;
+  in = &(state->insns[state->pc]);
+
+  if (in->ops & AJV_OP_ENUM) {
+    if (!ajv_enum_has_boolean(in->values, booleanValue)) {
+      ajv_set_error_name(state, ajv_e_illegal_value, in->node,
+                         booleanValue ? "true" : "false");
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int prog_ajv_boolean(void * ctx, int booleanValue) {
+  AJV_STATE(ctx);
+  PROG_CHECK_SCALAR(prog_check_boolean(state, booleanValue));
+  AJV_SUFFIX(boolean,booleanValue);
+}
+
+static int prog_check_double(ajv_state state, double doubleval) {
+  const ajv_insn *in;
+  if (!prog_ajv_typecheck(state, orderly_json_number)) return 0;
+  in = &(state->insns[state->pc]);
+
+  if (in->t != orderly_node_any) {
+    if (in->t != orderly_node_number) {
+      FAIL_TYPE_MISMATCH(state,in->node, orderly_node_number);
+    }
+    if (in->ops & AJV_OP_RANGE) {
+      orderly_range r = in->range;
+      if (ORDERLY_RANGE_HAS_LHS(r)) {
+        /* as ajv_double, which see */
+        if (((ORDERLY_RANGE_RHS_DOUBLE & r.info) 
+             ? r.lhs.d : (double)r.lhs.i) > doubleval) { 
+          FAIL_OUT_OF_RANGE(state,in->node,doubleval);
+        }
+      }
+      if (ORDERLY_RANGE_HAS_RHS(r)) {
+        if (((ORDERLY_RANGE_RHS_DOUBLE & r.info) 
+             ? r.rhs.d : (double)r.rhs.i) < doubleval) { 
+          FAIL_OUT_OF_RANGE(state,in->node,doubleval);
+        }
+      }
+    }
+  }
+  if (in->ops & AJV_OP_ENUM) {
+    if (!ajv_enum_has_double(in->values, doubleval)) {
+      ajv_set_error_double(state, ajv_e_illegal_value, in->node, doubleval);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int prog_ajv_double(void * ctx, double doubleval) {
+  AJV_STATE(ctx);
+  PROG_CHECK_SCALAR(prog_check_double(state, doubleval));
+  AJV_SUFFIX(double,doubleval);
+}
+
+static int prog_check_integer(ajv_state state, long integerValue) {
+  const ajv_insn *in;
+  if (!prog_ajv_typecheck(state, orderly_json_integer)) return 0;
+  in = &(state->insns[state->pc]);
+
+  if (in->t != orderly_node_any && (in->ops & AJV_OP_RANGE)) {
+    if (!ajv_check_range(state, &(in->range), in->node, integerValue)) {
+      return 0;
+    }
+  }
+  if (in->ops & AJV_OP_ENUM) {
+    if (!ajv_enum_has_integer(in->values, integerValue)) {
+      ajv_set_error_integer(state, ajv_e_illegal_value, in->node,
+                            integerValue);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int prog_ajv_integer(void * ctx, long integerValue) {
+  AJV_STATE(ctx);
+  PROG_CHECK_SCALAR(prog_check_integer(state, integerValue));
+  AJV_SUFFIX(integer,integerValue);
+}
+
+static int prog_check_string(ajv_state state, const unsigned char * stringVal,
+                             unsigned int stringLen) {
+  const ajv_insn *in;
+  if (!prog_ajv_typecheck(state, orderly_json_string)) return 0;
+  in = &(state->insns[state->pc]);
+
+  if (in->t != orderly_node_any) {
+    if (in->t != orderly_node_string) {
+      FAIL_TYPE_MISMATCH(state,in->node,orderly_node_string);
+    }
+    if (in->ops & AJV_OP_RANGE) {
+      if (!ajv_check_range(state, &(in->range), in->node, stringLen)) {
+        return 0;
+      }
+    }
+    if (in->ops & AJV_OP_REGEX) {
+      if (ajv_regex_exec(state, in->regex, (const char *)stringVal,
+                         stringLen) == PCRE_ERROR_NOMATCH) {
+        FAIL_REGEX_NOMATCH(state,in->node,in->node->node->regex);
+      }
+    }
+    if (in->ops & AJV_OP_FORMAT) {
+      if (!in->checker((const char *)stringVal,stringLen)) {
+        ajv_set_error(state, ajv_e_invalid_format, in->node, 
+                      (const char *)stringVal, stringLen);
+        return 0;
+      }
+    }
+  }
+
+  if (in->ops & AJV_OP_ENUM) {
+    if (!ajv_enum_has_string(in->values, (const char *)stringVal,
+                             stringLen)) {
+      FAIL_NOT_IN_LIST(state,in->node, (const char *)stringVal,stringLen);
+    }
+  }
+  return 1;
+}
+
+static int prog_ajv_string(void * ctx, const unsigned char * stringVal,
+                           unsigned int stringLen) {
+  AJV_STATE(ctx);
+  PROG_CHECK_SCALAR(prog_check_string(state, stringVal, stringLen));
+  AJV_SUFFIX(string,stringVal,stringLen);
+}
+
+static int prog_ajv_open(ajv_state state, orderly_json_type t) {
+  if (AJV_SKIPPING(state)) {
+    state->depth++;
+  } else if (!prog_ajv_typecheck(state, t)
+             || ((state->insns[state->pc].ops & AJV_OP_ENUM)
+                 && !ajv_enum_opened(state, state->insns[state->pc].node,
+                                     state->insns[state->pc].values, t))) {
+    if (!ajv_state_keep_going(state)) return 0;
+    ajv_skip_opened(state);
+  } else if (state->insns[state->pc].t == orderly_node_any) {
+    ajv_skip_opened(state);
+  } else {
+    ajv_vm_push(state, state->pc);
+  }
+  return 1;
+}
+
+static int prog_ajv_close_skipped(ajv_state state) {
+  if (!AJV_SKIPPING(state)) return 0;
+  if (--state->depth == 0) ajv_vm_mark_seen(state, state->pc);
+  return 1;
+}
+
+static int prog_ajv_start_array(void * ctx) {
+  AJV_STATE(ctx);
+  if (!prog_ajv_open(state, orderly_json_array)) return 0;
+  AJV_SUFFIX_NOARGS(start_array);
+}
+
+static int prog_ajv_end_array(void * ctx) {
+  AJV_STATE(ctx);
+  if (!prog_ajv_close_skipped(state)) {
+    if (!ajv_vm_array_complete(state)) {
+      return 0;
+    }
+    ajv_vm_mark_seen(state, state->pc);
+  }
+  AJV_SUFFIX_NOARGS(end_array);
+}
+
+static int prog_ajv_start_map (void * ctx) {
+  AJV_STATE(ctx);
+  if (!prog_ajv_open(state, orderly_json_object)) return 0;
+  AJV_SUFFIX_NOARGS(start_map);
+}
+
+static int prog_ajv_map_key(void * ctx, const unsigned char * key, 
+                            unsigned int stringLen) {
+  AJV_STATE(ctx);
+  if (!AJV_SKIPPING(state)) {
+    ajv_node_state f = ajv_state_frame(state);
+    const ajv_insn *map = &(state->insns[f->pc]);
+    unsigned int pc = ajv_program_find_key(state->program, map,
+                                           (const char *) key, stringLen);
+    if (pc != AJV_PC_NONE) {
+      const ajv_insn *prop = &(state->insns[pc]);
+      state->pc = pc;
+      f->key = prop->node;
+      f->keylen = 0;
+      if (prop->ops & AJV_OP_REQUIRES) {
+        ajv_vm_require(state, prop);
+      }
+    } else {
+      ajv_state_key(state, key, stringLen);
+      if (map->node->node->additional_properties == orderly_node_empty) {
+        ajv_set_error(state,ajv_e_unexpected_key,map->node,
+                      (const char *)key,stringLen);
+        if (!ajv_state_keep_going(state)) return 0;
+        state->pc = state->program->opaque;
+      } else {
+        state->pc = map->additional;
+      }
+    }
+  }
+
+  AJV_SUFFIX(map_key,key,stringLen);
+}
+
+static int prog_ajv_end_map(void * ctx) {
+  AJV_STATE(ctx);
+
+  if (!prog_ajv_close_skipped(state)) {
+    if (!ajv_vm_map_complete(state)) {
+      return 0;
+    }
+  }
+  AJV_SUFFIX_NOARGS(end_map);
+}
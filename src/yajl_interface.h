@@ -7,6 +7,7 @@ int orderly_synthesize_callbacks (const yajl_callbacks *cb,
   
 extern const yajl_callbacks ajv_callbacks;
 extern const yajl_callbacks ajv_passthrough;
+extern const yajl_callbacks ajv_program_callbacks;
 
 
 #endif
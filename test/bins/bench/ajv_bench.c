@@ -0,0 +1,514 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+/* a small throughput benchmark for the validator.  Each benchmark
+ * generates a schema and a matching instance document, then validates
+ * the document repeatedly and reports documents and megabytes per
+ * second.  With -p, handles come from an ajv_pool rather than being
+ * allocated and freed for every document. */
+
+#include <orderly/ajv_parse.h>
+#include <orderly/reader.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    char * schema;
+    char * doc;
+    /* is the document meant to fail? */
+    int invalid;
+    /* what the validator hands the document on to, if anything */
+    const yajl_callbacks * callbacks;
+} bench_input;
+
+/* an appendable, null terminated heap string */
+typedef struct {
+    char * s;
+    size_t len;
+    size_t cap;
+} bench_str;
+
+static void
+bs_append(bench_str * b, const char * fmt, ...)
+{
+    va_list ap;
+    int n;
+    for (;;) {
+        if (b->cap - b->len < 64) {
+            b->cap = b->cap ? b->cap * 2 : 1024;
+            b->s = (char *) realloc(b->s, b->cap);
+        }
+        va_start(ap, fmt);
+        n = vsnprintf(b->s + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && (size_t) n < b->cap - b->len) break;
+        b->cap *= 2;
+        b->s = (char *) realloc(b->s, b->cap);
+    }
+    b->len += n;
+}
+
+/* orderly property names may not contain digits, so spell out
+ * numbers with letters */
+static const char *
+bench_name(unsigned int i)
+{
+    static char buf[16];
+    unsigned int n = 0;
+    do {
+        buf[n++] = 'a' + (i % 26);
+        i /= 26;
+    } while (i);
+    buf[n] = 0;
+    return buf;
+}
+
+/* a single object with `size` properties, keys supplied in reverse order
+ * of their declaration */
+static bench_input
+gen_wide(unsigned int size)
+{
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i;
+
+    bs_append(&s, "object {\n");
+    for (i = 0; i < size; i++) {
+        bs_append(&s, "  %s prop%s;\n", (i & 1) ? "integer" : "string",
+                  bench_name(i));
+    }
+    bs_append(&s, "};\n");
+
+    bs_append(&d, "{");
+    for (i = size; i-- > 0; ) {
+        if (i & 1) bs_append(&d, "\"prop%s\":%u", bench_name(i), i);
+        else bs_append(&d, "\"prop%s\":\"value %u\"", bench_name(i), i);
+        if (i) bs_append(&d, ",");
+    }
+    bs_append(&d, "}");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 0;
+    in.callbacks = NULL;
+    return in;
+}
+
+/* an array of `size` values against a union of seven branches, the
+ * values cycling through the types of the branches, last ones first */
+static bench_input
+gen_union(unsigned int size)
+{
+    static const char * values[] = {
+        "[1,2]", "{\"a\":1}", "2.5", "12", "\"str\"", "true", "null"
+    };
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i;
+
+    bs_append(&s, "array [ union { null; boolean; string; integer; number;"
+                  " object {}*; array [ integer ]; }; ];\n");
+
+    bs_append(&d, "[");
+    for (i = 0; i < size; i++) {
+        bs_append(&d, "%s%s", i ? "," : "", values[i % 7]);
+    }
+    bs_append(&d, "]");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 0;
+    in.callbacks = NULL;
+    return in;
+}
+
+/* an array of `size` records whose strings are constrained by patterns
+ * typical of identifiers and timestamps */
+static bench_input
+gen_regex(unsigned int size)
+{
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i;
+
+    bs_append(&s, "array [ object {\n"
+                  "  string id /^[a-f0-9]{32}$/;\n"
+                  "  string parent /^[a-f0-9]{32}$/;\n"
+                  "  string created /^[0-9]{4}-[0-9]{2}-[0-9]{2}"
+                  "T[0-9]{2}:[0-9]{2}:[0-9]{2}Z$/;\n"
+                  "  string name /^[A-Za-z ]+$/;\n"
+                  "}; ];\n");
+
+    bs_append(&d, "[");
+    for (i = 0; i < size; i++) {
+        bs_append(&d, "%s{\"id\":\"%08x%08x%08x%08x\","
+                  "\"parent\":\"%032x\","
+                  "\"created\":\"2010-%02u-%02uT%02u:%02u:%02uZ\","
+                  "\"name\":\"Record %s\"}",
+                  i ? "," : "", i, i * 7, i * 13, i * 31, i / 2,
+                  i % 12 + 1, i % 28 + 1, i % 24, i % 60, i % 60,
+                  bench_name(i));
+    }
+    bs_append(&d, "]");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 0;
+    in.callbacks = NULL;
+    return in;
+}
+
+/* an array of 1000 records whose fields are drawn from enumerations of
+ * `size` strings and `size` sparse integers */
+static bench_input
+gen_enum(unsigned int size)
+{
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i, pick;
+
+    bs_append(&s, "array [ object {\n  string sku [");
+    for (i = 0; i < size; i++) {
+        bs_append(&s, "%s\"SKU-%s\"", i ? ", " : " ", bench_name(i));
+    }
+    bs_append(&s, " ];\n  integer code [");
+    for (i = 0; i < size; i++) {
+        bs_append(&s, "%s%u", i ? ", " : " ", i * 37);
+    }
+    bs_append(&s, " ];\n}; ];\n");
+
+    bs_append(&d, "[");
+    for (i = 0; i < 1000; i++) {
+        pick = (i * 7919) % size;
+        bs_append(&d, "%s{\"sku\":\"SKU-%s\",\"code\":%u}",
+                  i ? "," : "", bench_name(pick), pick * 37);
+    }
+    bs_append(&d, "]");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 0;
+    in.callbacks = NULL;
+    return in;
+}
+
+/* an array of 1000 points, each of which must be one of `size`
+ * enumerated objects, their members given in the reverse order */
+static bench_input
+gen_enum_objects(unsigned int size)
+{
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i, pick;
+
+    bs_append(&s, "array [ object {\n  string label;\n"
+                  "  array [ integer ] at;\n} [");
+    for (i = 0; i < size; i++) {
+        bs_append(&s, "%s{ \"label\": \"P-%s\", \"at\": [ %u, %u ] }",
+                  i ? ", " : " ", bench_name(i), i, i * 3);
+    }
+    bs_append(&s, " ]; ];\n");
+
+    bs_append(&d, "[");
+    for (i = 0; i < 1000; i++) {
+        pick = (i * 7919) % size;
+        bs_append(&d, "%s{\"at\":[%u,%u],\"label\":\"P-%s\"}",
+                  i ? "," : "", pick, pick * 3, bench_name(pick));
+    }
+    bs_append(&d, "]");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 0;
+    in.callbacks = NULL;
+    return in;
+}
+
+/* a record with a few typed fields around an opaque metadata blob of
+ * `size` entries, which the schema validates as any */
+static bench_input
+gen_opaque(unsigned int size)
+{
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i;
+
+    bs_append(&s, "object {\n  integer id;\n  string name;\n"
+                  "  any metadata;\n  boolean active;\n};\n");
+
+    bs_append(&d, "{\"id\":42,\"name\":\"opaque\",\"metadata\":{");
+    for (i = 0; i < size; i++) {
+        bs_append(&d, "%s\"key%u\":{\"n\":%u,\"f\":%u.25,"
+                  "\"s\":\"value \\\"%u\\\"\",\"l\":[true,null,%u]}",
+                  i ? "," : "", i, i, i, i, i * 3);
+    }
+    bs_append(&d, "},\"active\":true}");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 0;
+    in.callbacks = NULL;
+    return in;
+}
+
+/* a record of `size` fields whose last is out of range, so that every
+ * document is rejected */
+static bench_input
+gen_reject(unsigned int size)
+{
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i;
+
+    bs_append(&s, "object {\n");
+    for (i = 0; i < size; i++) {
+        bs_append(&s, "  integer {0,100} field%s;\n", bench_name(i));
+    }
+    bs_append(&s, "};\n");
+
+    bs_append(&d, "{");
+    for (i = 0; i < size; i++) {
+        bs_append(&d, "%s\"field%s\":%u", i ? "," : "", bench_name(i),
+                  i + 1 < size ? i % 100 : 1000 + i);
+    }
+    bs_append(&d, "}");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 1;
+    in.callbacks = NULL;
+    return in;
+}
+
+/* downstream callbacks which count the events they're handed */
+static int count_event(void * ctx)
+{
+    ++*(unsigned long *) ctx;
+    return 1;
+}
+
+static int count_boolean(void * ctx, int b)
+{
+    (void) b;
+    return count_event(ctx);
+}
+
+static int count_integer(void * ctx, long l)
+{
+    (void) l;
+    return count_event(ctx);
+}
+
+static int count_double(void * ctx, double d)
+{
+    (void) d;
+    return count_event(ctx);
+}
+
+static int count_string(void * ctx, const unsigned char * s, unsigned int l)
+{
+    (void) s;
+    (void) l;
+    return count_event(ctx);
+}
+
+static const yajl_callbacks counting_callbacks = {
+    count_event,
+    count_boolean,
+    count_integer,
+    count_double,
+    NULL,
+    count_string,
+    count_event,
+    count_string,
+    count_event,
+    count_event,
+    count_event
+};
+
+/* an array of `size` records which give only their id, leaving the
+ * validator to hand on defaults for the rest of their properties */
+static bench_input
+gen_defaults(unsigned int size)
+{
+    bench_str s = { NULL, 0, 0 }, d = { NULL, 0, 0 };
+    bench_input in;
+    unsigned int i;
+
+    bs_append(&s, "array [ object {\n"
+                  "  integer id;\n"
+                  "  string status = \"active\";\n"
+                  "  integer retries = 3;\n"
+                  "  object { string host; integer port; } server ="
+                  " { \"host\": \"localhost\", \"port\": 8080 };\n"
+                  "  array [ string ] tags = [ \"a\", \"b\", \"c\" ];\n"
+                  "}; ];\n");
+
+    bs_append(&d, "[");
+    for (i = 0; i < size; i++) {
+        bs_append(&d, "%s{\"id\":%u}", i ? "," : "", i);
+    }
+    bs_append(&d, "]");
+
+    in.schema = s.s;
+    in.doc = d.s;
+    in.invalid = 0;
+    in.callbacks = &counting_callbacks;
+    return in;
+}
+
+static const struct {
+    const char * name;
+    bench_input (*gen)(unsigned int size);
+    unsigned int defaultSize;
+} benchmarks[] = {
+    { "wide", gen_wide, 200 },
+    { "union", gen_union, 1000 },
+    { "regex", gen_regex, 100 },
+    { "enum", gen_enum, 1000 },
+    { "enum_objects", gen_enum_objects, 100 },
+    { "opaque", gen_opaque, 1000 },
+    { "reject", gen_reject, 10 },
+    { "defaults", gen_defaults, 1000 },
+    { NULL, NULL, 0 }
+};
+
+static void
+usage(const char * progname)
+{
+    unsigned int i;
+    fprintf(stderr, "usage: %s [-p] [-b] <benchmark> [size] [iterations]\n"
+                    "    -p take handles from a pool\n"
+                    "    -b run the schema's program rather than walk it\n"
+                    "benchmarks:", progname);
+    for (i = 0; benchmarks[i].name; i++) {
+        fprintf(stderr, " %s", benchmarks[i].name);
+    }
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+int
+main(int argc, char ** argv)
+{
+    unsigned int i, size, iterations = 10000, b;
+    bench_input in;
+    ajv_schema schema;
+    ajv_pool pool = NULL;
+    yajl_parser_config cfg = { 0, 1 };
+    double elapsed;
+    size_t doclen;
+    clock_t start;
+    char * progname = argv[0];
+    int useprogram = 0, usepool = 0;
+    unsigned long events = 0;
+
+    while (argc > 1 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-p")) {
+            usepool = 1;
+        } else if (!strcmp(argv[1], "-b")) {
+            useprogram = 1;
+        } else {
+            usage(progname);
+        }
+        argc--;
+        argv++;
+    }
+    if (argc < 2) usage(progname);
+    for (b = 0; benchmarks[b].name; b++) {
+        if (!strcmp(benchmarks[b].name, argv[1])) break;
+    }
+    if (!benchmarks[b].name) usage(progname);
+
+    size = argc > 2 ? (unsigned int) atoi(argv[2]) : benchmarks[b].defaultSize;
+    if (argc > 3) iterations = (unsigned int) atoi(argv[3]);
+
+    in = benchmarks[b].gen(size);
+    doclen = strlen(in.doc);
+    if (usepool) pool = ajv_pool_alloc(in.callbacks, &cfg, NULL);
+
+    {
+        orderly_reader r = orderly_reader_new(NULL);
+        orderly_node * n = orderly_reader_claim(
+            r, orderly_read(r, ORDERLY_UNKNOWN, in.schema, strlen(in.schema)));
+        if (!n) {
+            fprintf(stderr, "Schema is invalid: %s\n", orderly_get_error(r));
+            return 2;
+        }
+        schema = ajv_alloc_schema(NULL, n);
+        orderly_reader_free(&r);
+    }
+
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        ajv_handle hand = pool ? ajv_pool_get(pool, &events)
+                               : ajv_alloc(in.callbacks, &cfg, NULL, &events);
+        yajl_status stat;
+        ajv_use_program(hand, useprogram);
+        stat = ajv_parse_and_validate(
+            hand, (const unsigned char *) in.doc, doclen, schema);
+        if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {
+            stat = ajv_parse_complete(hand);
+        }
+        if ((stat != yajl_status_ok) != in.invalid) {
+            if (in.invalid) {
+                fprintf(stderr, "validation passed, but should have failed\n");
+            } else {
+                unsigned char * str = ajv_get_error(
+                    hand, 0, (const unsigned char *) in.doc, doclen);
+                fprintf(stderr, "validation failed: %s\n", (const char *) str);
+                ajv_free_error(hand, str);
+            }
+            ajv_free(hand);
+            return 1;
+        }
+        if (pool) ajv_pool_put(pool, hand);
+        else ajv_free(hand);
+    }
+    elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%s/%u: %u docs in %.3fs, %.0f docs/s, %.2f MB/s\n",
+           benchmarks[b].name, size, iterations, elapsed,
+           iterations / elapsed,
+           (doclen * (double) iterations) / (elapsed * 1024 * 1024));
+
+    if (pool) ajv_pool_free(pool);
+    ajv_free_schema(schema);
+    free(in.schema);
+    free(in.doc);
+
+    return 0;
+}
@@ -0,0 +1,448 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+/* reads json into orderly_json trees, both node by node from the heap
+ * and out of an arena, checks that they write back out as they were
+ * read, that indexing them finds what walking them does and that
+ * clones share what they can and that doubles are written in as few
+ * digits as read back, then reports how long each way takes to read
+ * and let go of a large document, how long finding things in one
+ * takes, how long copying one takes and how fast numbers are written */
+
+#include "../../../src/orderly_json.h"
+#include "../../../src/orderly_double.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* documents and how they're written back out */
+static const struct {
+    const char * doc;
+    const char * want;
+} roundtrips[] = {
+    { "null", "null" },
+    { "[ true, false, 7, 2.5, \"str\" ]", "[true,false,7,2.5,\"str\"]" },
+    { "{\"a\": {\"b\": [1, {\"c\": \"\"}]}, \"d\": {}}",
+      "{\"a\":{\"b\":[1,{\"c\":\"\"}]},\"d\":{}}" },
+    { "[0.1, 1e23, 5e-324, 1.7976931348623157e308, 2.2250738585072014e-308,"
+      " 0.333333333333333333, -0.0, 0.00001, 0.0001, 1e16, 1e17, 123456.0]",
+      "[0.1,1e+23,5e-324,1.7976931348623157e+308,2.2250738585072014e-308,"
+      "0.3333333333333333,-0,1e-05,0.0001,10000000000000000,1e+17,123456]" },
+    { NULL, NULL }
+};
+
+static unsigned int tests = 0, failed = 0;
+
+static void
+check(int ok, const char * what)
+{
+    printf("%s %u - %s\n", ok ? "ok" : "not ok", ++tests, what);
+    if (!ok) failed++;
+}
+
+/* does j write out as want? */
+static int
+writes_as(const orderly_json * j, const char * want)
+{
+    orderly_buf b = orderly_buf_alloc(&orderly_default_alloc_funcs);
+    int same;
+    if (!j) return 0;
+    orderly_write_json(&orderly_default_alloc_funcs, j, b, 0);
+    same = !strcmp((const char *) orderly_buf_data(b), want);
+    orderly_buf_free(b);
+    return same;
+}
+
+static orderly_json *
+read_json(orderly_alloc_funcs * af, orderly_arena arena, const char * doc)
+{
+    unsigned int len = strlen(doc);
+    return arena ? orderly_read_json_arena(af, arena, doc, &len)
+                 : orderly_read_json(af, doc, &len);
+}
+
+/* a string bigger than an arena chunk */
+static char *
+long_string_doc(size_t len)
+{
+    char * doc = (char *) malloc(len + 3);
+    doc[0] = '"';
+    memset(doc + 1, 'x', len);
+    doc[len + 1] = '"';
+    doc[len + 2] = 0;
+    return doc;
+}
+
+/* does looking things up in j, indexed or not, find what it should? */
+static int
+lookups_work(const orderly_json * j)
+{
+    const orderly_json * kid;
+    unsigned int i = 0;
+
+    for (kid = j->v.children.first; kid; kid = kid->next, i++) {
+        if (orderly_json_get(j, i) != kid) return 0;
+        if (kid->k && strcmp(kid->k, "dup")
+            && orderly_json_find(j, kid->k, strlen(kid->k)) != kid)
+        {
+            return 0;
+        }
+    }
+    if (orderly_json_count(j) != i || orderly_json_get(j, i)) return 0;
+    if (j->t == orderly_json_object) {
+        kid = orderly_json_find(j, "dup", 3);
+        if (!kid || kid->v.i != 1) return 0;
+        /* a key which is a prefix of another isn't it */
+        if (orderly_json_find(j, "k1", 1)) return 0;
+        if (orderly_json_find(j, "missing", 7)) return 0;
+    }
+    return 1;
+}
+
+/* a double from 64 random bits */
+static double
+random_double(void)
+{
+    unsigned long long bits = 0;
+    double d;
+    unsigned int i;
+    for (i = 0; i < 4; i++) bits = (bits << 16) ^ (rand() & 0xffff);
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+/* do n random doubles read back as themselves, bit for bit? */
+static int
+doubles_read_back(unsigned int n)
+{
+    char buf[ORDERLY_DOUBLE_BUFSIZE];
+    unsigned int i, len;
+    double d, back;
+
+    for (i = 0; i < n; i++) {
+        d = random_double();
+        if (d - d != 0) continue;
+        len = orderly_format_double(d, buf);
+        back = strtod(buf, NULL);
+        if (len != strlen(buf) || memcmp(&back, &d, sizeof(d))) return 0;
+    }
+    return 1;
+}
+
+static const char * indexed =
+    "{\"dup\": 1, \"k0\": 0, \"k1\": 1, \"k2\": 2, \"k3\": 3, \"k4\": 4,"
+    " \"k5\": 5, \"k6\": 6, \"k7\": 7, \"k8\": 8, \"k9\": 9, \"dup\": 2,"
+    " \"list\": [0, 1, 2, [3], {\"dup\": 1, \"a\": 4}]}";
+
+/* the time taken to read and free a document of records, over and over */
+static void
+report_speed(orderly_alloc_funcs * af)
+{
+    size_t cap = 1 << 22, len = 0;
+    char * doc = (char *) malloc(cap + 256);
+    orderly_arena arena = orderly_arena_alloc(af);
+    orderly_json * j;
+    unsigned int i, n = 0, iterations = 10;
+    double heap, arena_time;
+    clock_t start;
+
+    doc[len++] = '[';
+    while (len < cap) {
+        len += sprintf(doc + len, "%s{\"id\":%u,\"name\":\"record %u\","
+                       "\"score\":%u.5,\"tags\":[\"a\",\"b\",null,true]}",
+                       n ? "," : "", n, n, n);
+        n++;
+    }
+    doc[len++] = ']';
+    doc[len] = 0;
+
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        j = read_json(af, NULL, doc);
+        orderly_free_json(af, &j);
+    }
+    heap = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        j = read_json(af, arena, doc);
+        orderly_arena_reset(arena);
+    }
+    arena_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("# %u records, %lu bytes: read and freed at %.0f MB/s from the "
+           "heap, %.0f MB/s from an arena\n", n, (unsigned long) len,
+           (len * (double) iterations) / (heap * 1024 * 1024),
+           (len * (double) iterations) / (arena_time * 1024 * 1024));
+
+    /* random access to the records, walking them and indexed */
+    j = read_json(af, arena, doc);
+    start = clock();
+    for (i = 0; i < 200; i++) {
+        orderly_json_find(orderly_json_get(j, (i * 7919) % n), "tags", 4);
+    }
+    heap = (double) (clock() - start) / CLOCKS_PER_SEC;
+    orderly_json_index(af, arena, j);
+    start = clock();
+    for (i = 0; i < 200; i++) {
+        orderly_json_find(orderly_json_get(j, (i * 7919) % n), "tags", 4);
+    }
+    arena_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("# 200 lookups: %.3fms walking, %.3fms indexed\n",
+           heap * 1000, arena_time * 1000);
+
+    /* copying it all, and sharing it */
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        orderly_json * c = orderly_clone_json(af, j);
+        orderly_free_json(af, &c);
+    }
+    heap = (double) (clock() - start) / CLOCKS_PER_SEC;
+    orderly_arena_reset(arena);
+    j = read_json(af, NULL, doc);
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        orderly_json * c = orderly_clone_json(af, j);
+        orderly_free_json(af, &c);
+    }
+    arena_time = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("# cloning it: %.3fms copied, %.3fms shared\n",
+           heap * 1000 / iterations, arena_time * 1000 / iterations);
+    orderly_free_json(af, &j);
+
+    orderly_arena_free(arena);
+    free(doc);
+}
+
+/* the time taken to write out a document of doubles, and to format them
+ * with %.17g, the shortest printf that reads back */
+static void
+report_number_speed(orderly_alloc_funcs * af)
+{
+    const unsigned int count = 100000;
+    double * values = (double *) malloc(count * sizeof(double));
+    char * doc = (char *) malloc(count * 26 + 2);
+    char buf[32];
+    orderly_json * j;
+    orderly_buf b;
+    unsigned int i, len = 0;
+    double shortest, printed;
+    clock_t start;
+
+    /* half with many digits, half the sort people write */
+    for (i = 0; i < count; i++) {
+        do values[i] = random_double(); while (values[i] - values[i] != 0);
+        if (i & 1) values[i] = (rand() % 1000000) / 100.0;
+    }
+    doc[len++] = '[';
+    for (i = 0; i < count; i++) {
+        len += sprintf(doc + len, "%s%.17g", i ? "," : "", values[i]);
+    }
+    doc[len++] = ']';
+    doc[len] = 0;
+    j = read_json(af, NULL, doc);
+
+    b = orderly_buf_alloc(af);
+    start = clock();
+    orderly_write_json(af, j, b, 0);
+    shortest = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < count; i++) sprintf(buf, "%.17g", values[i]);
+    printed = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("# %u doubles: written in %.1fms as %lu bytes of json, "
+           "%.1fms formatting them with %%.17g as %u\n", count,
+           shortest * 1000, (unsigned long) orderly_buf_len(b),
+           printed * 1000, len);
+
+    orderly_buf_free(b);
+    orderly_free_json(af, &j);
+    free(doc);
+    free(values);
+}
+
+int
+main(void)
+{
+    orderly_alloc_funcs af;
+    orderly_arena arena;
+    orderly_json * j;
+    unsigned int i;
+    char * doc, * want;
+
+    orderly_set_default_alloc_funcs(&af);
+    arena = orderly_arena_alloc(&af);
+
+    for (i = 0; roundtrips[i].doc; i++) ;
+    printf("1..%u\n", 2 * i + 11);
+
+    for (i = 0; roundtrips[i].doc; i++) {
+        j = read_json(&af, NULL, roundtrips[i].doc);
+        check(writes_as(j, roundtrips[i].want), roundtrips[i].doc);
+        orderly_free_json(&af, &j);
+    }
+
+    /* one arena, reset between documents */
+    for (i = 0; roundtrips[i].doc; i++) {
+        j = read_json(&af, arena, roundtrips[i].doc);
+        check(writes_as(j, roundtrips[i].want), roundtrips[i].doc);
+        orderly_arena_reset(arena);
+    }
+
+    /* json bigger than a chunk, more than once */
+    doc = long_string_doc(100000);
+    want = long_string_doc(100000);
+    for (i = 0; i < 2; i++) {
+        j = read_json(&af, arena, doc);
+        check(writes_as(j, want), "a string bigger than a chunk");
+        orderly_arena_reset(arena);
+    }
+    free(doc);
+    free(want);
+    orderly_arena_free(arena);
+
+    /* objects big enough to hash and ones searched, and arrays, before
+     * and after they're indexed, from the heap and an arena */
+    for (i = 0; i < 2; i++) {
+        orderly_json * list;
+        int ok;
+        arena = i ? orderly_arena_alloc(&af) : NULL;
+        j = read_json(&af, arena, indexed);
+        list = orderly_json_find(j, "list", 4);
+        ok = lookups_work(j) && lookups_work(list)
+            && lookups_work(orderly_json_get(list, 4));
+        orderly_json_index(&af, arena, j);
+        ok = ok && j->v.children.mask && !list->v.children.mask
+            && orderly_json_get(list, 4)->v.children.items
+            && lookups_work(j) && lookups_work(list)
+            && lookups_work(orderly_json_get(list, 4));
+        check(ok, i ? "indexing json in an arena" : "indexing json");
+        if (arena) orderly_arena_free(arena);
+        else orderly_free_json(&af, &j);
+    }
+
+    /* a clone shares its value, and keeps it when the original goes */
+    {
+        orderly_json * c;
+        const char * want = roundtrips[2].want;
+        int ok;
+
+        j = read_json(&af, NULL, roundtrips[2].doc);
+        c = orderly_clone_json(&af, j);
+        ok = c->v.children.first == j->v.children.first
+            && writes_as(c, want);
+        orderly_free_json(&af, &j);
+        ok = ok && writes_as(c, want);
+        orderly_json_own(&af, c);
+        ok = ok && !c->refs && writes_as(c, want);
+        check(ok, "cloning json");
+        orderly_free_json(&af, &c);
+
+        /* changing one of them, once it's its own, leaves the other */
+        j = read_json(&af, NULL, roundtrips[2].doc);
+        c = orderly_clone_json(&af, j);
+        orderly_json_own(&af, c);
+        ok = c->v.children.first != j->v.children.first
+            && c->v.children.first->v.children.first
+               == j->v.children.first->v.children.first;
+        orderly_free_json(&af, &c->v.children.last);
+        c->v.children.first->next = NULL;
+        c->v.children.last = c->v.children.first;
+        ok = ok && writes_as(j, want)
+            && writes_as(c, "{\"a\":{\"b\":[1,{\"c\":\"\"}]}}");
+        check(ok, "changing a clone");
+        orderly_free_json(&af, &c);
+        orderly_free_json(&af, &j);
+
+        /* json in an arena is copied, so it can go with the arena */
+        arena = orderly_arena_alloc(&af);
+        j = read_json(&af, arena, roundtrips[2].doc);
+        c = orderly_clone_json(&af, j);
+        ok = c->v.children.first != j->v.children.first;
+        orderly_arena_free(arena);
+        check(ok && writes_as(c, want), "cloning json in an arena");
+        orderly_free_json(&af, &c);
+    }
+
+    /* owning indexed json drops the index, so that children can be
+     * added: json no one shares, a clone left by its original, and json
+     * in an arena */
+    for (i = 0; i < 3; i++) {
+        static const char * what[] = {
+            "adding to owned json", "adding to an owned clone",
+            "adding to owned json in an arena"
+        };
+        orderly_json * kid = orderly_alloc_json(&af, orderly_json_integer);
+        unsigned int n;
+        int ok;
+
+        arena = i == 2 ? orderly_arena_alloc(&af) : NULL;
+        j = read_json(&af, arena, indexed);
+        orderly_json_index(&af, arena, j);
+        if (i == 1) {
+            orderly_json * c = orderly_clone_json(&af, j);
+            orderly_free_json(&af, &j);
+            j = c;
+        }
+        n = orderly_json_count(j);
+        orderly_json_own(&af, j);
+        ok = !j->v.children.items && !j->v.children.count
+            && !j->v.children.mask;
+
+        BUF_STRDUP(kid->k, &af, "k10", 3);
+        kid->v.i = 10;
+        j->v.children.last->next = kid;
+        j->v.children.last = kid;
+        ok = ok && orderly_json_count(j) == n + 1
+            && orderly_json_get(j, n) == kid
+            && orderly_json_find(j, "k10", 3) == kid && lookups_work(j);
+        check(ok, what[i]);
+        if (arena) {
+            /* the member added isn't the arena's */
+            orderly_arena_free(arena);
+            orderly_free_json(&af, &kid);
+        } else {
+            orderly_free_json(&af, &j);
+        }
+    }
+
+    check(doubles_read_back(100000), "doubles read back as written");
+
+    report_speed(&af);
+    report_number_speed(&af);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+/* validates a generated array several gigabytes long, streamed through
+ * a single validating parser, and verifies that peak memory use doesn't
+ * grow with the length of the array.  then streams a long array matched
+ * against an enum, whose elements are matched against enums of their
+ * own, and verifies that the events kept to confirm them don't pile up. */
+
+#include <orderly/ajv_parse.h>
+#include <orderly/reader.h>
+#include "../../../src/ajv_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/* default document size in megabytes, and the peak RSS we'll accept in
+ * kilobytes */
+#define DEFAULT_DOC_MB 2048
+#define DEFAULT_RSS_CEILING_KB (16 * 1024)
+
+#define CHUNK_SIZE 65536
+
+static const char * schemaText =
+    "array [\n"
+    "  object {\n"
+    "    integer id;\n"
+    "    string name;\n"
+    "    array [ string ] tags;\n"
+    "  };\n"
+    "];\n";
+
+/* the elements are in their enum, the array can't be in its own */
+static const char * enumSchemaText =
+    "array [\n"
+    "  object {\n"
+    "    string kind;\n"
+    "    integer n;\n"
+    "  } [ { \"kind\": \"a\", \"n\": 1 }, { \"kind\": \"b\", \"n\": 2 } ];\n"
+    "] [ [] ];\n";
+
+/* elements, and the most the matcher's tape may hold for them */
+#define ENUM_RECORDS 200000
+#define ENUM_TAPE_CEILING 4096
+
+static ajv_schema
+readSchema(const char * text)
+{
+    orderly_reader r = orderly_reader_new(NULL);
+    orderly_node * n = orderly_reader_claim(
+        r, orderly_read(r, ORDERLY_UNKNOWN, text, strlen(text)));
+    ajv_schema schema = NULL;
+    if (n) schema = ajv_alloc_schema(NULL, n);
+    else printf("# schema is invalid: %s\n", orderly_get_error(r));
+    orderly_reader_free(&r);
+    return schema;
+}
+
+static int
+nestedEnums(void)
+{
+    static char chunk[CHUNK_SIZE + 256];
+    unsigned int used = 1, cap = 0;
+    unsigned long records;
+    ajv_schema schema = readSchema(enumSchemaText);
+    ajv_handle hand;
+    yajl_status stat = yajl_status_insufficient_data;
+    yajl_parser_config cfg = { 0, 1 };
+
+    if (!schema) {
+        printf("not ok 2 - enum schema is invalid\n");
+        return 0;
+    }
+    hand = ajv_alloc(NULL, &cfg, NULL, NULL);
+
+    chunk[0] = '[';
+    for (records = 0; records < ENUM_RECORDS; records++) {
+        used += sprintf(chunk + used, "%s{\"kind\":\"%s\",\"n\":%d}",
+                        records ? "," : "", records % 2 ? "b" : "a",
+                        records % 2 ? 2 : 1);
+        if (used >= CHUNK_SIZE) {
+            stat = ajv_parse_and_validate(hand, (unsigned char *) chunk,
+                                          used, schema);
+            if (stat != yajl_status_insufficient_data) break;
+            if (hand->enums.tape.cap > cap) cap = hand->enums.tape.cap;
+            used = 0;
+        }
+    }
+    if (stat == yajl_status_insufficient_data) {
+        chunk[used++] = ']';
+        stat = ajv_parse_and_validate(hand, (unsigned char *) chunk,
+                                      used, schema);
+        if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {
+            stat = ajv_parse_complete(hand);
+        }
+    }
+    if (hand->enums.tape.cap > cap) cap = hand->enums.tape.cap;
+
+    if (stat != yajl_status_error || records != ENUM_RECORDS) {
+        printf("not ok 2 - %lu elements matched against nested enums, "
+               "the array should have been rejected once it closed\n",
+               records);
+    } else if (cap > ENUM_TAPE_CEILING) {
+        printf("not ok 2 - %lu elements matched against nested enums "
+               "kept %u bytes of events, limit is %u\n",
+               records, cap, ENUM_TAPE_CEILING);
+    } else {
+        printf("ok 2 - %lu elements matched against nested enums kept at "
+               "most %u bytes of events\n", records, cap);
+    }
+
+    ajv_free(hand);
+    ajv_free_schema(schema);
+    return stat == yajl_status_error && cap <= ENUM_TAPE_CEILING;
+}
+
+static long
+peakRSS(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+int
+main(int argc, char ** argv)
+{
+    unsigned long long target, written = 0, records = 0;
+    long ceiling, rss;
+    static char chunk[CHUNK_SIZE + 256];
+    unsigned int used;
+    ajv_schema schema;
+    ajv_handle hand;
+    yajl_status stat = yajl_status_ok;
+    yajl_parser_config cfg = { 0, 1 };
+
+    target = (unsigned long long)
+        (argc > 1 ? atoi(argv[1]) : DEFAULT_DOC_MB) * 1024 * 1024;
+    ceiling = argc > 2 ? atol(argv[2]) : DEFAULT_RSS_CEILING_KB;
+
+    printf("1..2\n");
+
+    if (!(schema = readSchema(schemaText))) {
+        printf("not ok 1 - schema is invalid\n");
+        return 1;
+    }
+
+    hand = ajv_alloc(NULL, &cfg, NULL, NULL);
+
+    chunk[0] = '[';
+    used = 1;
+    while (written < target) {
+        used += sprintf(chunk + used,
+                        "%s{\"id\":%llu,\"name\":\"record %llu\","
+                        "\"tags\":[\"a\",\"b\",\"c\"]}",
+                        records ? "," : "", records, records);
+        records++;
+        if (used >= CHUNK_SIZE) {
+            stat = ajv_parse_and_validate(hand, (unsigned char *) chunk,
+                                          used, schema);
+            if (stat != yajl_status_insufficient_data) break;
+            written += used;
+            used = 0;
+        }
+    }
+    if (stat == yajl_status_insufficient_data) {
+        chunk[used++] = ']';
+        written += used;
+        stat = ajv_parse_and_validate(hand, (unsigned char *) chunk,
+                                      used, schema);
+        if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {
+            stat = ajv_parse_complete(hand);
+        }
+    }
+
+    rss = peakRSS();
+
+    if (stat != yajl_status_ok) {
+        unsigned char * str = ajv_get_error(hand, 0, NULL, 0);
+        printf("not ok 1 - validation of %llu records failed: %s\n",
+               records, (const char *) str);
+        ajv_free_error(hand, str);
+    } else if (rss > ceiling) {
+        printf("not ok 1 - %llu records (%llu bytes) peaked at %ldkB RSS, "
+               "limit is %ldkB\n", records, written, rss, ceiling);
+    } else {
+        printf("ok 1 - %llu records (%llu bytes) validated in %ldkB RSS\n",
+               records, written, rss);
+    }
+
+    ajv_free(hand);
+    ajv_free_schema(schema);
+
+    /* after the peak is taken, so that it's the long array's alone */
+    if (!nestedEnums()) return 1;
+
+    return (stat == yajl_status_ok && rss <= ceiling) ? 0 : 1;
+}
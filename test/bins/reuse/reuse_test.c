@@ -0,0 +1,144 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+/* validates one document after another on the same handle, switching
+ * between ajv_validate and parsing as it goes, and checks that nothing
+ * of one document, its schema, its errors or where it got to, is
+ * carried into the next */
+
+#include <orderly/ajv_parse.h>
+#include <orderly/reader.h>
+#include "../../../src/orderly_json.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char * numberSchemaText = "integer;";
+static const char * integerSchemaText = "object { integer n; };";
+static const char * stringSchemaText = "object { string n; };";
+
+static unsigned int tests = 0, failed = 0;
+
+static void
+check(int ok, const char * what)
+{
+    printf("%s %u - %s\n", ok ? "ok" : "not ok", ++tests, what);
+    if (!ok) failed++;
+}
+
+static ajv_schema
+readSchema(const char * text)
+{
+    orderly_reader r = orderly_reader_new(NULL);
+    orderly_node * n = orderly_reader_claim(
+        r, orderly_read(r, ORDERLY_UNKNOWN, text, strlen(text)));
+    ajv_schema schema = NULL;
+    if (n) schema = ajv_alloc_schema(NULL, n);
+    orderly_reader_free(&r);
+    return schema;
+}
+
+static yajl_status
+validate(ajv_handle hand, ajv_schema schema, const char * doc)
+{
+    orderly_alloc_funcs af;
+    unsigned int len = strlen(doc);
+    orderly_json * j;
+    yajl_status stat;
+    orderly_set_default_alloc_funcs(&af);
+    j = orderly_read_json(&af, doc, &len);
+    stat = ajv_validate(hand, schema, j);
+    orderly_free_json(&af, &j);
+    return stat;
+}
+
+static yajl_status
+parse(ajv_handle hand, ajv_schema schema, const char * doc)
+{
+    yajl_status stat = ajv_parse_and_validate(
+        hand, (const unsigned char *) doc, strlen(doc), schema);
+    if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {
+        stat = ajv_parse_complete(hand);
+    }
+    return stat;
+}
+
+int
+main(void)
+{
+    ajv_schema numbers = readSchema(numberSchemaText);
+    ajv_schema integers = readSchema(integerSchemaText);
+    ajv_schema strings = readSchema(stringSchemaText);
+    ajv_handle hand;
+    yajl_status stat;
+
+    printf("1..6\n");
+
+    if (!numbers || !integers || !strings) {
+        printf("not ok 1 - schemas are invalid\n");
+        return 1;
+    }
+    hand = ajv_alloc(NULL, NULL, NULL, NULL);
+
+    /* a document that's no container leaves its frame behind */
+    check(validate(hand, numbers, "7") != yajl_status_error,
+          "ajv_validate accepts a number");
+    check(parse(hand, strings, "{\"n\": \"x\"}") == yajl_status_ok
+          && ajv_get_error_count(hand) == 0,
+          "a document parsed next is checked against its own schema");
+    check(validate(hand, integers, "{\"n\": 7}") != yajl_status_error
+          && ajv_get_error_count(hand) == 0,
+          "ajv_validate accepts a document once a parsed one completes");
+    check(validate(hand, strings, "{\"n\": 7}") == yajl_status_error
+          && ajv_get_error_count(hand) == 1,
+          "ajv_validate rejects a document after accepting one");
+
+    /* yajl 1.x parses one document, another needs a new parser */
+    ajv_reset(hand);
+    ajv_collect_errors(hand, 4);
+    stat = ajv_parse_and_validate(hand, (const unsigned char *) "{\"n\": 7}",
+                                  8, strings);
+    if (stat != yajl_status_error) stat = parse(hand, strings, "\n");
+    check(stat == yajl_status_error && ajv_get_error_count(hand) == 1,
+          "a reset handle keeps errors through a chunk after the root");
+    ajv_reset(hand);
+    check(parse(hand, integers, "{\"n\": 7}") == yajl_status_ok
+          && ajv_get_error_count(hand) == 0,
+          "a reset handle parses a document");
+
+    ajv_free(hand);
+    ajv_free_schema(numbers);
+    ajv_free_schema(integers);
+    ajv_free_schema(strings);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+/* builds event tapes from parsed documents and checks that replaying
+ * them, whole or a value at a time, hands on what was parsed, then
+ * reports how fast a tape replays next to how fast yajl parses */
+
+#include "../../../src/orderly_tape.h"
+
+#include <yajl/yajl_gen.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* documents and how yajl_gen writes them back out */
+static const struct {
+    const char * doc;
+    const char * want;
+} roundtrips[] = {
+    { "null", "null" },
+    { " [ true, false, -12, 2.5, \"str\\u00e9\" ] ",
+      "[true,false,-12,2.5,\"str\xc3\xa9\"]" },
+    { "{}", "{}" },
+    { "[[],{},[[]]]", "[[],{},[[]]]" },
+    { "{\"a\": {\"b\": [1, {\"c\": \"\"}]}, \"d\": null}",
+      "{\"a\":{\"b\":[1,{\"c\":\"\"}]},\"d\":null}" },
+    { NULL, NULL }
+};
+
+static const char * members =
+    "{\"a\":[1,[2,3],{\"x\":\"y\"}],\"b\":{\"c\":null},\"d\":\"end\"}";
+
+static int gen_null(void * ctx)
+{
+    return yajl_gen_null((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int gen_boolean(void * ctx, int b)
+{
+    return yajl_gen_bool((yajl_gen) ctx, b) == yajl_gen_status_ok;
+}
+
+static int gen_integer(void * ctx, long l)
+{
+    return yajl_gen_integer((yajl_gen) ctx, l) == yajl_gen_status_ok;
+}
+
+static int gen_double(void * ctx, double d)
+{
+    return yajl_gen_double((yajl_gen) ctx, d) == yajl_gen_status_ok;
+}
+
+static int gen_string(void * ctx, const unsigned char * s, unsigned int l)
+{
+    return yajl_gen_string((yajl_gen) ctx, s, l) == yajl_gen_status_ok;
+}
+
+static int gen_start_map(void * ctx)
+{
+    return yajl_gen_map_open((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int gen_end_map(void * ctx)
+{
+    return yajl_gen_map_close((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int gen_start_array(void * ctx)
+{
+    return yajl_gen_array_open((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int gen_end_array(void * ctx)
+{
+    return yajl_gen_array_close((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static const yajl_callbacks genCallbacks = {
+    gen_null, gen_boolean, gen_integer, gen_double, NULL, gen_string,
+    gen_start_map, gen_string, gen_end_map, gen_start_array, gen_end_array
+};
+
+/* counts events, cancelling once the count reaches a limit */
+typedef struct {
+    unsigned long count;
+    unsigned long limit;
+} counter;
+
+static int count_event(void * ctx)
+{
+    counter * c = (counter *) ctx;
+    return ++c->count != c->limit;
+}
+
+static int count_boolean(void * ctx, int b)
+{
+    (void) b;
+    return count_event(ctx);
+}
+
+static int count_integer(void * ctx, long l)
+{
+    (void) l;
+    return count_event(ctx);
+}
+
+static int count_double(void * ctx, double d)
+{
+    (void) d;
+    return count_event(ctx);
+}
+
+static int count_string(void * ctx, const unsigned char * s, unsigned int l)
+{
+    (void) s;
+    (void) l;
+    return count_event(ctx);
+}
+
+static const yajl_callbacks countCallbacks = {
+    count_event, count_boolean, count_integer, count_double, NULL,
+    count_string, count_event, count_string, count_event, count_event,
+    count_event
+};
+
+/* parse doc onto the end of tape */
+static int
+build(orderly_tape * tape, const char * doc, size_t len)
+{
+    orderly_tape_builder b;
+    yajl_parser_config cfg = { 0, 1 };
+    yajl_handle yh;
+    yajl_status stat;
+
+    orderly_tape_builder_init(&b, NULL, tape);
+    yh = yajl_alloc(&orderly_tape_callbacks, &cfg, NULL, &b);
+    stat = yajl_parse(yh, (const unsigned char *) doc, len);
+    if (stat == yajl_status_ok || stat == yajl_status_insufficient_data) {
+        stat = yajl_parse_complete(yh);
+    }
+    yajl_free(yh);
+    orderly_tape_builder_free(&b);
+    return stat == yajl_status_ok;
+}
+
+/* write out the value at pos, or the whole tape if pos is past its end */
+static char *
+write_out(const orderly_tape * tape, unsigned int pos)
+{
+    yajl_gen_config conf = { 0, NULL };
+    yajl_gen g = yajl_gen_alloc(&conf, NULL);
+    const unsigned char * buf;
+    unsigned int len;
+    char * out = NULL;
+    int ok = pos < tape->len
+        ? orderly_tape_replay_value(tape, pos, &genCallbacks, g)
+        : orderly_tape_replay(tape, &genCallbacks, g);
+
+    if (ok) {
+        yajl_gen_get_buf(g, &buf, &len);
+        out = (char *) malloc(len + 1);
+        memcpy(out, buf, len);
+        out[len] = 0;
+    }
+    yajl_gen_free(g);
+    return out;
+}
+
+static unsigned int tests = 0, failed = 0;
+
+static void
+check(int ok, const char * what)
+{
+    printf("%s %u - %s\n", ok ? "ok" : "not ok", ++tests, what);
+    if (!ok) failed++;
+}
+
+/* the time taken to replay and to parse a document of records */
+static void
+report_speed(void)
+{
+    size_t cap = 1 << 22, len = 0;
+    char * doc = (char *) malloc(cap + 256);
+    orderly_tape tape;
+    counter c = { 0, 0 };
+    unsigned int i, n = 0, iterations = 10;
+    double parsed, replayed;
+    clock_t start;
+
+    doc[len++] = '[';
+    while (len < cap) {
+        len += sprintf(doc + len, "%s{\"id\":%u,\"name\":\"record %u\","
+                       "\"score\":%u.5,\"tags\":[\"a\",\"b\",null,true]}",
+                       n ? "," : "", n, n, n);
+        n++;
+    }
+    doc[len++] = ']';
+
+    orderly_tape_init(&tape);
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        tape.len = 0;
+        build(&tape, doc, len);
+    }
+    parsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    for (i = 0; i < iterations; i++) {
+        orderly_tape_replay(&tape, &countCallbacks, &c);
+    }
+    replayed = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("# %u records, %lu bytes, tape of %u bytes: parsed at %.0f MB/s,"
+           " replayed at %.0f MB/s\n", n, (unsigned long) len, tape.len,
+           (len * (double) iterations) / (parsed * 1024 * 1024),
+           (len * (double) iterations) / (replayed * 1024 * 1024));
+
+    orderly_tape_free(&orderly_default_alloc_funcs, &tape);
+    free(doc);
+}
+
+int
+main(void)
+{
+    orderly_tape tape;
+    unsigned int i, pos, len;
+    char * out;
+    counter c = { 0, 0 };
+    char keys[16];
+
+    for (i = 0; roundtrips[i].doc; i++) ;
+    printf("1..%u\n", i + 3);
+
+    for (i = 0; roundtrips[i].doc; i++) {
+        orderly_tape_init(&tape);
+        out = build(&tape, roundtrips[i].doc, strlen(roundtrips[i].doc))
+            ? write_out(&tape, tape.len) : NULL;
+        check(out && !strcmp(out, roundtrips[i].want)
+              && orderly_tape_skip(&tape, 0) == tape.len,
+              roundtrips[i].doc);
+        free(out);
+        orderly_tape_free(&orderly_default_alloc_funcs, &tape);
+    }
+
+    /* step over the members of an object without reading their values,
+     * and replay just one of them */
+    orderly_tape_init(&tape);
+    build(&tape, members, strlen(members));
+    out = NULL;
+    keys[0] = 0;
+    for (pos = orderly_tape_next(&tape, 0);
+         orderly_tape_event_at(&tape, pos) == orderly_tape_key;
+         pos = orderly_tape_skip(&tape, orderly_tape_skip(&tape, pos)))
+    {
+        const unsigned char * k = orderly_tape_text(&tape, pos, &len);
+        strncat(keys, (const char *) k, len);
+        if (len == 1 && *k == 'b') {
+            out = write_out(&tape, orderly_tape_skip(&tape, pos));
+        }
+    }
+    check(!strcmp(keys, "abd") && orderly_tape_skip(&tape, pos) == tape.len,
+          "skipping object members");
+    check(out && !strcmp(out, "{\"c\":null}"), "replaying one value");
+    free(out);
+
+    /* a callback returning 0 stops the replay */
+    c.limit = 4;
+    check(!orderly_tape_replay(&tape, &countCallbacks, &c) && c.count == 4,
+          "cancelling a replay");
+    orderly_tape_free(&orderly_default_alloc_funcs, &tape);
+
+    report_speed();
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+#!/usr/bin/env ruby
+
+# the validators orderly_compile generates must reach the library's
+# verdict on every document the validator tests have
+
+binaryDir = ENV["BINARY_DIR"]
+
+# arguments are a string that must match the test name
+substrpat = ARGV.length ? ARGV[0] : ""
+
+thisDir = File.dirname(__FILE__)
+casesDir = File.join(thisDir, "validator")
+verifyBin = File.join(binaryDir,  "validator",  "orderly_verify")
+compiledDir = File.join(binaryDir, "test", "bins", "compiled")
+if !File.executable? verifyBin
+  throw "Can't find validator test binary: #{verifyBin}"
+end
+
+def verdict(command, textfile)
+  IO.popen(command, "w+") { |lb|
+    File.open(textfile, "r").each {|l| lb.write(l)}
+    lb.close_write
+    lb.read
+  }
+  $?.exitstatus
+end
+
+passed = 0
+total = 0
+# newline delimited documents are only validated by the library
+files = Dir.glob(File.join(casesDir,"**.{pass,fail}","*.test")).reject { |t|
+  t =~ /\.ndjson\.test$/
+}
+puts "1..#{files.length}"
+puts "#Running compiled validator tests: "
+puts "#(containing '#{substrpat}' in name)" if substrpat && substrpat.length > 0
+Dir.glob(File.join(casesDir, "*.orderly")).each { |f|
+  next if substrpat && substrpat.length > 0 && !f.include?(substrpat)
+  compiledBin = File.join(compiledDir, File.basename(f).sub(/\..*$/, "") + "_verify")
+  ENV['ORDERLY_SCHEMA'] = IO.readlines(f,'').to_s
+  [ f.sub(/orderly$/, "fail"), f.sub(/orderly$/, "pass") ].each { |pfDir|
+    Dir.glob(File.join(pfDir, "*.test")).each { |textfile|
+      next if textfile =~ /\.ndjson\.test$/
+      total += 1
+      want = verdict(verifyBin, textfile)
+      got = verdict(compiledBin, textfile)
+      if got == want
+        puts "ok #{total} - compiled verdict for #{textfile}"
+        passed += 1
+      else
+        puts "not ok #{total} - compiled verdict for #{textfile}"
+        puts "# got exit code '#{got}', the library's was '#{want}'"
+      end
+    }
+  }
+}
+puts "# #{passed}/#{total} tests successful"
+exit passed == total
@@ -13,6 +13,20 @@ system(File.join(mypath, "run_positive_tests.rb"))
 rv += $?.to_i
 system(File.join(mypath, "run_validator.rb"))
 rv += $?.to_i
+system(File.join(mypath, "run_compiled.rb"))
+rv += $?.to_i
+# read json onto the heap and into arenas
+system(File.join(ARGV[0], "test", "bins", "json", "json_test"))
+rv += $?.to_i
+# build and replay event tapes
+system(File.join(ARGV[0], "test", "bins", "tape", "tape_test"))
+rv += $?.to_i
+# validate one document after another on the same handle
+system(File.join(ARGV[0], "test", "bins", "reuse", "reuse_test"))
+rv += $?.to_i
+# validate a multi-gigabyte array in constant memory
+system(File.join(ARGV[0], "test", "bins", "long_array", "long_array_test"))
+rv += $?.to_i
 
 puts "TESTS FAILED (#{rv})!" if rv > 0
 exit rv
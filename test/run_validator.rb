@@ -31,14 +31,38 @@ Dir.glob(File.join(casesDir, "*.orderly")).each { |f|
       got = ""
       explanation = "#{what} for #{textfile}:\t" ;
       ENV['ORDERLY_SCHEMA'] = IO.readlines(f,'').to_s
-      IO.popen(program, "w+") { |lb|
+      # newline delimited cases validate each line as a document,
+      # errors cases report every error they find, and defaults cases
+      # echo the document with the schema's defaults filled in
+      command = program
+      command = "#{program} -n" if textfile =~ /\.ndjson\.test$/
+      command = "#{program} -e 16" if textfile =~ /\.errors\.test$/
+      command = "#{program} -d" if textfile =~ /\.defaults\.test$/
+      IO.popen(command, "w+") { |lb|
         File.open(textfile, "r").each {|l| lb.write(l)}
         lb.close_write
         got = lb.read
       }
-      if ($?.exitstatus != exitCode) 
+      status = $?.exitstatus
+      # the schema's program must reach the same verdict, and say the
+      # same things about it, as walking the schema does
+      gotProgram = ""
+      IO.popen("#{command} -b", "w+") { |lb|
+        File.open(textfile, "r").each {|l| lb.write(l)}
+        lb.close_write
+        gotProgram = lb.read
+      }
+      if ($?.exitstatus != status || gotProgram != got)
+        puts "not ok #{total} - #{explanation}";
+        puts "# program disagrees, exit code '#{$?.exitstatus}', expected '#{status}'"
+        puts "#<<<tree<<<"
+        puts got.gsub(/^/,"#")
+        puts "#========"
+        puts gotProgram.gsub(/^/,"#")
+        puts "#>>program>>"
+      elsif (status != exitCode) 
         puts "not ok #{total} - #{explanation}";
-        puts "# got bad exit code '#{$?.exitstatus}', expected '#{exitCode}'"
+        puts "# got bad exit code '#{status}', expected '#{exitCode}'"
       else
         if File.exist? wantFile
           want = IO.read(wantFile)
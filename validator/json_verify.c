@@ -31,9 +31,12 @@
  */ 
 
 #include <yajl/yajl_parse.h>
+#include <yajl/yajl_gen.h>
 #include <orderly/ajv_parse.h>
 #include <orderly/reader.h>
 
+#include "ndjson.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,11 +48,82 @@ usage(const char * progname)
                     "usage: json_verify [options] <schema>\n"
                     "    -q quiet mode\n"
                     "    -c allow comments\n"
-                    "    -u allow invalid utf8 inside strings\n",
+                    "    -u allow invalid utf8 inside strings\n"
+                    "    -n validate each line of input as a separate document\n"
+                    "    -f with -n, only report the lines that are invalid\n"
+                    "    -j N with -n, validate on N threads, or one per processor\n"
+                    "       when N is 0.  stdin must be a file\n"
+                    "    -e N report up to N errors in the document, not just\n"
+                    "       the first, each with where it was found\n"
+                    "    -b validate with the schema's compiled program rather\n"
+                    "       than by walking the schema\n"
+                    "    -d echo a valid document, with the defaults the schema\n"
+                    "       gives for anything it leaves out filled in\n",
             progname);
     exit(1);
 }
 
+/* callbacks handing the validated document, defaults and all, to a
+ * yajl_gen */
+static int echo_null(void * ctx)
+{
+    return yajl_gen_null((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int echo_boolean(void * ctx, int b)
+{
+    return yajl_gen_bool((yajl_gen) ctx, b) == yajl_gen_status_ok;
+}
+
+static int echo_integer(void * ctx, long l)
+{
+    return yajl_gen_integer((yajl_gen) ctx, l) == yajl_gen_status_ok;
+}
+
+static int echo_double(void * ctx, double d)
+{
+    return yajl_gen_double((yajl_gen) ctx, d) == yajl_gen_status_ok;
+}
+
+static int echo_string(void * ctx, const unsigned char * s, unsigned int l)
+{
+    return yajl_gen_string((yajl_gen) ctx, s, l) == yajl_gen_status_ok;
+}
+
+static int echo_start_map(void * ctx)
+{
+    return yajl_gen_map_open((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int echo_end_map(void * ctx)
+{
+    return yajl_gen_map_close((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int echo_start_array(void * ctx)
+{
+    return yajl_gen_array_open((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static int echo_end_array(void * ctx)
+{
+    return yajl_gen_array_close((yajl_gen) ctx) == yajl_gen_status_ok;
+}
+
+static yajl_callbacks echoCallbacks = {
+    echo_null,
+    echo_boolean,
+    echo_integer,
+    echo_double,
+    NULL,
+    echo_string,
+    echo_start_map,
+    echo_string,
+    echo_end_map,
+    echo_start_array,
+    echo_end_array
+};
+
 static int check_orderly(const char *orderly, unsigned int length) {
   return length == 7
     && orderly[0] == 'o'
@@ -69,7 +143,10 @@ main(int argc, char ** argv)
     ajv_handle hand;
     ajv_schema ajv_schema; 
     static unsigned char fileData[65536];
-    int quiet = 0;
+    int quiet = 0, lines = 0, failuresOnly = 0, wantThreads = 0;
+    int wantErrors = 0, useProgram = 0, echo = 0;
+    yajl_gen g = NULL;
+    unsigned int threads = 1, maxErrors = 1;
 	int retval = 0, done = 0;
     yajl_parser_config cfg = { 0, 1 };
     ajv_register_format("orderly",&check_orderly);
@@ -88,12 +165,52 @@ main(int argc, char ** argv)
                 case 'u':
                     cfg.checkUTF8 = 0;
                     break;
+                case 'n':
+                    lines = 1;
+                    break;
+                case 'f':
+                    failuresOnly = 1;
+                    break;
+                case 'b':
+                    useProgram = 1;
+                    break;
+                case 'd':
+                    echo = 1;
+                    break;
+                case 'j':
+                    /* the number of threads follows, as -j4 or -j 4 */
+                    if (argv[a][i + 1]) {
+                        threads = (unsigned int) atoi(argv[a] + i + 1);
+                        i = strlen(argv[a]) - 1;
+                    } else {
+                        wantThreads = 1;
+                    }
+                    break;
+                case 'e':
+                    /* as with -j, -e4 or -e 4 */
+                    if (argv[a][i + 1]) {
+                        maxErrors = (unsigned int) atoi(argv[a] + i + 1);
+                        i = strlen(argv[a]) - 1;
+                    } else {
+                        wantErrors = 1;
+                    }
+                    break;
                 default:
                     fprintf(stderr, "unrecognized option: '%c'\n\n", argv[a][i]);
                     usage(argv[0]);
             }
         }
         ++a;
+        if (wantThreads) {
+            if (a == argc) usage(argv[0]);
+            threads = (unsigned int) atoi(argv[a++]);
+            wantThreads = 0;
+        }
+        if (wantErrors) {
+            if (a == argc) usage(argv[0]);
+            maxErrors = (unsigned int) atoi(argv[a++]);
+            wantErrors = 0;
+        }
     }
     if (a < (argc-1)) {
         usage(argv[0]);
@@ -104,8 +221,14 @@ main(int argc, char ** argv)
       /* don't make me tell you again */
       return 1;
     }
-    /* allocate a parser */
-    hand = ajv_alloc(NULL, &cfg, NULL, NULL);
+    /* allocate a parser, and a generator to echo through */
+    if (echo && !lines) {
+        yajl_gen_config conf = { 0, NULL };
+        g = yajl_gen_alloc(&conf, NULL);
+    }
+    hand = ajv_alloc(g ? &echoCallbacks : NULL, &cfg, NULL, (void *) g);
+    ajv_collect_errors(hand, maxErrors);
+    ajv_use_program(hand, useProgram);
 
     {
       const char *schema = getenv("ORDERLY_SCHEMA");
@@ -124,6 +247,21 @@ main(int argc, char ** argv)
       ajv_schema = ajv_alloc_schema(NULL, n);
       orderly_reader_free(&r);
     }
+
+    if (lines) {
+        retval = -1;
+        if (threads != 1) {
+            retval = ndjson_verify_parallel(ajv_schema, &cfg, useProgram, threads,
+                                            quiet, failuresOnly);
+        }
+        /* stdin may be a pipe, which can't be split between threads */
+        if (retval < 0) {
+            retval = ndjson_verify(hand, ajv_schema, quiet, failuresOnly);
+        }
+        ajv_free(hand);
+        ajv_free_schema(ajv_schema);
+        return retval;
+    }
     
         
     while (!done) {
@@ -154,15 +292,38 @@ main(int argc, char ** argv)
             stat != yajl_status_insufficient_data)
         {
             if (!quiet) {
-                unsigned char * str = ajv_get_error(hand, 1, fileData, rd);
-                printf("%s", (const char *) str);
-                ajv_free_error(hand, str);
+                unsigned int i = 0;
+                /* a syntax error has no validation errors to report */
+                do {
+                    unsigned char * str =
+                        ajv_get_error_at(hand, i, 1, fileData, rd);
+                    /* one per line, saying where, when there may be many */
+                    if (maxErrors > 1 && i < ajv_get_error_count(hand)) {
+                        unsigned char * path = ajv_get_error_path(hand, i);
+                        printf("at '%s', byte %u: %s\n", (const char *) path,
+                               ajv_get_error_offset(hand, i),
+                               (const char *) str);
+                        ajv_free_error(hand, path);
+                    } else {
+                        printf("%s", (const char *) str);
+                    }
+                    ajv_free_error(hand, str);
+                } while (++i < ajv_get_error_count(hand));
             }
             retval = 1;
             break;
         }
     }
     
+    if (g) {
+        if (!retval && !quiet) {
+            const unsigned char * buf;
+            unsigned int len;
+            yajl_gen_get_buf(g, &buf, &len);
+            printf("%.*s\n", (int) len, (const char *) buf);
+        }
+        yajl_gen_free(g);
+    }
     ajv_free(hand);
     ajv_free_schema(ajv_schema);
     if (!quiet) {
@@ -0,0 +1,424 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+#ifdef ORDERLY_VERIFY_THREADS
+/* for mmap and pthreads */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "ndjson.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ORDERLY_VERIFY_THREADS
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static int
+is_blank(const unsigned char * p, const unsigned char * end)
+{
+    for (; p < end; p++) {
+        if (*p != ' ' && *p != '\t' && *p != '\r') return 0;
+    }
+    return 1;
+}
+
+/* the error on hand, without the newline yajl ends its messages with,
+ * on the heap */
+static char *
+line_error(ajv_handle hand)
+{
+    unsigned char * str = ajv_get_error(hand, 0, NULL, 0);
+    size_t len = strlen((const char *) str);
+    char * err;
+
+    while (len && (str[len - 1] == '\n' || str[len - 1] == ' ')) len--;
+    err = malloc(len + 1);
+    memcpy(err, str, len);
+    err[len] = 0;
+    ajv_free_error(hand, str);
+    return err;
+}
+
+static void
+print_verdict(unsigned long line, unsigned long long start, const char * err)
+{
+    if (err) printf("line %lu, byte %llu: invalid: %s\n", line, start, err);
+    else printf("line %lu, byte %llu: valid\n", line, start);
+}
+
+static void
+print_summary(unsigned long records, unsigned long invalid)
+{
+    printf("%lu records: %lu valid, %lu invalid\n",
+           records, records - invalid, invalid);
+}
+
+/* the verdict on a line whose parser has already seen all of it */
+static int
+finish_line(ajv_handle hand, int failed, int quiet, int failuresOnly,
+            unsigned long line, unsigned long long start)
+{
+    if (!failed) {
+        yajl_status stat = ajv_parse_complete(hand);
+        failed = (stat != yajl_status_ok);
+    }
+    if (quiet || (failuresOnly && !failed)) return failed;
+
+    if (failed) {
+        char * err = line_error(hand);
+        print_verdict(line, start, err);
+        free(err);
+    } else {
+        print_verdict(line, start, NULL);
+    }
+    return failed;
+}
+
+int
+ndjson_verify(ajv_handle hand, ajv_schema schema, int quiet, int failuresOnly)
+{
+    static unsigned char buf[65536];
+    unsigned long line = 1, records = 0, invalid = 0;
+    unsigned long long offset = 0, start = 0;
+    int blank = 1, fed = 0, failed = 0;
+    size_t rd, i, from;
+
+    for (;;) {
+        rd = fread((void *) buf, 1, sizeof(buf), stdin);
+        if (rd == 0) {
+            if (!feof(stdin)) {
+                if (!quiet) fprintf(stderr, "error encountered on file read\n");
+                return 1;
+            }
+            break;
+        }
+        for (from = 0, i = 0; i <= rd; i++) {
+            if (i < rd && buf[i] != '\n') {
+                if (blank) blank = is_blank(buf + i, buf + i + 1);
+                continue;
+            }
+            /* the line so far, which may continue into the next read */
+            if (!failed && i > from) {
+                yajl_status stat =
+                    ajv_parse_and_validate(hand, buf + from,
+                                           (unsigned int) (i - from), schema);
+                fed = 1;
+                failed = (stat != yajl_status_ok
+                          && stat != yajl_status_insufficient_data);
+            }
+            if (i == rd) break;
+
+            if (!blank) {
+                records++;
+                invalid += finish_line(hand, failed, quiet, failuresOnly,
+                                       line, start);
+            }
+            if (fed) ajv_reset(hand);
+            blank = 1;
+            fed = failed = 0;
+            line++;
+            start = offset + i + 1;
+            from = i + 1;
+        }
+        offset += rd;
+    }
+    /* the last line needn't end in a newline */
+    if (!blank) {
+        records++;
+        invalid += finish_line(hand, failed, quiet, failuresOnly, line, start);
+    }
+
+    if (!quiet) print_summary(records, invalid);
+    return invalid ? 1 : 0;
+}
+
+#ifdef ORDERLY_VERIFY_THREADS
+
+/* the bounds on how much of the input a thread takes at a time */
+#define NDJSON_CHUNK_MIN (64 * 1024)
+#define NDJSON_CHUNK_MAX (1024 * 1024)
+/* how many chunks per thread may be finished and waiting to be printed
+ * before threads stop taking more */
+#define NDJSON_WINDOW 4
+
+/* the verdict on one line of a chunk, kept until the chunks before
+ * it have been printed */
+typedef struct {
+    /* from the start of the chunk, the first being 0 */
+    unsigned long line;
+    unsigned long long start;
+    /* NULL if the line is valid */
+    char * err;
+} ndjson_result;
+
+/* a run of whole lines of the input */
+typedef struct {
+    const unsigned char * data;
+    size_t len;
+    unsigned long long offset;
+    unsigned long lines, records, invalid;
+    ndjson_result * results;
+    size_t nresults, maxresults;
+    int done;
+} ndjson_chunk;
+
+typedef struct {
+    ajv_schema schema;
+    const yajl_parser_config * cfg;
+    int useprogram;
+    /* which verdicts are printed */
+    int keepValid, keepInvalid;
+    ndjson_chunk * chunks;
+    size_t nchunks;
+    /* the first chunk no thread has taken, and the first that hasn't
+     * been printed.  threads stay within window of printed */
+    size_t next, printed, window;
+    pthread_mutex_t lock;
+    /* signalled as chunks finish, and as they are printed */
+    pthread_cond_t finished, freed;
+} ndjson_job;
+
+static void
+chunk_verify(const ndjson_job * job, ajv_handle hand, ndjson_chunk * c)
+{
+    const unsigned char * p = c->data, * end = c->data + c->len;
+    unsigned long line = 0;
+
+    while (p < end) {
+        const unsigned char * nl = memchr(p, '\n', (size_t) (end - p));
+        const unsigned char * eol = nl ? nl : end;
+
+        if (!is_blank(p, eol)) {
+            yajl_status stat =
+                ajv_parse_and_validate(hand, p, (unsigned int) (eol - p),
+                                       job->schema);
+            int failed;
+            if (stat == yajl_status_ok
+                || stat == yajl_status_insufficient_data)
+            {
+                stat = ajv_parse_complete(hand);
+            }
+            failed = (stat != yajl_status_ok);
+            c->records++;
+            c->invalid += failed;
+            if (failed ? job->keepInvalid : job->keepValid) {
+                ndjson_result * r;
+                if (c->nresults == c->maxresults) {
+                    c->maxresults = c->maxresults ? 2 * c->maxresults : 64;
+                    c->results = realloc(c->results,
+                                         c->maxresults * sizeof(ndjson_result));
+                }
+                r = c->results + c->nresults++;
+                r->line = line;
+                r->start = c->offset + (unsigned long long) (p - c->data);
+                r->err = failed ? line_error(hand) : NULL;
+            }
+            ajv_reset(hand);
+        }
+        line++;
+        p = nl ? nl + 1 : end;
+    }
+    c->lines = line;
+}
+
+static void *
+worker(void * arg)
+{
+    ndjson_job * job = (ndjson_job *) arg;
+    ajv_handle hand = ajv_alloc(NULL, job->cfg, NULL, NULL);
+    ajv_use_program(hand, job->useprogram);
+
+    for (;;) {
+        ndjson_chunk * c;
+
+        /* chunks are taken in order from a shared cursor, so a thread
+         * which finishes early simply takes the next one */
+        pthread_mutex_lock(&job->lock);
+        while (job->next < job->nchunks
+               && job->next >= job->printed + job->window)
+        {
+            pthread_cond_wait(&job->freed, &job->lock);
+        }
+        if (job->next == job->nchunks) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        c = job->chunks + job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        chunk_verify(job, hand, c);
+
+        pthread_mutex_lock(&job->lock);
+        c->done = 1;
+        pthread_cond_signal(&job->finished);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    ajv_free(hand);
+    return NULL;
+}
+
+/* split data on line boundaries into chunks of about chunk bytes */
+static void
+split_chunks(ndjson_job * job, const unsigned char * data, size_t len,
+             size_t chunk)
+{
+    size_t pos = 0, max = 0;
+
+    while (pos < len) {
+        size_t end = pos + chunk;
+        ndjson_chunk * c;
+        if (end >= len) {
+            end = len;
+        } else {
+            const unsigned char * nl = memchr(data + end, '\n', len - end);
+            end = nl ? (size_t) (nl - data) + 1 : len;
+        }
+        if (job->nchunks == max) {
+            max = max ? 2 * max : 64;
+            job->chunks = realloc(job->chunks, max * sizeof(ndjson_chunk));
+        }
+        c = job->chunks + job->nchunks++;
+        memset((void *) c, 0, sizeof(ndjson_chunk));
+        c->data = data + pos;
+        c->len = end - pos;
+        c->offset = pos;
+        pos = end;
+    }
+}
+
+int
+ndjson_verify_parallel(ajv_schema schema, const yajl_parser_config * cfg,
+                       int useprogram, unsigned int nthreads,
+                       int quiet, int failuresOnly)
+{
+    struct stat st;
+    const unsigned char * data;
+    size_t len, chunk, i;
+    ndjson_job job;
+    pthread_t * threads;
+    unsigned int t;
+    unsigned long line = 1, records = 0, invalid = 0;
+
+    if (fstat(STDIN_FILENO, &st) != 0 || !S_ISREG(st.st_mode)
+        || st.st_size <= 0 || (unsigned long long) st.st_size > (size_t) -1)
+    {
+        return -1;
+    }
+    len = (size_t) st.st_size;
+    data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+    if (data == MAP_FAILED) return -1;
+    posix_madvise((void *) data, len, POSIX_MADV_SEQUENTIAL);
+
+    if (nthreads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? (unsigned int) n : 1;
+    }
+
+    memset((void *) &job, 0, sizeof(job));
+    job.schema = schema;
+    job.cfg = cfg;
+    job.useprogram = useprogram;
+    job.keepInvalid = !quiet;
+    job.keepValid = !quiet && !failuresOnly;
+    job.window = NDJSON_WINDOW * nthreads;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.finished, NULL);
+    pthread_cond_init(&job.freed, NULL);
+
+    /* enough chunks that threads finishing at different times
+     * still have work to take */
+    chunk = len / (8 * nthreads);
+    if (chunk < NDJSON_CHUNK_MIN) chunk = NDJSON_CHUNK_MIN;
+    if (chunk > NDJSON_CHUNK_MAX) chunk = NDJSON_CHUNK_MAX;
+    split_chunks(&job, data, len, chunk);
+
+    threads = malloc(nthreads * sizeof(pthread_t));
+    for (t = 0; t < nthreads; t++) {
+        pthread_create(threads + t, NULL, worker, &job);
+    }
+
+    /* print the chunks in input order, as each finishes */
+    for (i = 0; i < job.nchunks; i++) {
+        ndjson_chunk * c = job.chunks + i;
+        size_t r;
+
+        pthread_mutex_lock(&job.lock);
+        while (!c->done) pthread_cond_wait(&job.finished, &job.lock);
+        pthread_mutex_unlock(&job.lock);
+
+        for (r = 0; r < c->nresults; r++) {
+            print_verdict(line + c->results[r].line, c->results[r].start,
+                          c->results[r].err);
+            free(c->results[r].err);
+        }
+        free(c->results);
+        line += c->lines;
+        records += c->records;
+        invalid += c->invalid;
+
+        pthread_mutex_lock(&job.lock);
+        job.printed = i + 1;
+        pthread_cond_broadcast(&job.freed);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+    free(threads);
+    free(job.chunks);
+    pthread_cond_destroy(&job.freed);
+    pthread_cond_destroy(&job.finished);
+    pthread_mutex_destroy(&job.lock);
+    munmap((void *) data, len);
+
+    if (!quiet) print_summary(records, invalid);
+    return invalid ? 1 : 0;
+}
+
+#else
+
+int
+ndjson_verify_parallel(ajv_schema schema, const yajl_parser_config * cfg,
+                       int useprogram, unsigned int nthreads,
+                       int quiet, int failuresOnly)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2010, Greg Olszewski and Lloyd Hilaiel.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ * 
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ * 
+ *  3. Neither the name of Greg Olszewski and Lloyd Hilaiel nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */ 
+
+
+/* newline delimited json: validating a stream of documents, one per
+ * line, and reporting on each */
+
+#ifndef __NDJSON_H__
+#define __NDJSON_H__
+
+#include <orderly/ajv_parse.h>
+
+/* validate the lines of stdin with hand, printing a verdict on every
+ * line (or, with failuresOnly, every invalid line) and a summary.
+ * quiet prints nothing.  returns the exit status */
+int ndjson_verify(ajv_handle hand, ajv_schema schema,
+                  int quiet, int failuresOnly);
+
+/* the same, for stdin mapped into memory and validated in chunks by
+ * nthreads threads (0 for one per processor), each with a handle of
+ * its own, running the schema's program when useprogram is set.  the
+ * output is identical.  returns -1, having printed
+ * nothing, when stdin isn't a file that can be mapped or this build
+ * has no threads */
+int ndjson_verify_parallel(ajv_schema schema, const yajl_parser_config * cfg,
+                           int useprogram, unsigned int nthreads,
+                           int quiet, int failuresOnly);
+
+#endif